@@ -28,36 +28,129 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "json.h"
 #include "json_object.h"
 #include "json_tokenizer.h"
 #include "json_debug.h"
 #include "json_error.h"
+#include "json_stats.h"
+#include "json_trace.h"
 
 
+static json_object * json_parse_tokenizer(json_tokenizer * tokenizer, json_parser * parser, json_error * error);
+static json_object * json_parse_document(json_tokenizer * tokenizer, json_parser * parser, bool * end, json_error * error);
+static json_object * json_parser_value(json_parser * parser, json_error * error);
+
+/* 
+ * Structural pre-scan, counts the items of every container (in the order of their
+ * opening brackets). Only quotes, brackets and commas are matched, invalid input
+ * just yields wrong counts.
+ */
+static int * json_parse_scanSizes(const char * string, int * count) {
+    int capacity = 16, depth = 0, stackCapacity = 16;
+    JSON_DEBUG_MALLOC;
+    int * sizes = malloc(sizeof(int)*capacity);
+    JSON_DEBUG_MALLOC;
+    int * stack = malloc(sizeof(int)*stackCapacity); // open containers
+    *count = 0;
+    
+    const char * p = string;
+    while (*(p += strcspn(p, "\"[]{},")) != '\0') {
+        switch (*p++) {
+        case '"':
+            // skip the string
+            while (*(p += strcspn(p, "\"\\")) == '\\' && p[1] != '\0') p += 2;
+            if (*p++ == '\0') p--;
+            break;
+        case ',':
+            if (depth > 0) sizes[stack[depth - 1]]++;
+            break;
+        case ']': case '}':
+            if (depth > 0) depth--;
+            break;
+        default: // opening bracket
+            if (*count == capacity) {
+                capacity *= 2;
+                sizes = realloc(sizes, sizeof(int)*capacity);
+            }
+            if (depth == stackCapacity) {
+                stackCapacity *= 2;
+                stack = realloc(stack, sizeof(int)*stackCapacity);
+            }
+            
+            // empty container?
+            const char * first = p + strspn(p, " \t\n\r");
+            sizes[*count] = (*first == ']' || *first == '}' || *first == '\0') ? 0 : 1;
+            stack[depth++] = (*count)++;
+        }
+    }
+    
+    free(stack);
+    JSON_DEBUG_FREE;
+    return sizes;
+}
+
+/* Parses a JSON string of the given length through the window of a memory reader. */
+static json_object * json_parse_stringLen(const char * string, size_t length, bool presize, json_error * error) {
+    json_tokenizer tokenizer;
+    json_reader_window window;
+    json_tokenizer_init(&tokenizer, json_reader_memory(&window, string, length));
+    int * sizes = NULL;
+    if (presize) {
+        sizes = json_parse_scanSizes(string, &tokenizer.sizeHintCount);
+        tokenizer.sizeHints = sizes;
+    }
+    
+    json_object * object = json_parse_tokenizer(&tokenizer, NULL, error);
+    json_tokenizer_free(&tokenizer);
+    if (sizes != NULL) {
+        free(sizes);
+        JSON_DEBUG_FREE;
+    }
+    return object;
+}
+
 /* Parses a JSON string. */
 json_object * json_parse_string(const char * string, json_error * error) {
-    return json_parse(json_reader_string(string), error);
+    size_t length = strlen(string);
+    return json_parse_stringLen(string, length, length >= JSON_PARSE_PRESCAN_MIN_LENGTH, error);
+}
+
+/* Parses a JSON string, the containers are presized from a pre-scan if requested. */
+json_object * json_parse_string_ext(const char * string, bool presize, json_error * error) {
+    return json_parse_stringLen(string, strlen(string), presize, error);
 }
 
 /* Parses a JSON file. */
 json_object * json_parse_file_buf(const char * filename, bool buffered, int bufferSize, json_error * error) {
     FILE * file = fopen(filename, "r");
+    if (file == NULL) {
+        if (error) { error->code = JSON_ERROR_IO; error->line = 0; error->pos = 0; }
+        return NULL;
+    }
+    setvbuf(file, NULL, _IONBF, 0); // the reader does the buffering
+    
+    json_object * obj;
     if (buffered == true) {
-        setvbuf(file, NULL, _IOFBF, bufferSize);
+        json_reader reader = json_reader_stream_buf(file, bufferSize);
+        obj = json_parse(reader, error);
+        json_reader_free(&reader);
     }
     else {
-        setvbuf(file, NULL, _IONBF, 0);
+        obj = json_parse(json_reader_stream(file), error);
     }
-    json_object * obj = json_parse_stream(file, error);
     fclose(file);
     return obj;
 }
     
 /* Parses JSON incoming from a steam. */
 json_object * json_parse_stream(FILE * stream, json_error * error) {
-    return json_parse(json_reader_stream(stream), error);
+    json_reader reader = json_reader_stream_buf(stream, JSON_READER_BLOCK_SIZE);
+    json_object * obj = json_parse(reader, error);
+    json_reader_free(&reader);
+    return obj;
 }
 
 static json_object * json_parse_recursive(json_tokenizer * tokenizer, json_error * error);
@@ -65,32 +158,80 @@ static inline json_object * json_parse_recursive_map(json_tokenizer * tokenizer,
 static inline json_object * json_parse_recursive_array(json_tokenizer * tokenizer, json_error * error);
 
 #define THROW_ERROR(errcode) { if (error) { error->code = errcode; error->line = tokenizer->line; error->pos = tokenizer->pos; } return NULL; }
-#define THROW_ERROR2(errcode) { if (error) { error->code = errcode; error->line = tokenizer.line; error->pos = tokenizer.pos; } return NULL; }
 
 /* Parses JSON. */
 json_object * json_parse(json_reader reader, json_error * error) {
     json_tokenizer tokenizer;
     json_tokenizer_init(&tokenizer, reader);
-    json_object * object = json_parse_recursive(&tokenizer, error);
+    json_object * object = json_parse_tokenizer(&tokenizer, NULL, error);
+    json_tokenizer_free(&tokenizer);
+    return object;
+}
+
+
+
+/* Parses the whole input of the tokenizer (with the parser's stack if there is a parser). */
+static json_object * json_parse_tokenizer(json_tokenizer * tokenizer, json_parser * parser, json_error * error) {
+    json_object * object = json_parse_document(tokenizer, parser, NULL, error);
     if (object == NULL) return NULL;
     
     // EOF wanted
-    bool eofOk = json_tokenizer_next(&tokenizer);
-    if (!eofOk || tokenizer.token.type != JSON_TOKEN_EOF) {
-        json_token_free(&tokenizer.token);
+    bool eofOk = json_tokenizer_next(tokenizer);
+    if (!eofOk || tokenizer->token.type != JSON_TOKEN_EOF) {
+        json_token_free(&tokenizer->token);
         json_object_free(object);
-        THROW_ERROR2(JSON_ERROR_GARBAGE); // unexpected garbage...
+        THROW_ERROR(JSON_ERROR_GARBAGE); // unexpected garbage...
+    }
+    
+    return object;
+}
+
+/* 
+ * Parses a root value starting with the next token. If end isn't NULL, the end
+ * of the input is allowed instead of the value (NULL is returned, end is set).
+ */
+static json_object * json_parse_document(json_tokenizer * tokenizer, json_parser * parser, bool * end, json_error * error) {
+    long startBytes = tokenizer->bytes;
+    if (!json_tokenizer_next(tokenizer)) THROW_ERROR(tokenizer->error);
+    if (end != NULL) {
+        *end = (tokenizer->token.type == JSON_TOKEN_EOF);
+        if (*end) return NULL;
     }
     
+    JSON_TRACE_POINT(JSON_TRACE_PARSE_START, 0);
+#ifndef JSON_NO_STATS
+    unsigned long long start = JSON_STATS_ACTIVE ? json_stats_now() : 0;
+#endif
+    json_object * object = parser ? json_parser_value(parser, error) : json_parse_value(tokenizer, error);
+    
+#ifndef JSON_NO_STATS
+    if (JSON_STATS_ACTIVE) {
+        JSON_STATS_ADD(parses, 1);
+        JSON_STATS_ADD(bytes, tokenizer->bytes - startBytes);
+        JSON_STATS_ADD(nanoseconds, json_stats_now() - start);
+    }
+#endif
+    JSON_TRACE_POINT(JSON_TRACE_PARSE_END, tokenizer->bytes - startBytes);
     return object;
 }
 
+/* Returns the size hint for the next container (or -1). */
+static inline int json_parse_sizeHint(json_tokenizer * tokenizer) {
+    if (tokenizer->_sizeHintPosition >= tokenizer->sizeHintCount) return -1;
+    return tokenizer->sizeHints[tokenizer->_sizeHintPosition++];
+}
+
 static json_object * json_parse_recursive(json_tokenizer * tokenizer, json_error * error) {
     bool tokenOk;
     
     tokenOk = json_tokenizer_next(tokenizer);
     if (!tokenOk) THROW_ERROR(tokenizer->error);
     
+    return json_parse_value(tokenizer, error);
+}
+
+/* Parses a value starting with the current token. */
+json_object * json_parse_value(json_tokenizer * tokenizer, json_error * error) {
     switch (tokenizer->token.type) {
     case JSON_TOKEN_NULL:
         return json_null();
@@ -101,7 +242,10 @@ static json_object * json_parse_recursive(json_tokenizer * tokenizer, json_error
     case JSON_TOKEN_FLOAT:
         return json_float(tokenizer->token.data.floatValue);
     case JSON_TOKEN_STRING:
-        return json_string_ref(json_token_hijack(&tokenizer->token));
+    {
+        int length = tokenizer->token.data.string.length;
+        return json_string_ref_len(json_token_hijack(&tokenizer->token), length);
+    }
     case JSON_TOKEN_BRACE_OPENING:
         return json_parse_recursive_map(tokenizer, error);
     case JSON_TOKEN_BRACKET_OPENING:
@@ -117,8 +261,11 @@ static json_object * json_parse_recursive(json_tokenizer * tokenizer, json_error
 static inline json_object * json_parse_recursive_map(json_tokenizer * tokenizer, json_error * error) {
     bool tokenOk;
     bool notFinished = true;
-    json_object * map = json_map();
+    json_object * map = json_map_ext(json_parse_sizeHint(tokenizer));
     char * key = NULL;
+    tokenizer->_depth++;
+    JSON_STATS_MAX(maxDepth, tokenizer->_depth);
+    JSON_TRACE_POINT(JSON_TRACE_CONTAINER_OPEN, JSON_OBJECT_MAP);
     
     #define THROW_MAP_ERROR(e) { json_object_free(map); if (key) { free(key); JSON_DEBUG_FREE; } THROW_ERROR(e); }
 
@@ -127,12 +274,15 @@ static inline json_object * json_parse_recursive_map(json_tokenizer * tokenizer,
         tokenOk = json_tokenizer_next(tokenizer);
         if (!tokenOk) THROW_MAP_ERROR(tokenizer->error);
         if (tokenizer->token.type == JSON_TOKEN_EOF) THROW_MAP_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+        if (tokenizer->token.type == JSON_TOKEN_BRACE_CLOSING && json_map_size(map) == 0) break; // empty map
         if (tokenizer->token.type != JSON_TOKEN_STRING) { 
             json_token_free(&tokenizer->token);
             THROW_MAP_ERROR(JSON_ERROR_EXPECTED_STRING);
         }
         
+        int keyLength = tokenizer->token.data.string.length;
         key = json_token_hijack(&tokenizer->token);
+        unsigned keyHash = json_map_hash_len(key, keyLength); // the length is known, no strlen
         
         // read ":"
         tokenOk = json_tokenizer_next(tokenizer);
@@ -147,8 +297,14 @@ static inline json_object * json_parse_recursive_map(json_tokenizer * tokenizer,
         json_object * value = json_parse_recursive(tokenizer, error);
         if (value == NULL) THROW_MAP_ERROR(error->code);
         
-        // store it and free od value (in the case of a collision)
-        json_object * oldValue = json_map_put_ext(map, key, value, false); // store to the map, don't copy the key
+        // store it, a duplicate key is handled by the policy
+        json_object * oldValue;
+        if (!json_map_insert(map, key, keyLength, keyHash, value, tokenizer->duplicateKeys, &oldValue)) {
+            json_object_free(value);
+            if (tokenizer->duplicateKeys == JSON_DUPLICATE_ERROR) THROW_MAP_ERROR(JSON_ERROR_DUPLICATE_KEY);
+            free(key); // the first value is kept
+            JSON_DEBUG_FREE;
+        }
         if (oldValue != NULL) json_object_free(oldValue);
         key = NULL;
         
@@ -165,23 +321,41 @@ static inline json_object * json_parse_recursive_map(json_tokenizer * tokenizer,
         }
     } while (notFinished);
     
+    tokenizer->_depth--;
+    JSON_STATS_MAX(maxContainerSize, json_map_size(map));
+    JSON_TRACE_POINT(JSON_TRACE_CONTAINER_CLOSE, json_map_size(map));
     return map;
 }
 
 static inline json_object * json_parse_recursive_array(json_tokenizer * tokenizer, json_error * error) {
     bool tokenOk;
     bool notFinished = true;
-    json_object * array = json_array();
+    int sizeHint = json_parse_sizeHint(tokenizer);
+    json_object * array = sizeHint >= 0 ? json_array_ext(sizeHint) : json_array();
+    tokenizer->_depth++;
+    JSON_STATS_MAX(maxDepth, tokenizer->_depth);
+    JSON_TRACE_POINT(JSON_TRACE_CONTAINER_OPEN, JSON_OBJECT_ARRAY);
     
     #define THROW_ARRAY_ERROR(e) { json_object_free(array); THROW_ERROR(e); }
     
     do {
         // read the item
-        json_object * item = json_parse_recursive(tokenizer, error);
-        if (item == NULL) THROW_ARRAY_ERROR(error->code);
+        tokenOk = json_tokenizer_next(tokenizer);
+        if (!tokenOk) THROW_ARRAY_ERROR(tokenizer->error);
+        if (tokenizer->token.type == JSON_TOKEN_BRACKET_CLOSING && json_array_size(array) == 0) break; // empty array
         
-        // add the item to the array
-        json_array_add(array, item);
+        // add the item to the array, numbers are added without parsing a value
+        if (tokenizer->token.type == JSON_TOKEN_INTEGER) {
+            json_array_add_int(array, tokenizer->token.data.intValue);
+        }
+        else if (tokenizer->token.type == JSON_TOKEN_FLOAT) {
+            json_array_add_float(array, tokenizer->token.data.floatValue);
+        }
+        else {
+            json_object * item = json_parse_value(tokenizer, error);
+            if (item == NULL) THROW_ARRAY_ERROR(error->code);
+            json_array_add(array, item);
+        }
         
         // read "," or "]"
         tokenOk = json_tokenizer_next(tokenizer);
@@ -196,7 +370,424 @@ static inline json_object * json_parse_recursive_array(json_tokenizer * tokenize
         }
     } while (notFinished);
     
+    tokenizer->_depth--;
+    JSON_STATS_MAX(maxContainerSize, json_array_size(array));
+    JSON_TRACE_POINT(JSON_TRACE_CONTAINER_CLOSE, json_array_size(array));
     return array;
 }
 
 
+/* Value of an open container. */
+struct JSON_PARSER_ITEM {
+    char * key; // map keys only
+    unsigned hash;
+    unsigned length; // of the key
+    json_object_type type; // numbers are stored unboxed (arrays of numbers can be packed)
+    union {
+        json_object * object;
+        int intValue;
+        float floatValue;
+    } value;
+};
+
+/* Open container. */
+struct JSON_PARSER_FRAME {
+    json_object_type type; // JSON_OBJECT_ARRAY or JSON_OBJECT_MAP
+    int start; // index of the first item
+};
+
+/* Interned map key. */
+struct JSON_PARSER_KEY {
+    char * key; // NULL if the slot is empty
+    unsigned hash;
+    int length;
+};
+
+#define JSON_PARSER_STACK_CAPACITY 64
+#define JSON_PARSER_INTERNED_KEY_LENGTH 64 // longer keys aren't interned
+
+/* Initializes a reusable parser. */
+void json_parser_init(json_parser * parser) {
+    json_parser_init_ext(parser, NULL);
+}
+
+/* Initializes a reusable parser with the given options. */
+void json_parser_init_ext(json_parser * parser, const json_parser_options * options) {
+    json_tokenizer_init(&parser->tokenizer, json_reader_memory(&parser->_window, NULL, 0));
+    parser->options.arenaBlockSize = options ? options->arenaBlockSize : 0;
+    parser->options.internedKeys = 0;
+    parser->options.duplicateKeys = options ? options->duplicateKeys : JSON_DUPLICATE_LAST;
+    parser->options.packNumbers = options ? options->packNumbers : false;
+    json_arena_init(&parser->arena, parser->options.arenaBlockSize);
+    json_arena_init(&parser->_keyArena, 0);
+    parser->_items = NULL;
+    parser->_itemCapacity = 0;
+    parser->_frames = NULL;
+    parser->_frameCapacity = 0;
+    parser->_keys = NULL;
+    
+    if (options && options->arenaBlockSize > 0 && options->internedKeys > 0) {
+        int slots = 1;
+        while (slots < options->internedKeys) slots *= 2;
+        parser->options.internedKeys = slots;
+        JSON_DEBUG_MALLOC;
+        parser->_keys = calloc(slots, sizeof(struct JSON_PARSER_KEY));
+    }
+}
+
+/* Parses a JSON document of the given length, reusing the parser's buffers. */
+json_object * json_parser_parse(json_parser * parser, const char * buffer, size_t length, json_error * error) {
+    json_arena_reset(&parser->arena); // releases the previous tree
+    json_tokenizer_reset(&parser->tokenizer, json_reader_memory(&parser->_window, buffer, length));
+    return json_parse_tokenizer(&parser->tokenizer, parser, error);
+}
+
+/* Frees the parser's buffers. */
+void json_parser_free(json_parser * parser) {
+    json_tokenizer_free(&parser->tokenizer);
+    json_arena_free(&parser->arena);
+    json_arena_free(&parser->_keyArena);
+    if (parser->_items != NULL) {
+        free(parser->_items);
+        JSON_DEBUG_FREE;
+    }
+    if (parser->_frames != NULL) {
+        free(parser->_frames);
+        JSON_DEBUG_FREE;
+    }
+    if (parser->_keys != NULL) {
+        free(parser->_keys);
+        JSON_DEBUG_FREE;
+    }
+}
+
+/* Prepares the iterator for the first document. */
+static void json_document_iterator_start(json_document_iterator * iterator) {
+    iterator->document = NULL;
+    iterator->index = -1;
+    iterator->failed = false;
+    iterator->error = JSON_ERROR_EMPTY;
+}
+
+/* Initializes an iterator over the documents read from the reader. */
+void json_document_iterator_init(json_document_iterator * iterator, json_reader reader, const json_parser_options * options) {
+    json_parser_init_ext(&iterator->parser, options);
+    json_tokenizer_reset(&iterator->parser.tokenizer, reader);
+    json_document_iterator_start(iterator);
+}
+
+/* Initializes an iterator over the documents in a buffer. */
+void json_document_iterator_init_buffer(json_document_iterator * iterator, const char * buffer, size_t length, const json_parser_options * options) {
+    json_parser_init_ext(&iterator->parser, options);
+    json_tokenizer_reset(&iterator->parser.tokenizer, json_reader_memory(&iterator->parser._window, buffer, length));
+    json_document_iterator_start(iterator);
+}
+
+/* Parses the next document. */
+bool json_document_iterator_next(json_document_iterator * iterator) {
+    json_parser * parser = &iterator->parser;
+    iterator->document = NULL;
+    if (iterator->failed) return false;
+    
+    json_arena_reset(&parser->arena); // releases the previous document
+    bool end = false;
+    iterator->document = json_parse_document(&parser->tokenizer, parser, &end, &iterator->error);
+    if (iterator->document == NULL) {
+        if (end) return false; // all documents were read
+        iterator->failed = true;
+        return false;
+    }
+    iterator->index++;
+    return true;
+}
+
+/* Frees the iterator. */
+void json_document_iterator_free(json_document_iterator * iterator) {
+    json_parser_free(&iterator->parser);
+}
+
+/* Makes sure there is room for the item at the given index. */
+static inline void json_parser_reserveItem(json_parser * parser, int index) {
+    if (index < parser->_itemCapacity) return;
+    if (parser->_items == NULL) {
+        JSON_DEBUG_MALLOC;
+    }
+    parser->_itemCapacity = parser->_itemCapacity ? 2 * parser->_itemCapacity : JSON_PARSER_STACK_CAPACITY;
+    parser->_items = realloc(parser->_items, sizeof(struct JSON_PARSER_ITEM) * parser->_itemCapacity);
+}
+
+/* Opens a new container. */
+static inline void json_parser_pushFrame(json_parser * parser, int depth, json_object_type type, int start) {
+    if (depth >= parser->_frameCapacity) {
+        if (parser->_frames == NULL) {
+            JSON_DEBUG_MALLOC;
+        }
+        parser->_frameCapacity = parser->_frameCapacity ? 2 * parser->_frameCapacity : JSON_PARSER_STACK_CAPACITY;
+        parser->_frames = realloc(parser->_frames, sizeof(struct JSON_PARSER_FRAME) * parser->_frameCapacity);
+    }
+    parser->_frames[depth].type = type;
+    parser->_frames[depth].start = start;
+}
+
+/* Creates an object, in the arena if the parser has one. */
+static inline json_object * json_parser_newObject(json_parser * parser, json_object_type type) {
+    if (parser->options.arenaBlockSize > 0) return json_object_new_arena(&parser->arena, type);
+    return json_object_new(type);
+}
+
+/* Returns the object of the item (numbers are boxed). */
+static inline json_object * json_parser_itemObject(json_parser * parser, const struct JSON_PARSER_ITEM * item) {
+    json_object * obj;
+    switch (item->type) {
+    case JSON_OBJECT_INT:
+        obj = json_parser_newObject(parser, JSON_OBJECT_INT);
+        obj->json_int.value = item->value.intValue;
+        return obj;
+    case JSON_OBJECT_FLOAT:
+        obj = json_parser_newObject(parser, JSON_OBJECT_FLOAT);
+        obj->json_float.value = item->value.floatValue;
+        return obj;
+    default:
+        return item->value.object;
+    }
+}
+
+/* Returns the key of the current token, interned if possible. */
+static char * json_parser_key(json_parser * parser, unsigned * hash, unsigned * keyLength) {
+    json_token * token = &parser->tokenizer.token;
+    int length = token->data.string.length;
+    *keyLength = length;
+    *hash = json_map_hash_len(token->data.string.data, length);
+    if (parser->options.arenaBlockSize == 0) return json_token_hijack(token);
+    
+    struct JSON_PARSER_KEY * slot = NULL;
+    if (parser->_keys != NULL && length <= JSON_PARSER_INTERNED_KEY_LENGTH) {
+        slot = &parser->_keys[*hash & (parser->options.internedKeys - 1)];
+        if (slot->key != NULL) {
+            if (slot->hash == *hash && slot->length == length && memcmp(slot->key, token->data.string.data, length) == 0) return slot->key;
+            slot = NULL; // taken by another key
+        }
+    }
+    
+    char * key = json_arena_alloc(slot ? &parser->_keyArena : &parser->arena, length + 1);
+    memcpy(key, token->data.string.data, length + 1);
+    if (slot != NULL) {
+        slot->key = key;
+        slot->hash = *hash;
+        slot->length = length;
+    }
+    return key;
+}
+
+/* 
+ * Creates the container from the items on the top of the stack. Returns NULL for a
+ * duplicate key with JSON_DUPLICATE_ERROR (the items are left to json_parser_discard).
+ */
+static json_object * json_parser_closeContainer(json_parser * parser, const struct JSON_PARSER_FRAME * frame, int count) {
+    struct JSON_PARSER_ITEM * items = parser->_items + frame->start;
+    int size = count - frame->start;
+    bool arena = parser->options.arenaBlockSize > 0;
+    json_object * container = json_parser_newObject(parser, frame->type);
+    
+    if (frame->type == JSON_OBJECT_ARRAY) {
+        if (arena) {
+            // not packed, unpacking would allocate outside of the arena
+            json_array_init_arena(container, &parser->arena, size);
+            for (int i = 0; i < size; i++) json_array_add(container, json_parser_itemObject(parser, &items[i]));
+        }
+        else {
+            json_object_type first = size > 0 ? items[0].type : JSON_OBJECT_NULL;
+            if (parser->options.packNumbers && (first == JSON_OBJECT_INT || first == JSON_OBJECT_FLOAT)) {
+                json_array_init_packed(container, first, size);
+            }
+            else json_array_init_ext(container, size);
+            for (int i = 0; i < size; i++) {
+                if (items[i].type == JSON_OBJECT_INT) json_array_add_int(container, items[i].value.intValue);
+                else if (items[i].type == JSON_OBJECT_FLOAT) json_array_add_float(container, items[i].value.floatValue);
+                else json_array_add(container, items[i].value.object);
+            }
+        }
+    }
+    else {
+        json_duplicate_keys duplicates = parser->options.duplicateKeys;
+        if (arena) json_map_init_arena(container, &parser->arena, size);
+        else json_map_init_ext(container, size);
+        
+        for (int i = 0; i < size; i++) {
+            json_object * value = json_parser_itemObject(parser, &items[i]);
+            json_object * oldValue;
+            if (arena) {
+                // the rejected and replaced values are released with the arena
+                if (!json_map_insert_arena(container, items[i].key, items[i].length, items[i].hash, value, duplicates, &oldValue) && duplicates == JSON_DUPLICATE_ERROR) return NULL;
+                continue;
+            }
+            if (json_map_insert(container, items[i].key, items[i].length, items[i].hash, value, duplicates, &oldValue)) {
+                if (oldValue != NULL) json_object_free(oldValue);
+                continue;
+            }
+            
+            // a rejected duplicate
+            json_object_free(value);
+            free(items[i].key);
+            JSON_DEBUG_FREE;
+            if (duplicates == JSON_DUPLICATE_ERROR) {
+                // the map owns the items before this one, the rest stays on the stack
+                json_object_free(container);
+                for (int j = 0; j <= i; j++) {
+                    items[j].key = NULL;
+                    items[j].type = JSON_OBJECT_INT;
+                }
+                return NULL;
+            }
+        }
+    }
+    
+    JSON_STATS_MAX(maxContainerSize, size);
+    JSON_TRACE_POINT(JSON_TRACE_CONTAINER_CLOSE, size);
+    return container;
+}
+
+/* Frees the items on the stack after an error. */
+static void json_parser_discard(json_parser * parser, int count) {
+    if (parser->options.arenaBlockSize > 0) return; // released with the arena
+    for (int i = 0; i < count; i++) {
+        if (parser->_items[i].key != NULL) {
+            free(parser->_items[i].key);
+            JSON_DEBUG_FREE;
+        }
+        if (parser->_items[i].type != JSON_OBJECT_INT && parser->_items[i].type != JSON_OBJECT_FLOAT) json_object_free(parser->_items[i].value.object);
+    }
+}
+
+#define THROW_PARSER_ERROR(errcode) { json_parser_discard(parser, count); THROW_ERROR(errcode); }
+#define NEXT_TOKEN { if (!json_tokenizer_next(tokenizer)) THROW_PARSER_ERROR(tokenizer->error); }
+
+/* 
+ * Reads the key and ":" of a map item (starting with the current token). The item
+ * is pushed with the key, its value is stored once it's parsed.
+ */
+#define READ_KEY { \
+    if (tokenizer->token.type == JSON_TOKEN_EOF) THROW_PARSER_ERROR(JSON_ERROR_UNEXPECTED_EOF); \
+    if (tokenizer->token.type != JSON_TOKEN_STRING) { \
+        json_token_free(&tokenizer->token); \
+        THROW_PARSER_ERROR(JSON_ERROR_EXPECTED_STRING); \
+    } \
+    json_parser_reserveItem(parser, count); \
+    parser->_items[count].key = json_parser_key(parser, &parser->_items[count].hash, &parser->_items[count].length); \
+    parser->_items[count].type = JSON_OBJECT_INT; /* no value yet */ \
+    count++; \
+    NEXT_TOKEN; \
+    if (tokenizer->token.type == JSON_TOKEN_EOF) THROW_PARSER_ERROR(JSON_ERROR_UNEXPECTED_EOF); \
+    if (tokenizer->token.type != JSON_TOKEN_COLON) { \
+        json_token_free(&tokenizer->token); \
+        THROW_PARSER_ERROR(JSON_ERROR_EXPECTED_COLON); \
+    } \
+    NEXT_TOKEN; \
+}
+
+/* Parses a value starting with the current token, with the parser's stack instead of recursion. */
+static json_object * json_parser_value(json_parser * parser, json_error * error) {
+    json_tokenizer * tokenizer = &parser->tokenizer;
+    int depth = 0; // open containers
+    int count = 0; // items on the stack
+    struct JSON_PARSER_ITEM value;
+    
+    for (;;) {
+        // the current token starts a value
+        bool complete = true;
+        value.type = JSON_OBJECT_NULL;
+        switch (tokenizer->token.type) {
+        case JSON_TOKEN_NULL:
+            value.value.object = json_parser_newObject(parser, JSON_OBJECT_NULL);
+            break;
+        case JSON_TOKEN_BOOL:
+            value.value.object = json_parser_newObject(parser, JSON_OBJECT_BOOL);
+            value.value.object->json_bool.value = tokenizer->token.data.boolValue;
+            break;
+        case JSON_TOKEN_INTEGER:
+            value.type = JSON_OBJECT_INT;
+            value.value.intValue = tokenizer->token.data.intValue;
+            break;
+        case JSON_TOKEN_FLOAT:
+            value.type = JSON_OBJECT_FLOAT;
+            value.value.floatValue = tokenizer->token.data.floatValue;
+            break;
+        case JSON_TOKEN_STRING:
+        {
+            int length = tokenizer->token.data.string.length;
+            if (parser->options.arenaBlockSize > 0) {
+                value.value.object = json_object_new_arena(&parser->arena, JSON_OBJECT_STRING);
+                json_string_init_arena(value.value.object, &parser->arena, tokenizer->token.data.string.data, length);
+            }
+            else {
+                value.value.object = json_string_ref_len(json_token_hijack(&tokenizer->token), length);
+            }
+            break;
+        }
+        case JSON_TOKEN_BRACE_OPENING:
+        case JSON_TOKEN_BRACKET_OPENING:
+        {
+            json_object_type type = tokenizer->token.type == JSON_TOKEN_BRACE_OPENING ? JSON_OBJECT_MAP : JSON_OBJECT_ARRAY;
+            json_tokenType closing = type == JSON_OBJECT_MAP ? JSON_TOKEN_BRACE_CLOSING : JSON_TOKEN_BRACKET_CLOSING;
+            json_parser_pushFrame(parser, depth++, type, count);
+            JSON_STATS_MAX(maxDepth, depth);
+            JSON_TRACE_POINT(JSON_TRACE_CONTAINER_OPEN, type);
+            
+            NEXT_TOKEN;
+            if (tokenizer->token.type == closing) { // empty container
+                value.value.object = json_parser_closeContainer(parser, &parser->_frames[--depth], count);
+            }
+            else {
+                if (type == JSON_OBJECT_MAP) READ_KEY;
+                complete = false; // the current token starts the first item
+            }
+            break;
+        }
+        case JSON_TOKEN_EOF:
+            THROW_PARSER_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+        default:
+            json_token_free(&tokenizer->token);
+            THROW_PARSER_ERROR(JSON_ERROR_UNRESOLVED_TOKEN); // unknown token
+        }
+        
+        // store the value into its container, close the finished containers
+        while (complete) {
+            if (depth == 0) return json_parser_itemObject(parser, &value);
+            
+            struct JSON_PARSER_FRAME * frame = &parser->_frames[depth - 1];
+            if (frame->type == JSON_OBJECT_MAP) {
+                parser->_items[count - 1].type = value.type; // the key is pushed already
+                parser->_items[count - 1].value = value.value;
+            }
+            else {
+                json_parser_reserveItem(parser, count);
+                value.key = NULL;
+                parser->_items[count++] = value;
+            }
+            
+            // read "," or the closing bracket
+            NEXT_TOKEN;
+            if (tokenizer->token.type == JSON_TOKEN_EOF) THROW_PARSER_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+            if (tokenizer->token.type == JSON_TOKEN_COMMA) {
+                NEXT_TOKEN;
+                if (frame->type == JSON_OBJECT_MAP) READ_KEY;
+                complete = false;
+            }
+            else if (tokenizer->token.type == (frame->type == JSON_OBJECT_MAP ? JSON_TOKEN_BRACE_CLOSING : JSON_TOKEN_BRACKET_CLOSING)) {
+                value.type = JSON_OBJECT_NULL;
+                value.value.object = json_parser_closeContainer(parser, frame, count);
+                if (value.value.object == NULL) THROW_PARSER_ERROR(JSON_ERROR_DUPLICATE_KEY);
+                count = frame->start;
+                depth--;
+            }
+            else {
+                json_token_free(&tokenizer->token);
+                THROW_PARSER_ERROR(frame->type == JSON_OBJECT_MAP ? JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACE : JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET);
+            }
+        }
+    }
+}
+
+#undef READ_KEY
+#undef NEXT_TOKEN
+#undef THROW_PARSER_ERROR
@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "json_reader.h"
 #include "json_object.h"
+#include "json_tokenizer.h"
 #include "json_error.h"
 
 
@@ -39,15 +40,26 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 extern "C" {
 #endif
 
-#define JSON_BUFFER_DEFAULT_SIZE 1024
+#define JSON_BUFFER_DEFAULT_SIZE JSON_READER_BLOCK_SIZE
     
     
 /* Parses JSON. */
 extern json_object * json_parse(json_reader reader, json_error * error);
 
-/* Parses a JSON string. */
+#ifndef JSON_PARSE_PRESCAN_MIN_LENGTH
+#define JSON_PARSE_PRESCAN_MIN_LENGTH (1 << 20) // smaller strings aren't presized by json_parse_string
+#endif
+    
+/* Parses a JSON string (large strings are parsed with presized containers, see json_parse_string_ext). */
 extern json_object * json_parse_string(const char * string, json_error * error);
 
+/* 
+ * Parses a JSON string. With presize, a structural pre-scan counts the items of
+ * every container first, so they're allocated at their final size (no doubling or
+ * rehashing). The pre-scan pays off for large containers only.
+ */
+extern json_object * json_parse_string_ext(const char * string, bool presize, json_error * error);
+
 /* Parses a JSON file. */
 extern json_object * json_parse_file_buf(const char * filename, bool buffered, int bufferSize, json_error * error);
 
@@ -56,9 +68,90 @@ inline static json_object * json_parse_file(const char * filename, json_error *
     return json_parse_file_buf(filename, true, JSON_BUFFER_DEFAULT_SIZE, error);
 }
     
-/* Parses JSON incoming from a steam. */
+/* Parses JSON incoming from a steam (reads it to the end in blocks). */
 extern json_object * json_parse_stream(FILE * stream, json_error * error);
 
+/* Parses a value starting with the current token of the tokenizer. */
+extern json_object * json_parse_value(json_tokenizer * tokenizer, json_error * error);
+
+
+/* Options of a reusable parser. */
+typedef struct JSON_PARSER_OPTIONS {
+    size_t arenaBlockSize; // builds the trees in an arena with blocks of this size (0 = allocated with malloc)
+    int internedKeys; // number of map keys shared by all the trees of the arena (0 = no interning)
+    json_duplicate_keys duplicateKeys; // handling of duplicate map keys (an error is reported at the end of the map)
+    bool packNumbers; // stores arrays of integers (or floats) as packed arrays, not with an arena (see json_array_init_packed)
+} json_parser_options;
+
+struct JSON_PARSER_ITEM;
+struct JSON_PARSER_FRAME;
+struct JSON_PARSER_KEY;
+
+/* 
+ * Reusable parser for many documents. The tokenizer's scratch buffer and the
+ * stack of the open containers are kept between the parses, so parsing a document
+ * doesn't allocate anything except the resulting objects. The containers are
+ * allocated with their final size once they're closed.
+ * 
+ * With an arena, the trees are allocated from it and the arena is reset at the
+ * start of every parse, so a tree is valid until the next parse only (it doesn't
+ * have to be freed). Interned keys of maps are stored just once for all the trees.
+ */
+typedef struct JSON_PARSER {
+    json_tokenizer tokenizer;
+    json_parser_options options;
+    json_arena arena;
+    
+    // private fields
+    json_reader_window _window;
+    struct JSON_PARSER_ITEM * _items; // values of the open containers
+    int _itemCapacity;
+    struct JSON_PARSER_FRAME * _frames; // open containers
+    int _frameCapacity;
+    struct JSON_PARSER_KEY * _keys; // interned keys (a slot per hash, never evicted)
+    json_arena _keyArena;
+} json_parser;
+
+/* Initializes a parser allocating the trees with malloc, it has to be freed with json_parser_free. */
+extern void json_parser_init(json_parser * parser);
+
+/* Initializes a parser with the given options (see json_parser_init). */
+extern void json_parser_init_ext(json_parser * parser, const json_parser_options * options);
+
+/* Parses a JSON document of the given length (the buffer doesn't have to be null-terminated). */
+extern json_object * json_parser_parse(json_parser * parser, const char * buffer, size_t length, json_error * error);
+
+/* Frees the parser's buffers (and the arena with all its trees). */
+extern void json_parser_free(json_parser * parser);
+
+
+/* 
+ * Iterator over a sequence of concatenated JSON documents (like {...}{...} 1 2),
+ * the whitespace between the documents is optional unless they are numbers or
+ * literals. The documents are parsed one at a time by the same parser (see
+ * json_parser for the options), the iteration stops at the end of the input
+ * or at the first error.
+ */
+typedef struct JSON_DOCUMENT_ITERATOR {
+    json_object * document; // the current document (owned by the caller unless it's in the arena)
+    int index; // index of the current document
+    bool failed; // the iteration stopped because of an error
+    json_error error;
+    json_parser parser;
+} json_document_iterator;
+
+/* Initializes an iterator over the documents read from the reader, the options may be NULL. */
+extern void json_document_iterator_init(json_document_iterator * iterator, json_reader reader, const json_parser_options * options);
+
+/* Initializes an iterator over the documents in a buffer of the given length. */
+extern void json_document_iterator_init_buffer(json_document_iterator * iterator, const char * buffer, size_t length, const json_parser_options * options);
+
+/* Parses the next document, returns false at the end of the input or on an error. */
+extern bool json_document_iterator_next(json_document_iterator * iterator);
+
+/* Frees the iterator (the documents which were returned are not freed). */
+extern void json_document_iterator_free(json_document_iterator * iterator);
+
 
 
 #ifdef	__cplusplus
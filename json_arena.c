@@ -0,0 +1,94 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "json_arena.h"
+#include "json_debug.h"
+
+/* Block of an arena. */
+struct JSON_ARENA_BLOCK {
+    struct JSON_ARENA_BLOCK * next;
+    size_t size;
+    char data[]; // aligned, the header is a pointer and a size_t
+};
+
+/* Initializes an empty arena. */
+void json_arena_init(json_arena * arena, size_t blockSize) {
+    arena->blockSize = blockSize > 0 ? blockSize : JSON_ARENA_BLOCK_SIZE;
+    arena->_first = NULL;
+    arena->_current = NULL;
+    arena->_position = NULL;
+    arena->_end = NULL;
+}
+
+/* Allocates memory from the next block, which is large enough (a new one if there is none). */
+void * json_arena_alloc_block(json_arena * arena, size_t size) {
+    struct JSON_ARENA_BLOCK * block = arena->_current ? arena->_current->next : arena->_first;
+    while (block != NULL && block->size < size) block = block->next; // skipped blocks wait for the reset
+    
+    if (block == NULL) {
+        // insert a new block after the current one
+        size_t blockSize = size > arena->blockSize ? size : arena->blockSize;
+        JSON_DEBUG_MALLOC;
+        block = malloc(sizeof(struct JSON_ARENA_BLOCK) + blockSize);
+        block->size = blockSize;
+        if (arena->_current != NULL) {
+            block->next = arena->_current->next;
+            arena->_current->next = block;
+        }
+        else {
+            block->next = arena->_first;
+            arena->_first = block;
+        }
+    }
+    
+    arena->_current = block;
+    arena->_position = block->data + size;
+    arena->_end = block->data + block->size;
+    return block->data;
+}
+
+/* Releases all the allocated memory, the blocks are kept. */
+void json_arena_reset(json_arena * arena) {
+    arena->_current = NULL;
+    arena->_position = NULL;
+    arena->_end = NULL;
+}
+
+/* Frees the blocks of the arena. */
+void json_arena_free(json_arena * arena) {
+    struct JSON_ARENA_BLOCK * block = arena->_first;
+    while (block != NULL) {
+        struct JSON_ARENA_BLOCK * next = block->next;
+        free(block);
+        JSON_DEBUG_FREE;
+        block = next;
+    }
+    json_arena_init(arena, arena->blockSize);
+}
@@ -0,0 +1,83 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_ARENA_H
+#define	JSON_ARENA_H
+
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define JSON_ARENA_BLOCK_SIZE 65536
+#define JSON_ARENA_ALIGNMENT 8
+
+struct JSON_ARENA_BLOCK;
+
+/* 
+ * Arena allocator: memory is taken from large blocks and released all at once.
+ * Resetting the arena keeps the blocks for the next use.
+ */
+typedef struct JSON_ARENA {
+    size_t blockSize;
+    
+    // private fields
+    struct JSON_ARENA_BLOCK * _first;
+    struct JSON_ARENA_BLOCK * _current;
+    char * _position;
+    char * _end;
+} json_arena;
+
+/* Initializes an empty arena, which allocates blocks of the given size (0 for the default size). */
+extern void json_arena_init(json_arena * arena, size_t blockSize);
+
+/* Allocates memory from a new block (called by json_arena_alloc). */
+extern void * json_arena_alloc_block(json_arena * arena, size_t size);
+
+/* Allocates memory from the arena, it's aligned to JSON_ARENA_ALIGNMENT. */
+static inline void * json_arena_alloc(json_arena * arena, size_t size) {
+    size = (size + JSON_ARENA_ALIGNMENT - 1) & ~(size_t)(JSON_ARENA_ALIGNMENT - 1);
+    if ((size_t)(arena->_end - arena->_position) < size) return json_arena_alloc_block(arena, size);
+    void * memory = arena->_position;
+    arena->_position += size;
+    return memory;
+}
+
+/* Releases all the allocated memory at once, the blocks are kept for reuse. */
+extern void json_arena_reset(json_arena * arena);
+
+/* Frees the blocks of the arena. */
+extern void json_arena_free(json_arena * arena);
+
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* JSON_ARENA_H */
+
@@ -0,0 +1,464 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "json.h"
+#include "json_async.h"
+#include "json_debug.h"
+
+/* Range of a document in the buffer. */
+typedef struct JSON_ASYNC_DOCUMENT {
+    size_t start;
+    size_t end;
+} json_async_document;
+
+/* 
+ * Finds the end of the document starting at p. Only the brackets and quotes are
+ * matched, the parser validates the document.
+ */
+static const char * json_async_documentEnd(const char * p, const char * end) {
+    int depth = 0;
+    do {
+        char c = *p++;
+        if (c == '"') { // skip the string
+            while (p < end && *p != '"') p += (*p == '\\') ? 2 : 1;
+            if (p < end) p++;
+            else p = end;
+        }
+        else if (c == '{' || c == '[') depth++;
+        else if (c == '}' || c == ']') depth--;
+        else if (depth == 0) { // a number or a literal
+            while (p < end && strchr(" \t\n\r\f{}[]\",:", *p) == NULL) p++;
+        }
+    } while (depth > 0 && p < end);
+    return p;
+}
+
+/* Splits the buffer into documents, returns their number. */
+static int json_async_splitDocuments(const char * buffer, size_t length, json_async_document ** documents) {
+    int count = 0, capacity = 16;
+    JSON_DEBUG_MALLOC;
+    *documents = malloc(sizeof(json_async_document) * capacity);
+    
+    const char * p = buffer, * end = buffer + length;
+    for (;;) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == '\f')) p++;
+        if (p == end || *p == '\0') break; // the end of the input for the tokenizer too
+        
+        if (count == capacity) {
+            capacity *= 2;
+            *documents = realloc(*documents, sizeof(json_async_document) * capacity);
+        }
+        const char * documentEnd = json_async_documentEnd(p, end);
+        (*documents)[count].start = p - buffer;
+        (*documents)[count].end = documentEnd - buffer;
+        count++;
+        p = documentEnd;
+    }
+    return count;
+}
+
+/* Makes the error position of a document relative to the whole buffer. */
+static void json_async_documentError(const char * buffer, size_t start, json_error * error) {
+    int line = 1, pos = 0;
+    for (size_t i = 0; i < start; i++) {
+        if (buffer[i] == '\n') {
+            line++;
+            pos = 0;
+        }
+        else pos++;
+    }
+    if (error->line == 1) error->pos += pos;
+    error->line += line - 1;
+}
+
+/* Frees the parsed documents after an error. */
+static void json_async_freeDocuments(json_object ** results, int count) {
+    for (int i = 0; i < count; i++) {
+        if (results[i] != NULL) json_object_free(results[i]);
+    }
+    free(results);
+    JSON_DEBUG_FREE;
+}
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define JSON_ASYNC_MAX_THREADS 64
+#define JSON_ASYNC_MAX_READERS 16 // more reads are kept in flight by the readers' slots
+
+/* A loaded file waiting for a parser. */
+typedef struct JSON_ASYNC_BUFFER {
+    int index;
+    char * data;
+} json_async_buffer;
+
+/* Shared state of the readers and parsers. */
+typedef struct JSON_ASYNC {
+    const char * const * filenames;
+    int count;
+    json_object ** results;
+    json_error * errors;
+    
+    pthread_mutex_t lock;
+    pthread_cond_t loaded; // a buffer was queued or the readers finished
+    pthread_cond_t parsed; // a slot for reading is free
+    
+    int nextFile; // next file to read
+    int slots; // files which can be read ahead
+    int readers; // running readers
+    json_async_buffer * queue; // ring of loaded buffers
+    int queueStart, queueSize, queueCapacity;
+    bool ok;
+} json_async;
+
+
+/* Stores a result of a file. */
+static void json_async_result(json_async * async, int index, json_object * obj, const json_error * error) {
+    async->results[index] = obj;
+    if (async->errors) async->errors[index] = error ? *error : JSON_ERROR_EMPTY;
+}
+
+/* Reads the whole file with pread, returns NULL on failure. */
+static char * json_async_readFile(const char * filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    
+    struct stat info;
+    size_t capacity = (fstat(fd, &info) == 0 && info.st_size > 0) ? (size_t)info.st_size + 1 : JSON_READER_BLOCK_SIZE;
+    size_t length = 0;
+    JSON_DEBUG_MALLOC;
+    char * data = malloc(capacity);
+    
+    for (;;) {
+        if (length + 1 == capacity) { // not a regular file or it grew
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+        ssize_t count = pread(fd, data + length, capacity - 1 - length, length);
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) {
+            free(data);
+            JSON_DEBUG_FREE;
+            close(fd);
+            return NULL;
+        }
+        if (count == 0) break;
+        length += count;
+    }
+    close(fd);
+    
+    data[length] = '\0';
+    return data;
+}
+
+/* Reader thread, loads the files into the queue. */
+static void * json_async_reader(void * arg) {
+    json_async * async = arg;
+    
+    pthread_mutex_lock(&async->lock);
+    for (;;) {
+        while (async->slots == 0 && async->nextFile < async->count) pthread_cond_wait(&async->parsed, &async->lock);
+        if (async->nextFile == async->count) break;
+        int index = async->nextFile++;
+        async->slots--;
+        pthread_mutex_unlock(&async->lock);
+        
+        char * data = json_async_readFile(async->filenames[index]);
+        
+        pthread_mutex_lock(&async->lock);
+        if (data == NULL) {
+            json_error error = {JSON_ERROR_IO, 0, 0};
+            json_async_result(async, index, NULL, &error);
+            async->ok = false;
+            async->slots++;
+            continue;
+        }
+        int position = (async->queueStart + async->queueSize++) % async->queueCapacity;
+        async->queue[position].index = index;
+        async->queue[position].data = data;
+        pthread_cond_signal(&async->loaded);
+    }
+    if (--async->readers == 0) pthread_cond_broadcast(&async->loaded);
+    pthread_mutex_unlock(&async->lock);
+    return NULL;
+}
+
+/* Parser thread, parses the loaded files. */
+static void * json_async_parser(void * arg) {
+    json_async * async = arg;
+    
+    pthread_mutex_lock(&async->lock);
+    for (;;) {
+        while (async->queueSize == 0 && async->readers > 0) pthread_cond_wait(&async->loaded, &async->lock);
+        if (async->queueSize == 0) break; // all files were read
+        json_async_buffer buffer = async->queue[async->queueStart];
+        async->queueStart = (async->queueStart + 1) % async->queueCapacity;
+        async->queueSize--;
+        pthread_mutex_unlock(&async->lock);
+        
+        json_error error = JSON_ERROR_EMPTY;
+        json_object * obj = json_parse_string(buffer.data, &error);
+        free(buffer.data);
+        JSON_DEBUG_FREE;
+        
+        pthread_mutex_lock(&async->lock);
+        json_async_result(async, buffer.index, obj, obj ? NULL : &error);
+        if (obj == NULL) async->ok = false;
+        async->slots++;
+        pthread_cond_signal(&async->parsed);
+    }
+    pthread_mutex_unlock(&async->lock);
+    return NULL;
+}
+
+/* Parses many files in parallel. */
+bool json_parse_files_async(const char * const * filenames, int count, json_object ** results, json_error * errors, const json_async_options * options) {
+    if (count <= 0) return true;
+    
+    int threads = options ? options->threads : 0;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if (threads > JSON_ASYNC_MAX_THREADS) threads = JSON_ASYNC_MAX_THREADS;
+    if (threads > count) threads = count;
+    int reads = options && options->reads > 0 ? options->reads : 2 * threads;
+    if (reads > count) reads = count;
+    int readers = reads < JSON_ASYNC_MAX_READERS ? reads : JSON_ASYNC_MAX_READERS;
+    
+    json_async async;
+    async.filenames = filenames;
+    async.count = count;
+    async.results = results;
+    async.errors = errors;
+    pthread_mutex_init(&async.lock, NULL);
+    pthread_cond_init(&async.loaded, NULL);
+    pthread_cond_init(&async.parsed, NULL);
+    async.nextFile = 0;
+    async.slots = reads;
+    async.readers = 0;
+    JSON_DEBUG_MALLOC;
+    async.queue = malloc(sizeof(json_async_buffer) * count);
+    async.queueStart = 0;
+    async.queueSize = 0;
+    async.queueCapacity = count;
+    async.ok = true;
+    
+    pthread_t threadIds[JSON_ASYNC_MAX_READERS + JSON_ASYNC_MAX_THREADS];
+    int started = 0;
+    for (int i = 0; i < readers; i++) {
+        // counted before it starts, so the parsers don't finish before the reader
+        pthread_mutex_lock(&async.lock);
+        async.readers++;
+        pthread_mutex_unlock(&async.lock);
+        if (pthread_create(&threadIds[started], NULL, json_async_reader, &async) == 0) started++;
+        else {
+            pthread_mutex_lock(&async.lock);
+            async.readers--;
+            pthread_mutex_unlock(&async.lock);
+        }
+    }
+    
+    if (started == 0) {
+        // no reader could be started, the calling thread reads and parses the files one by one
+        for (int i = 0; i < count; i++) {
+            json_error error = {JSON_ERROR_IO, 0, 0};
+            json_object * obj = NULL;
+            char * data = json_async_readFile(filenames[i]);
+            if (data != NULL) {
+                error = JSON_ERROR_EMPTY;
+                obj = json_parse_string(data, &error);
+                free(data);
+                JSON_DEBUG_FREE;
+            }
+            json_async_result(&async, i, obj, obj ? NULL : &error);
+            if (obj == NULL) async.ok = false;
+        }
+    }
+    else {
+        int startedReaders = started;
+        for (int i = 0; i < threads; i++) {
+            if (pthread_create(&threadIds[started], NULL, json_async_parser, &async) == 0) started++;
+        }
+        if (started == startedReaders) json_async_parser(&async); // the calling thread parses instead
+    }
+    
+    for (int i = 0; i < started; i++) pthread_join(threadIds[i], NULL);
+    
+    free(async.queue);
+    JSON_DEBUG_FREE;
+    pthread_cond_destroy(&async.parsed);
+    pthread_cond_destroy(&async.loaded);
+    pthread_mutex_destroy(&async.lock);
+    return async.ok;
+}
+
+#define JSON_ASYNC_DOCUMENT_BATCH 32 // documents taken by a parser at once
+
+/* Shared state of the document parsers. */
+typedef struct JSON_ASYNC_DOCUMENTS {
+    const char * buffer;
+    const json_async_document * documents;
+    json_object ** results;
+    int count;
+    
+    pthread_mutex_t lock;
+    int nextDocument; // next document to parse
+    int failed; // index of the first invalid document (count if there is none)
+    json_error error;
+} json_async_documents;
+
+/* Parser thread, parses batches of the documents. */
+static void * json_async_documentParser(void * arg) {
+    json_async_documents * async = arg;
+    json_parser parser;
+    json_parser_init(&parser);
+    
+    pthread_mutex_lock(&async->lock);
+    while (async->nextDocument < async->failed) { // documents after an invalid one are not parsed
+        int first = async->nextDocument;
+        int last = first + JSON_ASYNC_DOCUMENT_BATCH < async->failed ? first + JSON_ASYNC_DOCUMENT_BATCH : async->failed;
+        async->nextDocument = last;
+        pthread_mutex_unlock(&async->lock);
+        
+        int failed = -1;
+        json_error error = JSON_ERROR_EMPTY;
+        for (int i = first; i < last; i++) {
+            const json_async_document * document = &async->documents[i];
+            async->results[i] = json_parser_parse(&parser, async->buffer + document->start, document->end - document->start, &error);
+            if (async->results[i] == NULL) {
+                failed = i;
+                break;
+            }
+        }
+        
+        pthread_mutex_lock(&async->lock);
+        if (failed >= 0 && failed < async->failed) {
+            async->failed = failed;
+            async->error = error;
+        }
+    }
+    pthread_mutex_unlock(&async->lock);
+    
+    json_parser_free(&parser);
+    return NULL;
+}
+
+/* Parses concatenated documents in parallel. */
+json_object ** json_parse_documents_async(const char * buffer, size_t length, int * count, json_error * error, const json_async_options * options) {
+    json_async_document * documents;
+    *count = json_async_splitDocuments(buffer, length, &documents);
+    
+    int threads = options ? options->threads : 0;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if (threads > JSON_ASYNC_MAX_THREADS) threads = JSON_ASYNC_MAX_THREADS;
+    int batches = (*count + JSON_ASYNC_DOCUMENT_BATCH - 1) / JSON_ASYNC_DOCUMENT_BATCH;
+    if (threads > batches) threads = batches;
+    
+    json_async_documents async;
+    async.buffer = buffer;
+    async.documents = documents;
+    async.count = *count;
+    JSON_DEBUG_MALLOC;
+    async.results = calloc(*count > 0 ? *count : 1, sizeof(json_object*));
+    pthread_mutex_init(&async.lock, NULL);
+    async.nextDocument = 0;
+    async.failed = *count;
+    async.error = JSON_ERROR_EMPTY;
+    
+    // the calling thread is one of the parsers
+    pthread_t threadIds[JSON_ASYNC_MAX_THREADS];
+    int started = 0;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&threadIds[started], NULL, json_async_documentParser, &async) == 0) started++;
+    }
+    json_async_documentParser(&async);
+    for (int i = 0; i < started; i++) pthread_join(threadIds[i], NULL);
+    pthread_mutex_destroy(&async.lock);
+    
+    if (async.failed < *count) {
+        json_async_documentError(buffer, documents[async.failed].start, &async.error);
+        if (error) *error = async.error;
+        json_async_freeDocuments(async.results, *count);
+        async.results = NULL;
+    }
+    free(documents);
+    JSON_DEBUG_FREE;
+    return async.results;
+}
+
+#else
+
+/* Parses concatenated documents (sequentially, no threads on this platform). */
+json_object ** json_parse_documents_async(const char * buffer, size_t length, int * count, json_error * error, const json_async_options * options) {
+    json_async_document * documents;
+    *count = json_async_splitDocuments(buffer, length, &documents);
+    JSON_DEBUG_MALLOC;
+    json_object ** results = calloc(*count > 0 ? *count : 1, sizeof(json_object*));
+    
+    json_parser parser;
+    json_parser_init(&parser);
+    for (int i = 0; i < *count; i++) {
+        json_error documentError = JSON_ERROR_EMPTY;
+        results[i] = json_parser_parse(&parser, buffer + documents[i].start, documents[i].end - documents[i].start, &documentError);
+        if (results[i] == NULL) {
+            json_async_documentError(buffer, documents[i].start, &documentError);
+            if (error) *error = documentError;
+            json_async_freeDocuments(results, *count);
+            results = NULL;
+            break;
+        }
+    }
+    json_parser_free(&parser);
+    free(documents);
+    JSON_DEBUG_FREE;
+    return results;
+}
+
+/* Parses many files (sequentially, no threads on this platform). */
+bool json_parse_files_async(const char * const * filenames, int count, json_object ** results, json_error * errors, const json_async_options * options) {
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        json_error error = JSON_ERROR_EMPTY;
+        results[i] = json_parse_file(filenames[i], &error);
+        if (errors) errors[i] = error;
+        if (results[i] == NULL) ok = false;
+    }
+    return ok;
+}
+
+#endif
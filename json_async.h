@@ -0,0 +1,72 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_ASYNC_H
+#define	JSON_ASYNC_H
+
+#include "json_object.h"
+#include "json_error.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Options of the parallel file parsing (zeros select the defaults). */
+typedef struct JSON_ASYNC_OPTIONS {
+    int threads; // parsing threads (the number of CPUs by default)
+    int reads; // files read ahead (in flight or waiting for a parser, 2 * threads by default)
+} json_async_options;
+
+/* 
+ * Parses many files, overlapping the reading with the parsing. Reader threads
+ * (at most 16) load the files with pread, a pool of parser threads parses the
+ * loaded buffers. If no thread can be started, the files are parsed one by one
+ * on the calling thread.
+ * 
+ * The results (and errors, which may be NULL) are stored at the file's index,
+ * failed files have NULL results. Returns true if all files were parsed. The
+ * options may be NULL.
+ */
+extern bool json_parse_files_async(const char * const * filenames, int count, json_object ** results, json_error * errors, const json_async_options * options);
+
+/* 
+ * Parses a buffer of concatenated JSON documents (see json_document_iterator) in
+ * parallel. The documents are delimited by a quick scan of the brackets and quotes,
+ * then they're parsed by a pool of threads (options->reads isn't used).
+ * 
+ * Returns an array of the documents (the caller frees it with free), the number
+ * of the documents is stored to count. Returns NULL if any document is invalid,
+ * the error then describes the first invalid one.
+ */
+extern json_object ** json_parse_documents_async(const char * buffer, size_t length, int * count, json_error * error, const json_async_options * options);
+
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* JSON_ASYNC_H */
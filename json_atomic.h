@@ -0,0 +1,58 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_ATOMIC_H
+#define	JSON_ATOMIC_H
+
+/* 
+ * Atomic access to counters and pointers shared between threads (internal).
+ * The relaxed operations are for statistics, the others order the memory
+ * accesses around them (reference counts, lazily published pointers).
+ */
+
+#if defined(__GNUC__)
+#define JSON_ATOMIC_LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define JSON_ATOMIC_STORE(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELAXED)
+#define JSON_ATOMIC_ADD(ptr, value) __atomic_fetch_add(ptr, value, __ATOMIC_RELAXED)
+#define JSON_ATOMIC_CAS(ptr, expected, value) __atomic_compare_exchange_n(ptr, expected, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define JSON_ATOMIC_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define JSON_ATOMIC_RELEASE(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+#define JSON_ATOMIC_PUBLISH(ptr, expected, value) __atomic_compare_exchange_n(ptr, expected, value, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define JSON_ATOMIC_DECREMENT(ptr) __atomic_sub_fetch(ptr, 1, __ATOMIC_ACQ_REL)
+#else
+// no atomics, the values can't be shared between threads
+#define JSON_ATOMIC_LOAD(ptr) (*(ptr))
+#define JSON_ATOMIC_STORE(ptr, value) (*(ptr) = (value))
+#define JSON_ATOMIC_ADD(ptr, value) (*(ptr) += (value))
+#define JSON_ATOMIC_CAS(ptr, expected, value) (*(ptr) == *(expected) ? (*(ptr) = (value), 1) : (*(expected) = *(ptr), 0))
+#define JSON_ATOMIC_ACQUIRE(ptr) (*(ptr))
+#define JSON_ATOMIC_RELEASE(ptr, value) (*(ptr) = (value))
+#define JSON_ATOMIC_PUBLISH(ptr, expected, value) JSON_ATOMIC_CAS(ptr, expected, value)
+#define JSON_ATOMIC_DECREMENT(ptr) (--*(ptr))
+#endif
+
+#endif	/* JSON_ATOMIC_H */
@@ -0,0 +1,640 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "json_binary.h"
+#include "json_object.h"
+#include "json_debug.h"
+#include "json_error.h"
+
+
+#define JSON_BUFFER_CAPACITY 64
+
+/* Native format header (magic and version). */
+static const unsigned char json_binary_header[4] = { 'J', 'S', 'D', 2 };
+
+/* Native format value tags. */
+enum {
+    JSON_BINARY_NULL = 0,
+    JSON_BINARY_INT,
+    JSON_BINARY_FALSE,
+    JSON_BINARY_TRUE,
+    JSON_BINARY_FLOAT,
+    JSON_BINARY_STRING,
+    JSON_BINARY_ARRAY,
+    JSON_BINARY_MAP
+};
+
+/* CBOR major types. */
+enum {
+    JSON_CBOR_UINT = 0,
+    JSON_CBOR_NEGINT,
+    JSON_CBOR_BYTES,
+    JSON_CBOR_TEXT,
+    JSON_CBOR_ARRAY,
+    JSON_CBOR_MAP,
+    JSON_CBOR_TAG,
+    JSON_CBOR_SIMPLE
+};
+
+#define JSON_CBOR_INDEFINITE 31
+#define JSON_CBOR_BREAK 0xff
+
+
+/* Initializes an empty buffer. */
+void json_buffer_init(json_buffer * buffer) {
+    JSON_DEBUG_MALLOC;
+    buffer->data = malloc(JSON_BUFFER_CAPACITY);
+    buffer->size = 0;
+    buffer->capacity = JSON_BUFFER_CAPACITY;
+}
+
+/* Deletes the buffer contents. */
+void json_buffer_free(json_buffer * buffer) {
+    free(buffer->data);
+    JSON_DEBUG_FREE;
+    buffer->data = NULL;
+    buffer->size = buffer->capacity = 0;
+}
+
+/* Appends the given number of uninitialized bytes, returns pointer to them. */
+unsigned char * json_buffer_grow(json_buffer * buffer, size_t length) {
+    if (buffer->size + length > buffer->capacity) {
+        while (buffer->size + length > buffer->capacity) buffer->capacity *= 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+    unsigned char * ptr = buffer->data + buffer->size;
+    buffer->size += length;
+    return ptr;
+}
+
+static inline void json_buffer_putByte(json_buffer * buffer, unsigned char byte) {
+    *json_buffer_grow(buffer, 1) = byte;
+}
+
+static inline void json_buffer_putBytes(json_buffer * buffer, const void * data, size_t length) {
+    memcpy(json_buffer_grow(buffer, length), data, length);
+}
+
+/* Writes a 32-bit number in little-endian order. */
+static inline void json_buffer_putU32(json_buffer * buffer, uint32_t value) {
+    unsigned char * ptr = json_buffer_grow(buffer, 4);
+    ptr[0] = value; ptr[1] = value >> 8; ptr[2] = value >> 16; ptr[3] = value >> 24;
+}
+
+static inline uint32_t json_binary_floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    return bits;
+}
+
+
+/* Decoder input. */
+typedef struct JSON_BINARY_INPUT {
+    const unsigned char * data;
+    size_t size;
+    size_t pos;
+    json_error * error;
+    bool rehash; // the process's seed differs from the seed of the stored hashes
+    int depth; // open containers
+} json_binary_input;
+
+/* Reports an error at the current position. */
+static bool json_binary_error(json_binary_input * input, int code) {
+    if (input->error) {
+        input->error->code = code;
+        input->error->line = 0;
+        input->error->pos = (int)input->pos;
+    }
+    return false;
+}
+
+/* Reports invalid data. */
+static bool json_binary_fail(json_binary_input * input) {
+    return json_binary_error(input, JSON_ERROR_BINARY_DATA);
+}
+
+/* Opens a nested item, the decoders are recursive, so the depth is limited. */
+static inline bool json_binary_enter(json_binary_input * input) {
+    if (input->depth == JSON_BINARY_MAX_DEPTH) return json_binary_error(input, JSON_ERROR_TOO_DEEP);
+    input->depth++;
+    return true;
+}
+
+/* Checks that a decoded map key has no NUL inside (the keys are NUL-terminated), an invalid key is freed. */
+static inline bool json_binary_checkKey(json_binary_input * input, const char * key, size_t length) {
+    if (memchr(key, '\0', length) == NULL) return true;
+    free((void*)key);
+    JSON_DEBUG_FREE;
+    return json_binary_fail(input);
+}
+
+#define THROW_ERROR { json_binary_fail(input); return NULL; }
+
+/* Checks that the given number of bytes is available. */
+static inline bool json_binary_available(json_binary_input * input, size_t length) {
+    return input->size - input->pos >= length;
+}
+
+/* Reads a 32-bit little-endian number. */
+static inline bool json_binary_readU32(json_binary_input * input, uint32_t * value) {
+    if (!json_binary_available(input, 4)) return json_binary_fail(input);
+    const unsigned char * ptr = input->data + input->pos;
+    *value = ptr[0] | (uint32_t)ptr[1] << 8 | (uint32_t)ptr[2] << 16 | (uint32_t)ptr[3] << 24;
+    input->pos += 4;
+    return true;
+}
+
+/* Reads a string of the given length into a new NUL-terminated buffer. */
+static char * json_binary_readString(json_binary_input * input, size_t length) {
+    if (!json_binary_available(input, length)) THROW_ERROR;
+    JSON_DEBUG_MALLOC;
+    char * string = malloc(length + 1);
+    memcpy(string, input->data + input->pos, length);
+    string[length] = '\0';
+    input->pos += length;
+    return string;
+}
+
+
+
+static void json_binary_encodeRecursive(json_buffer * buffer, const json_object * obj) {
+    switch (obj->type) {
+    case JSON_OBJECT_NULL:
+        json_buffer_putByte(buffer, JSON_BINARY_NULL);
+        break;
+    case JSON_OBJECT_INT:
+        json_buffer_putByte(buffer, JSON_BINARY_INT);
+        json_buffer_putU32(buffer, (uint32_t)json_int_value(obj));
+        break;
+    case JSON_OBJECT_BOOL:
+        json_buffer_putByte(buffer, json_bool_value(obj) ? JSON_BINARY_TRUE : JSON_BINARY_FALSE);
+        break;
+    case JSON_OBJECT_FLOAT:
+        json_buffer_putByte(buffer, JSON_BINARY_FLOAT);
+        json_buffer_putU32(buffer, json_binary_floatBits(json_float_value(obj)));
+        break;
+    case JSON_OBJECT_STRING:
+        json_buffer_putByte(buffer, JSON_BINARY_STRING);
+        json_buffer_putU32(buffer, json_string_length(obj));
+        json_buffer_putBytes(buffer, json_string_value(obj), json_string_length(obj));
+        break;
+    case JSON_OBJECT_ARRAY:
+        json_buffer_putByte(buffer, JSON_BINARY_ARRAY);
+        json_buffer_putU32(buffer, json_array_size(obj));
+        for (int i = 0; i < json_array_size(obj); i++) {
+            json_object scratch;
+            json_binary_encodeRecursive(buffer, json_array_peek(obj, i, &scratch));
+        }
+        break;
+    case JSON_OBJECT_MAP:
+    {
+        json_buffer_putByte(buffer, JSON_BINARY_MAP);
+        json_buffer_putU32(buffer, json_map_size(obj));
+        json_map_iterator iterator;
+        json_map_iterator_init(&iterator, obj);
+        while (json_map_iterator_next(&iterator)) {
+            size_t length = iterator.length;
+            json_buffer_putU32(buffer, json_map_hash_seeded(iterator.key, length, JSON_BINARY_HASH_SEED));
+            json_buffer_putU32(buffer, length);
+            json_buffer_putBytes(buffer, iterator.key, length);
+            json_binary_encodeRecursive(buffer, iterator.value);
+        }
+        break;
+    }
+    }
+}
+
+/* 
+ * Identifies the seed of the stored hashes. It's the same in every process, older
+ * images with hashes seeded by the writing process have another one.
+ */
+static uint32_t json_binary_fingerprint(void) {
+    return json_map_hash_seeded("jsondottir", 10, JSON_BINARY_HASH_SEED);
+}
+
+/* Encodes the object in the native binary format. */
+void json_binary_encode(json_buffer * buffer, const json_object * obj) {
+    json_buffer_putBytes(buffer, json_binary_header, sizeof(json_binary_header));
+    json_buffer_putU32(buffer, json_binary_fingerprint());
+    json_binary_encodeRecursive(buffer, obj);
+}
+
+static json_object * json_binary_decodeRecursive(json_binary_input * input) {
+    if (!json_binary_available(input, 1)) THROW_ERROR;
+    unsigned char tag = input->data[input->pos++];
+    uint32_t value;
+    
+    switch (tag) {
+    case JSON_BINARY_NULL:
+        return json_null();
+    case JSON_BINARY_INT:
+        if (!json_binary_readU32(input, &value)) return NULL;
+        return json_int((int)value);
+    case JSON_BINARY_FALSE:
+        return json_bool(false);
+    case JSON_BINARY_TRUE:
+        return json_bool(true);
+    case JSON_BINARY_FLOAT:
+    {
+        if (!json_binary_readU32(input, &value)) return NULL;
+        float floatValue;
+        memcpy(&floatValue, &value, 4);
+        return json_float(floatValue);
+    }
+    case JSON_BINARY_STRING:
+    {
+        if (!json_binary_readU32(input, &value)) return NULL;
+        char * string = json_binary_readString(input, value);
+        if (string == NULL) return NULL;
+        return json_string_ref_len(string, value);
+    }
+    case JSON_BINARY_ARRAY:
+    {
+        // every item takes at least one byte
+        if (!json_binary_readU32(input, &value)) return NULL;
+        if (value > INT_MAX || !json_binary_available(input, value)) THROW_ERROR;
+        if (!json_binary_enter(input)) return NULL;
+        
+        json_object * array = json_array_ext(value);
+        for (uint32_t i = 0; i < value; i++) {
+            // numbers are read directly, without recursion
+            unsigned char itemTag = json_binary_available(input, 5) ? input->data[input->pos] : JSON_BINARY_NULL;
+            if (itemTag == JSON_BINARY_INT || itemTag == JSON_BINARY_FLOAT) {
+                uint32_t number = 0;
+                input->pos++;
+                json_binary_readU32(input, &number);
+                if (itemTag == JSON_BINARY_INT) json_array_add_int(array, (int)number);
+                else {
+                    float floatValue;
+                    memcpy(&floatValue, &number, 4);
+                    json_array_add_float(array, floatValue);
+                }
+                continue;
+            }
+            
+            json_object * item = json_binary_decodeRecursive(input);
+            if (item == NULL) {
+                json_object_free(array);
+                return NULL;
+            }
+            json_array_add(array, item);
+        }
+        input->depth--;
+        return array;
+    }
+    case JSON_BINARY_MAP:
+    {
+        // every item takes at least nine bytes
+        if (!json_binary_readU32(input, &value)) return NULL;
+        if (value > INT_MAX / 2 || !json_binary_available(input, (size_t)value * 9)) THROW_ERROR;
+        if (!json_binary_enter(input)) return NULL;
+        
+        json_object * map = json_map_ext(value);
+        for (uint32_t i = 0; i < value; i++) {
+            uint32_t hash, length;
+            char * key;
+            if (!json_binary_readU32(input, &hash) || !json_binary_readU32(input, &length)
+                    || (key = json_binary_readString(input, length)) == NULL || !json_binary_checkKey(input, key, length)) {
+                json_object_free(map);
+                return NULL;
+            }
+            json_object * item = json_binary_decodeRecursive(input);
+            if (item == NULL) {
+                free(key);
+                JSON_DEBUG_FREE;
+                json_object_free(map);
+                return NULL;
+            }
+            if (input->rehash) hash = json_map_hash_len(key, length);
+            json_object * replaced = json_map_put_hashed(map, key, length, hash, item, false);
+            if (replaced != NULL) json_object_free(replaced);
+        }
+        input->depth--;
+        return map;
+    }
+    default:
+        THROW_ERROR;
+    }
+}
+
+/* Decodes an object encoded by json_binary_encode. */
+json_object * json_binary_decode(const void * data, size_t size, json_error * error) {
+    json_binary_input input = { data, size, 0, error, false, 0 };
+    uint32_t fingerprint;
+    if (size < sizeof(json_binary_header) || memcmp(data, json_binary_header, sizeof(json_binary_header)) != 0) {
+        json_binary_fail(&input);
+        return NULL;
+    }
+    input.pos = sizeof(json_binary_header);
+    if (!json_binary_readU32(&input, &fingerprint)) return NULL;
+    input.rehash = fingerprint != json_binary_fingerprint() || !json_map_seed_equals(JSON_BINARY_HASH_SEED);
+    
+    json_object * obj = json_binary_decodeRecursive(&input);
+    if (obj != NULL && input.pos != size) {
+        json_object_free(obj);
+        json_binary_fail(&input);
+        return NULL;
+    }
+    return obj;
+}
+
+
+
+/* Writes a CBOR item head. */
+static void json_cbor_putHead(json_buffer * buffer, int major, uint64_t value) {
+    unsigned char head = major << 5;
+    if (value < 24) {
+        json_buffer_putByte(buffer, head | value);
+    }
+    else if (value <= 0xff) {
+        unsigned char * ptr = json_buffer_grow(buffer, 2);
+        ptr[0] = head | 24; ptr[1] = value;
+    }
+    else if (value <= 0xffff) {
+        unsigned char * ptr = json_buffer_grow(buffer, 3);
+        ptr[0] = head | 25; ptr[1] = value >> 8; ptr[2] = value;
+    }
+    else if (value <= 0xffffffff) {
+        unsigned char * ptr = json_buffer_grow(buffer, 5);
+        ptr[0] = head | 26;
+        ptr[1] = value >> 24; ptr[2] = value >> 16; ptr[3] = value >> 8; ptr[4] = value;
+    }
+    else {
+        unsigned char * ptr = json_buffer_grow(buffer, 9);
+        ptr[0] = head | 27;
+        for (int i = 0; i < 8; i++) ptr[1 + i] = value >> (56 - 8*i);
+    }
+}
+
+static void json_cbor_encodeRecursive(json_buffer * buffer, const json_object * obj) {
+    switch (obj->type) {
+    case JSON_OBJECT_NULL:
+        json_buffer_putByte(buffer, 0xf6);
+        break;
+    case JSON_OBJECT_INT:
+    {
+        int value = json_int_value(obj);
+        if (value >= 0) json_cbor_putHead(buffer, JSON_CBOR_UINT, value);
+        else json_cbor_putHead(buffer, JSON_CBOR_NEGINT, (uint64_t)(-(int64_t)value - 1));
+        break;
+    }
+    case JSON_OBJECT_BOOL:
+        json_buffer_putByte(buffer, json_bool_value(obj) ? 0xf5 : 0xf4);
+        break;
+    case JSON_OBJECT_FLOAT:
+    {
+        uint32_t bits = json_binary_floatBits(json_float_value(obj));
+        unsigned char * ptr = json_buffer_grow(buffer, 5);
+        ptr[0] = 0xfa;
+        ptr[1] = bits >> 24; ptr[2] = bits >> 16; ptr[3] = bits >> 8; ptr[4] = bits;
+        break;
+    }
+    case JSON_OBJECT_STRING:
+        json_cbor_putHead(buffer, JSON_CBOR_TEXT, json_string_length(obj));
+        json_buffer_putBytes(buffer, json_string_value(obj), json_string_length(obj));
+        break;
+    case JSON_OBJECT_ARRAY:
+        json_cbor_putHead(buffer, JSON_CBOR_ARRAY, json_array_size(obj));
+        for (int i = 0; i < json_array_size(obj); i++) {
+            json_object scratch;
+            json_cbor_encodeRecursive(buffer, json_array_peek(obj, i, &scratch));
+        }
+        break;
+    case JSON_OBJECT_MAP:
+    {
+        json_cbor_putHead(buffer, JSON_CBOR_MAP, json_map_size(obj));
+        json_map_iterator iterator;
+        json_map_iterator_init(&iterator, obj);
+        while (json_map_iterator_next(&iterator)) {
+            size_t length = strlen(iterator.key);
+            json_cbor_putHead(buffer, JSON_CBOR_TEXT, length);
+            json_buffer_putBytes(buffer, iterator.key, length);
+            json_cbor_encodeRecursive(buffer, iterator.value);
+        }
+        break;
+    }
+    }
+}
+
+/* Encodes the object as CBOR. */
+void json_cbor_encode(json_buffer * buffer, const json_object * obj) {
+    json_cbor_encodeRecursive(buffer, obj);
+}
+
+/* Reads a CBOR item head (major type, additional information and the argument). */
+static bool json_cbor_readHead(json_binary_input * input, int * major, int * info, uint64_t * value) {
+    if (!json_binary_available(input, 1)) return json_binary_fail(input);
+    unsigned char head = input->data[input->pos++];
+    *major = head >> 5;
+    *info = head & 31;
+    *value = 0;
+    
+    if (*info < 24) {
+        *value = *info;
+        return true;
+    }
+    if (*info == JSON_CBOR_INDEFINITE) return true;
+    if (*info > 27) return json_binary_fail(input);
+    
+    size_t length = (size_t)1 << (*info - 24);
+    if (!json_binary_available(input, length)) return json_binary_fail(input);
+    for (size_t i = 0; i < length; i++) *value = (*value << 8) | input->data[input->pos++];
+    return true;
+}
+
+/* Checks for (and consumes) the break of an indefinite item. */
+static inline bool json_cbor_break(json_binary_input * input) {
+    if (json_binary_available(input, 1) && input->data[input->pos] == JSON_CBOR_BREAK) {
+        input->pos++;
+        return true;
+    }
+    return false;
+}
+
+/* Decodes a half-precision float. */
+static float json_cbor_halfToFloat(unsigned half) {
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    float value;
+    if (exponent == 0) value = mantissa / 16777216.0f; // 2^24
+    else if (exponent != 31) value = (mantissa + 1024) * ((float)(1 << exponent) / 33554432.0f); // 2^25
+    else value = mantissa == 0 ? INFINITY : NAN;
+    return (half & 0x8000) ? -value : value;
+}
+
+/* Reads a text string (its head has been read already). */
+static char * json_cbor_readText(json_binary_input * input, uint64_t length, bool indefinite, int * textLength) {
+    if (!indefinite) {
+        if (length > INT_MAX) THROW_ERROR;
+        *textLength = length;
+        return json_binary_readString(input, length);
+    }
+    
+    // concatenate the chunks
+    JSON_DEBUG_MALLOC;
+    char * string = malloc(1);
+    size_t size = 0;
+    while (!json_cbor_break(input)) {
+        int major, info;
+        uint64_t chunk;
+        if (!json_cbor_readHead(input, &major, &info, &chunk) || major != JSON_CBOR_TEXT
+                || info == JSON_CBOR_INDEFINITE || !json_binary_available(input, chunk) || size + chunk > INT_MAX) {
+            free(string);
+            JSON_DEBUG_FREE;
+            THROW_ERROR;
+        }
+        string = realloc(string, size + chunk + 1);
+        memcpy(string + size, input->data + input->pos, chunk);
+        input->pos += chunk;
+        size += chunk;
+    }
+    string[size] = '\0';
+    *textLength = size;
+    return string;
+}
+
+static json_object * json_cbor_decodeRecursive(json_binary_input * input) {
+    int major, info;
+    uint64_t value;
+    if (!json_cbor_readHead(input, &major, &info, &value)) return NULL;
+    bool indefinite = info == JSON_CBOR_INDEFINITE;
+    
+    switch (major) {
+    case JSON_CBOR_UINT:
+        if (indefinite || value > INT_MAX) THROW_ERROR;
+        return json_int((int)value);
+    case JSON_CBOR_NEGINT:
+        if (indefinite || value > INT_MAX) THROW_ERROR;
+        return json_int((int)(-1 - (int64_t)value));
+    case JSON_CBOR_TEXT:
+    {
+        int length;
+        char * string = json_cbor_readText(input, value, indefinite, &length);
+        if (string == NULL) return NULL;
+        return json_string_ref_len(string, length);
+    }
+    case JSON_CBOR_ARRAY:
+    {
+        if (!indefinite && (value > INT_MAX || !json_binary_available(input, value))) THROW_ERROR;
+        if (!json_binary_enter(input)) return NULL;
+        
+        json_object * array = json_array_ext(indefinite ? 8 : (int)value);
+        for (uint64_t i = 0; indefinite ? !json_cbor_break(input) : i < value; i++) {
+            json_object * item = json_cbor_decodeRecursive(input);
+            if (item == NULL) {
+                json_object_free(array);
+                return NULL;
+            }
+            json_array_add(array, item);
+        }
+        input->depth--;
+        return array;
+    }
+    case JSON_CBOR_MAP:
+    {
+        if (!indefinite && (value > INT_MAX / 2 || !json_binary_available(input, value * 2))) THROW_ERROR;
+        if (!json_binary_enter(input)) return NULL;
+        
+        json_object * map = json_map_ext(indefinite ? 0 : (int)value);
+        for (uint64_t i = 0; indefinite ? !json_cbor_break(input) : i < value; i++) {
+            int keyMajor, keyInfo, keyLength;
+            uint64_t keyValue;
+            char * key = NULL;
+            if (json_cbor_readHead(input, &keyMajor, &keyInfo, &keyValue)) {
+                if (keyMajor == JSON_CBOR_TEXT) key = json_cbor_readText(input, keyValue, keyInfo == JSON_CBOR_INDEFINITE, &keyLength);
+                else json_binary_fail(input);
+                if (key != NULL && !json_binary_checkKey(input, key, keyLength)) key = NULL;
+            }
+            if (key == NULL) {
+                json_object_free(map);
+                return NULL;
+            }
+            json_object * item = json_cbor_decodeRecursive(input);
+            if (item == NULL) {
+                free(key);
+                JSON_DEBUG_FREE;
+                json_object_free(map);
+                return NULL;
+            }
+            json_object * replaced = json_map_put_hashed(map, key, keyLength, json_map_hash_len(key, keyLength), item, false);
+            if (replaced != NULL) json_object_free(replaced);
+        }
+        input->depth--;
+        return map;
+    }
+    case JSON_CBOR_TAG:
+    {
+        if (indefinite) THROW_ERROR;
+        if (!json_binary_enter(input)) return NULL;
+        json_object * obj = json_cbor_decodeRecursive(input); // tags are ignored
+        input->depth--;
+        return obj;
+    }
+    case JSON_CBOR_SIMPLE:
+        switch (info) {
+        case 20: return json_bool(false);
+        case 21: return json_bool(true);
+        case 22: case 23: return json_null(); // null, undefined
+        case 25: return json_float(json_cbor_halfToFloat(value));
+        case 26:
+        {
+            uint32_t bits = value;
+            float floatValue;
+            memcpy(&floatValue, &bits, 4);
+            return json_float(floatValue);
+        }
+        case 27:
+        {
+            double doubleValue;
+            memcpy(&doubleValue, &value, 8);
+            return json_float(doubleValue);
+        }
+        default: THROW_ERROR;
+        }
+    default: // byte strings
+        THROW_ERROR;
+    }
+}
+
+/* Decodes a CBOR item. */
+json_object * json_cbor_decode(const void * data, size_t size, json_error * error) {
+    json_binary_input input = { data, size, 0, error, false, 0 };
+    json_object * obj = json_cbor_decodeRecursive(&input);
+    if (obj != NULL && input.pos != size) {
+        json_object_free(obj);
+        json_binary_fail(&input);
+        return NULL;
+    }
+    return obj;
+}
@@ -0,0 +1,100 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_BINARY_H
+#define	JSON_BINARY_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "json_object.h"
+#include "json_error.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef JSON_BINARY_MAX_DEPTH
+#define JSON_BINARY_MAX_DEPTH 1024 // nesting limit of the decoders (they are recursive)
+#endif
+
+#define JSON_BINARY_HASH_SEED 0x6a736f6e68617368ull // seed of the stored key hashes, fixed by the format
+
+/* Growable byte buffer for the encoders. */
+typedef struct JSON_BUFFER {
+    unsigned char * data;
+    size_t size;
+    size_t capacity;
+} json_buffer;
+
+
+/* Initializes an empty buffer. */
+extern void json_buffer_init(json_buffer * buffer);
+
+/* Deletes the buffer contents. */
+extern void json_buffer_free(json_buffer * buffer);
+
+/* Appends the given number of uninitialized bytes, returns pointer to them. */
+extern unsigned char * json_buffer_grow(json_buffer * buffer, size_t length);
+
+
+/*
+ * Encodes the object in the native binary format.
+ * 
+ * The format stores container sizes and precomputed key hashes, so the decoder
+ * allocates every array and hashtable at its final size and never rehashes.
+ * The hashes are computed with JSON_BINARY_HASH_SEED, so they don't depend on
+ * (or reveal) the seed of the process. They're reused only by processes hashing
+ * with that seed, set by json_map_set_seed(JSON_BINARY_HASH_SEED) (which gives up
+ * the random seed's protection against colliding keys), otherwise they're
+ * recomputed. Numbers are stored in little-endian order.
+ */
+extern void json_binary_encode(json_buffer * buffer, const json_object * obj);
+
+/* 
+ * Decodes an object encoded by json_binary_encode. Nesting deeper than JSON_BINARY_MAX_DEPTH
+ * is reported as JSON_ERROR_TOO_DEEP, map keys with a NUL inside as JSON_ERROR_BINARY_DATA.
+ */
+extern json_object * json_binary_decode(const void * data, size_t size, json_error * error);
+
+
+/* Encodes the object as CBOR (RFC 7049). */
+extern void json_cbor_encode(json_buffer * buffer, const json_object * obj);
+
+/*
+ * Decodes a CBOR item. Byte strings, non-string map keys (or keys with a NUL
+ * inside) and integers outside of the int range are rejected, tags are ignored.
+ * Nesting deeper than JSON_BINARY_MAX_DEPTH is reported as JSON_ERROR_TOO_DEEP.
+ */
+extern json_object * json_cbor_decode(const void * data, size_t size, json_error * error);
+
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* JSON_BINARY_H */
@@ -63,6 +63,19 @@ public:
         return json_cpp(json_map_get(obj, key));
     };
     
+    json_cpp operator[](const json_map_key & key) const { 
+        if (obj->type != JSON_OBJECT_MAP) throw json_type_error();
+        json_object * value;
+        json_map_get_many(obj, &key, 1, &value);
+        return json_cpp(value);
+    };
+    
+    // finds many precompiled keys at once (json_map_get_many), the missing values are NULL
+    void get_many(const json_map_key * keys, int n, json_object ** values) const { 
+        if (obj->type != JSON_OBJECT_MAP) throw json_type_error();
+        json_map_get_many(obj, keys, n, values);
+    };
+    
     json_cpp operator[](int index) const { 
         if (obj->type != JSON_OBJECT_ARRAY) throw json_type_error();
         return json_cpp(json_array_get(obj, index));
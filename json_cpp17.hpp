@@ -0,0 +1,310 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_CPP17_HPP
+#define	JSON_CPP17_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "json.h"
+
+/* 
+ * C++17 interface for the json_object type. Unlike json_cpp, nothing here throws:
+ * lookups return empty views, typed accessors return std::optional.
+ * 
+ *     json::document doc = json::document::parse(data);
+ *     for (auto [key, value] : doc["persons"][0].items()) ...
+ *     std::string_view name = doc["persons"][0]["name"].as_string().value_or("");
+ */
+
+namespace json {
+
+class value;
+
+/* Iterator over the (key, value) pairs of a map. */
+class map_iterator {
+private:
+    json_map_iterator it;
+    bool valid;
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef std::pair<std::string_view, value> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef void pointer;
+    typedef value_type reference;
+    
+    map_iterator(): it(), valid(false) {};
+    explicit map_iterator(const json_object * map): valid(true) {
+        json_map_iterator_init(&it, map);
+        ++*this;
+    };
+    
+    inline value_type operator*() const;
+    
+    map_iterator & operator++() {
+        valid = json_map_iterator_next(&it);
+        return *this;
+    };
+    
+    bool operator==(const map_iterator & other) const {
+        return valid == other.valid && (!valid || it.position == other.it.position);
+    };
+    bool operator!=(const map_iterator & other) const { return !(*this == other); };
+};
+
+/* Iterator over the items of an array. */
+class array_iterator {
+private:
+    json_array_iterator it;
+    bool valid;
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef value value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef void pointer;
+    typedef value_type reference;
+    
+    array_iterator(): it(), valid(false) {};
+    explicit array_iterator(const json_object * array): valid(true) {
+        json_array_iterator_init(&it, array);
+        ++*this;
+    };
+    
+    inline value_type operator*() const;
+    
+    array_iterator & operator++() {
+        valid = json_array_iterator_next(&it);
+        return *this;
+    };
+    
+    bool operator==(const array_iterator & other) const {
+        return valid == other.valid && (!valid || it.index == other.it.index);
+    };
+    bool operator!=(const array_iterator & other) const { return !(*this == other); };
+};
+
+/* Range for the range-based for loop. */
+template<typename I> class range {
+private:
+    I first;
+public:
+    explicit range(I first): first(first) {};
+    I begin() const { return first; };
+    I end() const { return I(); };
+};
+
+/* Non-owning view of a JSON object, empty if the value doesn't exist. */
+class value {
+private:
+    const json_object * obj;
+    
+    bool is(json_object_type t) const { return obj != NULL && obj->type == t; };
+public:
+    value(const json_object * obj = NULL): obj(obj) {};
+    
+    /* Checks if the value exists. */
+    bool has_value() const { return obj != NULL; };
+    explicit operator bool() const { return obj != NULL; };
+    
+    /* Returns the underlying object (or NULL). */
+    const json_object * get() const { return obj; };
+    
+    json_object_type type() const { return obj ? obj->type : JSON_OBJECT_NULL; };
+    
+    bool is_null() const { return is(JSON_OBJECT_NULL); };
+    bool is_int() const { return is(JSON_OBJECT_INT); };
+    bool is_bool() const { return is(JSON_OBJECT_BOOL); };
+    bool is_float() const { return is(JSON_OBJECT_FLOAT); };
+    bool is_string() const { return is(JSON_OBJECT_STRING); };
+    bool is_array() const { return is(JSON_OBJECT_ARRAY); };
+    bool is_map() const { return is(JSON_OBJECT_MAP); };
+    
+    std::optional<int> as_int() const {
+        if (!is_int()) return std::nullopt;
+        return json_int_value(obj);
+    };
+    
+    std::optional<bool> as_bool() const {
+        if (!is_bool()) return std::nullopt;
+        return json_bool_value(obj);
+    };
+    
+    /* Returns the number as a float (integers are converted). */
+    std::optional<float> as_float() const {
+        if (is_float()) return json_float_value(obj);
+        if (is_int()) return (float)json_int_value(obj);
+        return std::nullopt;
+    };
+    
+    std::optional<std::string_view> as_string() const {
+        if (!is_string()) return std::nullopt;
+        return std::string_view(json_string_value(obj), json_string_length(obj));
+    };
+    
+    /* Returns the size of an array or a map (0 for other types). */
+    int size() const {
+        if (is_array()) return json_array_size(obj);
+        if (is_map()) return json_map_size(obj);
+        return 0;
+    };
+    
+    /* Finds a value in the map. */
+    value find(const char * key) const {
+        return is_map() ? value(json_map_get(obj, key)) : value();
+    };
+    value find(const std::string & key) const { return find(key.c_str()); };
+    
+    /* Returns an item of the array. */
+    value at(int index) const {
+        return is_array() ? value(json_array_get(obj, index)) : value();
+    };
+    
+    value operator[](const char * key) const { return find(key); };
+    value operator[](const std::string & key) const { return find(key.c_str()); };
+    value operator[](int index) const { return at(index); };
+    
+    /* Iterates over the (key, value) pairs of a map (empty for other types). */
+    range<map_iterator> items() const {
+        return range<map_iterator>(is_map() ? map_iterator(obj) : map_iterator());
+    };
+    
+    /* Iterates over the items of an array (empty for other types). */
+    range<array_iterator> elements() const {
+        return range<array_iterator>(is_array() ? array_iterator(obj) : array_iterator());
+    };
+};
+
+inline map_iterator::value_type map_iterator::operator*() const {
+    return value_type(std::string_view(it.key, it.length), value(it.value));
+}
+
+inline array_iterator::value_type array_iterator::operator*() const {
+    return value(it.item);
+}
+
+/* 
+ * Owning handle of a parsed tree (move-only). The tree is either allocated with
+ * malloc, or it's built by a json_parser the document owns (the parser and its arena
+ * are freed with the document).
+ */
+class document {
+private:
+    json_object * obj;
+    json_parser * parser; // NULL unless the document owns the parser of the tree
+    
+    document(json_object * obj, json_parser * parser): obj(obj), parser(parser) {};
+    
+    void destroy() {
+        if (obj) json_object_free(obj); // nothing to do for a tree in the arena
+        if (parser) {
+            json_parser_free(parser);
+            delete parser;
+        }
+    };
+public:
+    document(): obj(NULL), parser(NULL) {};
+    
+    /* 
+     * Takes the ownership of a tree allocated with malloc. A tree in an arena isn't
+     * freed by the document (json_object_free ignores it), the arena has to outlive it.
+     */
+    explicit document(json_object * obj): obj(obj), parser(NULL) {};
+    
+    document(const document &) = delete;
+    document & operator=(const document &) = delete;
+    
+    document(document && other) noexcept: obj(other.obj), parser(other.parser) {
+        other.obj = NULL;
+        other.parser = NULL;
+    };
+    document & operator=(document && other) noexcept {
+        if (this != &other) {
+            destroy();
+            obj = other.obj;
+            parser = other.parser;
+            other.obj = NULL;
+            other.parser = NULL;
+        }
+        return *this;
+    };
+    
+    ~document() {
+        destroy();
+    };
+    
+    /* Parses a string, the document is empty on error. */
+    static document parse(const char * string, json_error * error = NULL) {
+        return document(json_parse_string(string, error));
+    };
+    
+    /* Parses a file, the document is empty on error. */
+    static document parse_file(const char * filename, json_error * error = NULL) {
+        return document(json_parse_file(filename, error));
+    };
+    
+    /* 
+     * Parses a buffer with a parser of the given options (e.g. building the tree in an
+     * arena), the document owns the parser. The document is empty on error.
+     */
+    static document parse(const char * buffer, size_t length, const json_parser_options & options, json_error * error = NULL) {
+        json_parser * parser = new json_parser;
+        json_parser_init_ext(parser, &options);
+        document doc(json_parser_parse(parser, buffer, length, error), parser);
+        if (!doc.obj) return document(); // the parser is freed with doc
+        return doc;
+    };
+    
+    /* 
+     * Gives up the ownership of the object. A tree in the arena of the document's parser
+     * can't outlive the document, so it's cloned (the clone is allocated with malloc).
+     */
+    json_object * release() {
+        json_object * released = obj;
+        if (parser && parser->options.arenaBlockSize > 0 && obj) released = json_object_clone(obj);
+        obj = NULL;
+        return released;
+    };
+    
+    explicit operator bool() const { return obj != NULL; };
+    
+    value root() const { return value(obj); };
+    
+    value find(const char * key) const { return root().find(key); };
+    value operator[](const char * key) const { return root().find(key); };
+    value operator[](const std::string & key) const { return root().find(key); };
+    value operator[](int index) const { return root().at(index); };
+};
+
+}
+
+
+#endif	/* JSON_CPP17_HPP */
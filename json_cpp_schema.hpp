@@ -0,0 +1,385 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_CPP_SCHEMA_HPP
+#define	JSON_CPP_SCHEMA_HPP
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <array>
+#include <limits>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "json_cpp.hpp"
+#include "json.h"
+
+/* 
+ * Schema-specialized decoding (C++17). The parser is generated from the registered
+ * fields and deserializes straight into the structs, without building json_objects:
+ * 
+ *     struct person { std::string name; int age; std::vector<int> scores; };
+ *     JSON_SCHEMA(person, JSON_FIELD(name), JSON_FIELD(age), JSON_FIELD_KEY(scores, "results"))
+ * 
+ *     person p;
+ *     if (!json_decode_string("{\"name\": \"Martin\", ...}", p, &error)) ...
+ * 
+ * Supported members are integers, floats, bools, std::string, std::vector, std::optional
+ * and other registered structs. Keys are matched with a perfect hash computed at compile
+ * time, unknown keys are skipped without being tokenized. Numbers out of the range of an
+ * integral member are rejected with JSON_ERROR_SCHEMA_MISMATCH.
+ */
+
+/* Schema of a struct, specialized by the JSON_SCHEMA macro. */
+template<typename T> struct json_schema;
+
+/* Field of a struct. */
+template<typename C, typename M> struct json_schema_field {
+    const char * key;
+    size_t length;
+    M C::* member;
+};
+
+static constexpr size_t json_schema_strlen(const char * s) {
+    size_t length = 0;
+    while (s[length]) length++;
+    return length;
+}
+
+template<typename C, typename M> constexpr json_schema_field<C, M> json_field(const char * key, M C::* member) {
+    return json_schema_field<C, M>{ key, json_schema_strlen(key), member };
+}
+
+/* Registers the fields of a struct (must be used in the global namespace). */
+#define JSON_SCHEMA(TYPE, ...) \
+    template<> struct json_schema<TYPE> { \
+        typedef TYPE type; \
+        static constexpr auto fields() { return std::make_tuple(__VA_ARGS__); } \
+    };
+
+/* Field with the same key as the member name. */
+#define JSON_FIELD(NAME) json_field(#NAME, &type::NAME)
+
+/* Field with a custom key. */
+#define JSON_FIELD_KEY(NAME, KEY) json_field(KEY, &type::NAME)
+
+
+/* Seeded FNV-1a hash of the keys. */
+static constexpr uint32_t json_schema_hash(uint32_t seed, const char * key, size_t length) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Perfect hash table of the keys, computed at compile time. */
+template<typename T> struct json_schema_table {
+    static constexpr auto fields = json_schema<T>::fields();
+    static constexpr size_t count = std::tuple_size<decltype(fields)>::value;
+    
+    template<size_t... I> static constexpr std::array<const char *, count> keys(std::index_sequence<I...>) {
+        return {{ std::get<I>(fields).key... }};
+    }
+    template<size_t... I> static constexpr std::array<size_t, count> lengths(std::index_sequence<I...>) {
+        return {{ std::get<I>(fields).length... }};
+    }
+    static constexpr std::array<const char *, count> key = keys(std::make_index_sequence<count>());
+    static constexpr std::array<size_t, count> length = lengths(std::make_index_sequence<count>());
+    
+    static constexpr size_t tableSize() {
+        size_t size = 4;
+        while (size < 4*count) size *= 2;
+        return size;
+    }
+    static constexpr size_t size = tableSize();
+    
+    // finds a seed without collisions
+    static constexpr uint32_t findSeed() {
+        for (uint32_t seed = 0; seed < 65536; seed++) {
+            bool used[size] = {};
+            bool ok = true;
+            for (size_t i = 0; i < count && ok; i++) {
+                size_t slot = json_schema_hash(seed, key[i], length[i]) & (size - 1);
+                ok = !used[slot];
+                used[slot] = true;
+            }
+            if (ok) return seed;
+        }
+        return UINT32_MAX;
+    }
+    static constexpr uint32_t seed = findSeed();
+    static_assert(seed != UINT32_MAX, "JSON_SCHEMA: duplicate keys");
+    
+    static constexpr std::array<int, size> makeSlots() {
+        std::array<int, size> slots = {};
+        for (size_t i = 0; i < size; i++) slots[i] = -1;
+        for (size_t i = 0; i < count; i++) slots[json_schema_hash(seed, key[i], length[i]) & (size - 1)] = (int)i;
+        return slots;
+    }
+    static constexpr std::array<int, size> slots = makeSlots();
+    
+    /* Returns the index of the field, or -1 for unknown keys. */
+    static inline int find(const char * k, size_t l) {
+        int index = slots[json_schema_hash(seed, k, l) & (size - 1)];
+        if (index < 0 || length[index] != l || memcmp(key[index], k, l) != 0) return -1;
+        return index;
+    }
+};
+
+
+class json_schema_decoder;
+
+/* Decoder of a value type, registered structs are decoded by default. */
+template<typename V, typename Enable = void> struct json_schema_value;
+
+/* Decodes the values directly from the tokenizer. */
+class json_schema_decoder {
+public:
+    json_tokenizer tokenizer;
+    json_error * error;
+    
+    json_schema_decoder(json_reader reader, json_error * error): error(error) {
+        json_tokenizer_init(&tokenizer, reader);
+    };
+    
+    ~json_schema_decoder() {
+        json_tokenizer_free(&tokenizer);
+    };
+    
+    json_schema_decoder(const json_schema_decoder &) = delete;
+    json_schema_decoder & operator=(const json_schema_decoder &) = delete;
+    
+    bool fail(int code) {
+        if (error) {
+            error->code = code;
+            error->line = tokenizer.line;
+            error->pos = tokenizer.pos;
+        }
+        return false;
+    };
+    
+    /* Fails because of the current token. */
+    bool unexpected() {
+        json_tokenType type = tokenizer.token.type;
+        json_token_free(&tokenizer.token);
+        if (type == JSON_TOKEN_EOF) return fail(JSON_ERROR_UNEXPECTED_EOF);
+        return fail(JSON_ERROR_SCHEMA_MISMATCH);
+    };
+    
+    bool next() {
+        if (!json_tokenizer_next(&tokenizer)) return fail(tokenizer.error);
+        return true;
+    };
+    
+    /* Decodes the value starting with the current token. */
+    template<typename V> bool value(V & out) {
+        return json_schema_value<V>::decode(*this, out);
+    };
+};
+
+/* 
+ * Integers are converted from the token's text (the token's value is limited to int),
+ * so 64-bit members get their full range. Floats with an integral value are accepted
+ * too (exact up to 2^53), values out of the member's range are rejected.
+ */
+template<typename V> struct json_schema_value<V, typename std::enable_if<std::is_integral<V>::value && !std::is_same<V, bool>::value>::type> {
+    static bool decode(json_schema_decoder & d, V & out) {
+        const char * text = d.tokenizer.scratch;
+        errno = 0;
+        if (d.tokenizer.token.type == JSON_TOKEN_FLOAT) {
+            double value = strtod(text, NULL);
+            bool inRange = std::is_signed<V>::value
+                ? value >= -ldexp(1.0, std::numeric_limits<V>::digits) && value < ldexp(1.0, std::numeric_limits<V>::digits)
+                : value >= 0 && value < ldexp(1.0, std::numeric_limits<V>::digits);
+            if (!inRange || value != floor(value)) return d.fail(JSON_ERROR_SCHEMA_MISMATCH);
+            out = (V)value;
+            return true;
+        }
+        if (d.tokenizer.token.type != JSON_TOKEN_INTEGER) return d.unexpected();
+        
+        if (std::is_signed<V>::value || text[0] == '-') {
+            long long value = strtoll(text, NULL, 10);
+            if (errno == ERANGE || value < (long long)std::numeric_limits<V>::min() || (value > 0 && (unsigned long long)value > (unsigned long long)std::numeric_limits<V>::max())) {
+                return d.fail(JSON_ERROR_SCHEMA_MISMATCH);
+            }
+            out = (V)value;
+        }
+        else {
+            unsigned long long value = strtoull(text, NULL, 10);
+            if (errno == ERANGE || value > (unsigned long long)std::numeric_limits<V>::max()) return d.fail(JSON_ERROR_SCHEMA_MISMATCH);
+            out = (V)value;
+        }
+        return true;
+    };
+};
+
+template<typename V> struct json_schema_value<V, typename std::enable_if<std::is_floating_point<V>::value>::type> {
+    static bool decode(json_schema_decoder & d, V & out) {
+        if (d.tokenizer.token.type == JSON_TOKEN_FLOAT) out = (V)d.tokenizer.token.data.floatValue;
+        else if (d.tokenizer.token.type == JSON_TOKEN_INTEGER) out = (V)d.tokenizer.token.data.intValue;
+        else return d.unexpected();
+        return true;
+    };
+};
+
+template<> struct json_schema_value<bool> {
+    static bool decode(json_schema_decoder & d, bool & out) {
+        if (d.tokenizer.token.type != JSON_TOKEN_BOOL) return d.unexpected();
+        out = d.tokenizer.token.data.boolValue;
+        return true;
+    };
+};
+
+template<> struct json_schema_value<std::string> {
+    static bool decode(json_schema_decoder & d, std::string & out) {
+        if (d.tokenizer.token.type != JSON_TOKEN_STRING) return d.unexpected();
+        out.assign(d.tokenizer.token.data.string.data, d.tokenizer.token.data.string.length);
+        json_token_free(&d.tokenizer.token);
+        return true;
+    };
+};
+
+template<typename E> struct json_schema_value<std::optional<E> > {
+    static bool decode(json_schema_decoder & d, std::optional<E> & out) {
+        if (d.tokenizer.token.type == JSON_TOKEN_NULL) {
+            out.reset();
+            return true;
+        }
+        return d.value(out.emplace());
+    };
+};
+
+template<typename E> struct json_schema_value<std::vector<E> > {
+    static bool decode(json_schema_decoder & d, std::vector<E> & out) {
+        if (d.tokenizer.token.type != JSON_TOKEN_BRACKET_OPENING) return d.unexpected();
+        out.clear();
+        
+        while (true) {
+            // read the item
+            if (!d.next()) return false;
+            if (out.empty() && d.tokenizer.token.type == JSON_TOKEN_BRACKET_CLOSING) return true; // empty array
+            out.emplace_back();
+            if (!d.value(out.back())) return false;
+            
+            // read "," or "]"
+            if (!d.next()) return false;
+            if (d.tokenizer.token.type == JSON_TOKEN_BRACKET_CLOSING) return true;
+            if (d.tokenizer.token.type == JSON_TOKEN_EOF) return d.fail(JSON_ERROR_UNEXPECTED_EOF);
+            if (d.tokenizer.token.type != JSON_TOKEN_COMMA) {
+                json_token_free(&d.tokenizer.token);
+                return d.fail(JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET);
+            }
+        }
+    };
+};
+
+/* Registered struct. */
+template<typename V, typename Enable> struct json_schema_value {
+    typedef json_schema_table<V> table;
+    
+    template<size_t... I> static bool field(json_schema_decoder & d, V & out, int index, std::index_sequence<I...>) {
+        bool ok = false;
+        (void)((index == (int)I ? (ok = d.value(out.*(std::get<I>(table::fields).member)), true) : false) || ...);
+        return ok;
+    };
+    
+    static bool decode(json_schema_decoder & d, V & out) {
+        if (d.tokenizer.token.type != JSON_TOKEN_BRACE_OPENING) return d.unexpected();
+        
+        for (bool first = true; ; first = false) {
+            // read the key
+            if (!d.next()) return false;
+            if (first && d.tokenizer.token.type == JSON_TOKEN_BRACE_CLOSING) return true; // empty map
+            if (d.tokenizer.token.type == JSON_TOKEN_EOF) return d.fail(JSON_ERROR_UNEXPECTED_EOF);
+            if (d.tokenizer.token.type != JSON_TOKEN_STRING) {
+                json_token_free(&d.tokenizer.token);
+                return d.fail(JSON_ERROR_EXPECTED_STRING);
+            }
+            int index = table::find(d.tokenizer.token.data.string.data, d.tokenizer.token.data.string.length);
+            json_token_free(&d.tokenizer.token);
+            
+            // read ":"
+            if (!d.next()) return false;
+            if (d.tokenizer.token.type != JSON_TOKEN_COLON) {
+                json_tokenType type = d.tokenizer.token.type;
+                json_token_free(&d.tokenizer.token);
+                return d.fail(type == JSON_TOKEN_EOF ? JSON_ERROR_UNEXPECTED_EOF : JSON_ERROR_EXPECTED_COLON);
+            }
+            
+            // read the value, unknown keys are skipped
+            if (index < 0) {
+                if (!json_tokenizer_skip(&d.tokenizer)) return d.fail(d.tokenizer.error);
+                if (d.tokenizer.token.type != JSON_TOKEN_UNKNOWN) return d.fail(JSON_ERROR_UNRESOLVED_TOKEN);
+            }
+            else {
+                if (!d.next()) return false;
+                if (!field(d, out, index, std::make_index_sequence<table::count>())) return false;
+            }
+            
+            // read "," or "}"
+            if (!d.next()) return false;
+            if (d.tokenizer.token.type == JSON_TOKEN_BRACE_CLOSING) return true;
+            if (d.tokenizer.token.type == JSON_TOKEN_EOF) return d.fail(JSON_ERROR_UNEXPECTED_EOF);
+            if (d.tokenizer.token.type != JSON_TOKEN_COMMA) {
+                json_token_free(&d.tokenizer.token);
+                return d.fail(JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACE);
+            }
+        }
+    };
+};
+
+
+/* Decodes JSON into a registered struct (or any other supported type). */
+template<typename T> bool json_decode(json_reader reader, T & out, json_error * error = NULL) {
+    json_schema_decoder decoder(reader, error);
+    if (!decoder.next() || !decoder.value(out)) return false;
+    
+    // EOF wanted
+    if (!decoder.next()) return false;
+    if (decoder.tokenizer.token.type != JSON_TOKEN_EOF) {
+        json_token_free(&decoder.tokenizer.token);
+        return decoder.fail(JSON_ERROR_GARBAGE);
+    }
+    return true;
+}
+
+/* Decodes a JSON string into a registered struct. */
+template<typename T> bool json_decode_string(const char * string, T & out, json_error * error = NULL) {
+    return json_decode(json_reader_string(string), out, error);
+}
+
+
+#endif	/* JSON_CPP_SCHEMA_HPP */
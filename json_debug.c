@@ -80,7 +80,7 @@ void json_tokenizer_dumpTokens(json_tokenizer * tokenizer, FILE * stream) {
                 fprintf(stream, "float(%f) ", tokenizer->token.data.floatValue);
                 break;
             case JSON_TOKEN_SYMBOL:
-                fprintf(stream, "sym(%s) ", tokenizer->token.data.string.data);
+                fprintf(stream, "sym ");
                 break;
             case JSON_TOKEN_BOOL:
                 fprintf(stream, "bool(%i) ", tokenizer->token.data.boolValue);
@@ -48,10 +48,15 @@ extern "C" {
 #ifdef JSON_DEBUG
 extern int json_debug_memblocks;
 extern int json_debug_objects;
-#define JSON_DEBUG_MALLOC json_debug_memblocks++; JSON_MALLOC_DUMP;
-#define JSON_DEBUG_FREE json_debug_memblocks--; JSON_FREE_DUMP;
-#define JSON_DEBUG_OBJECT_NEW json_debug_objects++
-#define JSON_DEBUG_OBJECT_FREE json_debug_objects--
+#ifdef __GNUC__
+#define JSON_DEBUG_COUNT(counter, value) __atomic_fetch_add(&counter, value, __ATOMIC_RELAXED) // parallel parsing
+#else
+#define JSON_DEBUG_COUNT(counter, value) (counter += value)
+#endif
+#define JSON_DEBUG_MALLOC JSON_DEBUG_COUNT(json_debug_memblocks, 1); JSON_MALLOC_DUMP;
+#define JSON_DEBUG_FREE JSON_DEBUG_COUNT(json_debug_memblocks, -1); JSON_FREE_DUMP;
+#define JSON_DEBUG_OBJECT_NEW JSON_DEBUG_COUNT(json_debug_objects, 1)
+#define JSON_DEBUG_OBJECT_FREE JSON_DEBUG_COUNT(json_debug_objects, -1)
 #else
 #define JSON_DEBUG_MALLOC
 #define JSON_DEBUG_FREE
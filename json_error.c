@@ -40,5 +40,11 @@ const char * json_error_message[] = {
     [JSON_ERROR_EXPECTED_STRING] = "String expected",
     [JSON_ERROR_EXPECTED_COLON] = "Colon ':' expected",
     [JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACE] = "Comma ',' or closing brace '}' expected",
-    [JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET] = "Comma ',' or closing bracket ']' expected"
+    [JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET] = "Comma ',' or closing bracket ']' expected",
+    [JSON_ERROR_PATH_SYNTAX] = "Invalid path expression",
+    [JSON_ERROR_SCHEMA_MISMATCH] = "Value doesn't match the schema",
+    [JSON_ERROR_BINARY_DATA] = "Invalid or unsupported binary data",
+    [JSON_ERROR_IO] = "Cannot read or write the file",
+    [JSON_ERROR_TOO_DEEP] = "Nesting too deep",
+    [JSON_ERROR_DUPLICATE_KEY] = "Duplicate key in a map"
 };
@@ -56,7 +56,13 @@ enum {
     JSON_ERROR_EXPECTED_STRING,
     JSON_ERROR_EXPECTED_COLON,
     JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACE,
-    JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET
+    JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET,
+    JSON_ERROR_PATH_SYNTAX,
+    JSON_ERROR_SCHEMA_MISMATCH,
+    JSON_ERROR_BINARY_DATA,
+    JSON_ERROR_IO,
+    JSON_ERROR_TOO_DEEP,
+    JSON_ERROR_DUPLICATE_KEY
 };
 
 
@@ -0,0 +1,209 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_format.h"
+#include "json_tokenizer.h"
+
+/* State of a formatter. */
+typedef struct JSON_FORMATTER {
+    json_tokenizer tokenizer;
+    json_buffer * output;
+    json_write_callback write; // streaming output (or NULL)
+    void * writeData;
+    int indent;
+    json_buffer stack; // a byte per open container, 1 for maps
+} json_formatter;
+
+static inline void json_format_put(json_formatter * formatter, const char * data, size_t length) {
+    memcpy(json_buffer_grow(formatter->output, length), data, length);
+}
+
+static inline void json_format_putChar(json_formatter * formatter, char c) {
+    *json_buffer_grow(formatter->output, 1) = c;
+}
+
+/* Starts a new line of an indented output. */
+static inline void json_format_newLine(json_formatter * formatter) {
+    if (formatter->indent == 0) return;
+    size_t spaces = formatter->stack.size * formatter->indent;
+    unsigned char * line = json_buffer_grow(formatter->output, 1 + spaces);
+    line[0] = '\n';
+    memset(line + 1, ' ', spaces);
+}
+
+/* Copies the current string or number token. */
+static inline void json_format_putText(json_formatter * formatter) {
+    json_token * token = &formatter->tokenizer.token;
+    if (token->type == JSON_TOKEN_STRING) {
+        unsigned char * text = json_buffer_grow(formatter->output, token->data.string.length + 2);
+        text[0] = '"';
+        memcpy(text + 1, token->data.string.data, token->data.string.length);
+        text[token->data.string.length + 1] = '"';
+    }
+    else json_format_put(formatter, token->data.string.data, token->data.string.length);
+}
+
+/* Writes a full block of the streaming output. */
+static inline bool json_format_flush(json_formatter * formatter, bool all) {
+    if (formatter->write == NULL || (!all && formatter->output->size < JSON_FORMAT_BLOCK_SIZE)) return true;
+    bool ok = formatter->write(formatter->writeData, (const char*)formatter->output->data, formatter->output->size);
+    formatter->output->size = 0;
+    return ok;
+}
+
+#define THROW_ERROR(errcode) { if (error) { error->code = errcode; error->line = tokenizer->line; error->pos = tokenizer->pos; } return false; }
+#define NEXT_TOKEN { if (!json_tokenizer_next(tokenizer)) THROW_ERROR(tokenizer->error); }
+
+/* Copies the key and ":" of a map item, starting with the current token. */
+#define READ_KEY { \
+    if (tokenizer->token.type == JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF); \
+    if (tokenizer->token.type != JSON_TOKEN_STRING) THROW_ERROR(JSON_ERROR_EXPECTED_STRING); \
+    json_format_putText(formatter); \
+    NEXT_TOKEN; \
+    if (tokenizer->token.type == JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF); \
+    if (tokenizer->token.type != JSON_TOKEN_COLON) THROW_ERROR(JSON_ERROR_EXPECTED_COLON); \
+    if (formatter->indent > 0) json_format_put(formatter, ": ", 2); \
+    else json_format_putChar(formatter, ':'); \
+    NEXT_TOKEN; \
+}
+
+/* Formats the document (the same grammar as json_parser_value). */
+static bool json_format_document(json_formatter * formatter, json_error * error) {
+    json_tokenizer * tokenizer = &formatter->tokenizer;
+    json_buffer * stack = &formatter->stack;
+    
+    NEXT_TOKEN;
+    for (;;) {
+        // the current token starts a value
+        bool complete = true;
+        switch (tokenizer->token.type) {
+        case JSON_TOKEN_NULL:
+            json_format_put(formatter, "null", 4);
+            break;
+        case JSON_TOKEN_BOOL:
+            if (tokenizer->token.data.boolValue) json_format_put(formatter, "true", 4);
+            else json_format_put(formatter, "false", 5);
+            break;
+        case JSON_TOKEN_INTEGER:
+        case JSON_TOKEN_FLOAT:
+        case JSON_TOKEN_STRING:
+            json_format_putText(formatter);
+            break;
+        case JSON_TOKEN_BRACE_OPENING:
+        case JSON_TOKEN_BRACKET_OPENING:
+        {
+            bool map = tokenizer->token.type == JSON_TOKEN_BRACE_OPENING;
+            NEXT_TOKEN;
+            if (tokenizer->token.type == (map ? JSON_TOKEN_BRACE_CLOSING : JSON_TOKEN_BRACKET_CLOSING)) { // empty container
+                json_format_put(formatter, map ? "{}" : "[]", 2);
+                break;
+            }
+            json_format_putChar(formatter, map ? '{' : '[');
+            *json_buffer_grow(stack, 1) = map;
+            json_format_newLine(formatter);
+            if (map) READ_KEY;
+            complete = false; // the current token starts the first item
+            break;
+        }
+        case JSON_TOKEN_EOF:
+            THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+        default:
+            THROW_ERROR(JSON_ERROR_UNRESOLVED_TOKEN); // unknown token
+        }
+        if (!json_format_flush(formatter, false)) THROW_ERROR(JSON_ERROR_IO);
+        
+        // close the finished containers
+        while (complete) {
+            if (stack->size == 0) { // EOF wanted
+                if (!json_tokenizer_next(tokenizer) || tokenizer->token.type != JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_GARBAGE);
+                if (!json_format_flush(formatter, true)) THROW_ERROR(JSON_ERROR_IO);
+                return true;
+            }
+            
+            bool map = stack->data[stack->size - 1];
+            NEXT_TOKEN;
+            if (tokenizer->token.type == JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+            if (tokenizer->token.type == JSON_TOKEN_COMMA) {
+                json_format_putChar(formatter, ',');
+                json_format_newLine(formatter);
+                NEXT_TOKEN;
+                if (map) READ_KEY;
+                complete = false;
+            }
+            else if (tokenizer->token.type == (map ? JSON_TOKEN_BRACE_CLOSING : JSON_TOKEN_BRACKET_CLOSING)) {
+                stack->size--;
+                json_format_newLine(formatter);
+                json_format_putChar(formatter, map ? '}' : ']');
+            }
+            else THROW_ERROR(map ? JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACE : JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET);
+        }
+    }
+}
+
+#undef READ_KEY
+#undef NEXT_TOKEN
+#undef THROW_ERROR
+
+/* Formats a document from the reader into the output (and the callback, if any). */
+static bool json_format(json_reader reader, json_buffer * output, json_write_callback write, void * data, int indent, json_error * error) {
+    json_formatter formatter;
+    json_tokenizer_init(&formatter.tokenizer, reader);
+    formatter.tokenizer.raw = true;
+    formatter.output = output;
+    formatter.write = write;
+    formatter.writeData = data;
+    formatter.indent = indent > 0 ? indent : 0;
+    json_buffer_init(&formatter.stack);
+    
+    bool ok = json_format_document(&formatter, error);
+    json_buffer_free(&formatter.stack);
+    json_tokenizer_free(&formatter.tokenizer);
+    return ok;
+}
+
+/* Minifies a document. */
+bool json_minify(json_buffer * output, const char * buffer, size_t length, json_error * error) {
+    return json_prettify(output, buffer, length, 0, error);
+}
+
+/* Indents a document. */
+bool json_prettify(json_buffer * output, const char * buffer, size_t length, int indent, json_error * error) {
+    json_reader_window window;
+    return json_format(json_reader_memory(&window, buffer, length), output, NULL, NULL, indent, error);
+}
+
+/* Formats a document from the reader, writing the output in blocks. */
+bool json_format_stream(json_reader reader, json_write_callback write, void * data, int indent, json_error * error) {
+    json_buffer output;
+    json_buffer_init(&output);
+    bool ok = json_format(reader, &output, write, data, indent, error);
+    json_buffer_free(&output);
+    return ok;
+}
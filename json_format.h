@@ -0,0 +1,74 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_FORMAT_H
+#define	JSON_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "json_reader.h"
+#include "json_binary.h"
+#include "json_error.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define JSON_FORMAT_BLOCK_SIZE 65536 // the streaming output is written in blocks of this size
+
+/* Callback writing the output, returns false on an error. */
+typedef bool (* json_write_callback)(void * data, const char * buffer, size_t size);
+
+/* 
+ * Formatters, which change only the whitespace of a document without building
+ * the tree. They're driven by the tokenizer in the raw mode, so the strings
+ * (with their escape sequences) and the numbers are copied as they are. The
+ * input is validated like by the parser, with the same errors.
+ * 
+ * With an indentation, every item is on its own line (like "{\n    \"a\": 1\n}"),
+ * empty containers are written as {} and []. Without it (0), the output is
+ * minified.
+ */
+
+/* Appends the minified document to the output buffer, returns false on an error. */
+extern bool json_minify(json_buffer * output, const char * buffer, size_t length, json_error * error);
+
+/* Appends the document indented by the given number of spaces to the output buffer. */
+extern bool json_prettify(json_buffer * output, const char * buffer, size_t length, int indent, json_error * error);
+
+/* 
+ * Formats a document from the reader, the output is written by the callback
+ * in blocks. Failed writes are reported as JSON_ERROR_IO.
+ */
+extern bool json_format_stream(json_reader reader, json_write_callback write, void * data, int indent, json_error * error);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* JSON_FORMAT_H */
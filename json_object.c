@@ -25,28 +25,44 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "json_object.h"
 #include "json_debug.h"
+#include "json_stats.h"
+#include "json_atomic.h"
 
 /* Creates a new JSON object with specified type. */
 json_object * json_object_new(json_object_type type) {
     JSON_DEBUG_OBJECT_NEW;
     JSON_DEBUG_MALLOC;
+    JSON_STATS_ALLOC(node, sizeof(json_object));
     json_object * obj = malloc(sizeof(json_object));
     obj->type = type;
     obj->_private.refs = 1;
     return obj;
 }
 
+/* Creates a new JSON object in the arena. */
+json_object * json_object_new_arena(json_arena * arena, json_object_type type) {
+    json_object * obj = json_arena_alloc(arena, sizeof(json_object));
+    obj->type = type;
+    obj->_private.refs = 0; // owned by the arena
+    return obj;
+}
+
 /* Deletes the JSON object and it's contents recursively. */
 void json_object_free(json_object * obj) {
-    if (obj->_private.refs > 1) {
-        obj->_private.refs--;
-    }
-    else {
+    if (JSON_ATOMIC_LOAD(&obj->_private.refs) == 0) return; // released with the arena
+    if (JSON_ATOMIC_DECREMENT(&obj->_private.refs) == 0) {
         if (obj->type == JSON_OBJECT_STRING) {
             json_string_free(obj);
         }
@@ -66,19 +82,34 @@ void json_object_free(json_object * obj) {
 
 /* References the object. */
 extern json_object * json_object_reference(json_object * obj) {
-    obj->_private.refs++;
+    if (JSON_ATOMIC_LOAD(&obj->_private.refs) > 0) JSON_ATOMIC_ADD(&obj->_private.refs, 1); // the caller holds a reference already
     return obj;
 }
 
 
 /* Initializes a string. */
 void json_string_init_ext(json_object * string, char * str, bool copy) {
+    json_string_init_len(string, str, strlen(str), copy);
+}
+
+/* Initializes a string with a known length. */
+void json_string_init_len(json_object * string, char * str, int length, bool copy) {
     if (copy) {
         JSON_DEBUG_MALLOC;
-        char * newMemory = malloc(sizeof(char)*(strlen(str)+1));
-        str = strcpy(newMemory, str);
+        JSON_STATS_ALLOC(string, length+1);
+        char * newMemory = malloc(sizeof(char)*(length+1));
+        str = memcpy(newMemory, str, length+1);
     }
     string->json_string.string = str;
+    string->json_string.length = length;
+}
+
+/* Initializes a string with a copy stored in the arena. */
+void json_string_init_arena(json_object * string, json_arena * arena, const char * str, int length) {
+    char * newMemory = json_arena_alloc(arena, sizeof(char)*(length+1));
+    string->json_string.string = memcpy(newMemory, str, length);
+    string->json_string.string[length] = '\0';
+    string->json_string.length = length;
 }
 
 /* Frees a string. */
@@ -94,21 +125,137 @@ void json_string_free(json_object * string) {
 
 /* Initializes an empty array object. */
 void json_array_init(json_object * array) {
+    json_array_init_ext(array, JSON_ARRAY_CAPACITY);
+}
+
+/* Initializes an empty array object with the given capacity. */
+void json_array_init_ext(json_object * array, int capacity) {
+    if (capacity < 1) capacity = 1;
+    JSON_DEBUG_MALLOC;
+    JSON_STATS_ALLOC(array, sizeof(json_object*)*capacity);
+    array->json_array.items = malloc(sizeof(json_object*)*capacity);
+    array->json_array.size = 0;
+    array->json_array.capacity = capacity;
+    array->json_array.packed = JSON_OBJECT_NULL;
+    array->json_array.numbers.ints = NULL;
+}
+
+/* Initializes an empty array object with the item buffer in the arena. */
+void json_array_init_arena(json_object * array, json_arena * arena, int capacity) {
+    if (capacity < 1) capacity = 1;
+    array->json_array.items = json_arena_alloc(arena, sizeof(json_object*)*capacity);
+    array->json_array.size = 0;
+    array->json_array.capacity = capacity;
+    array->json_array.packed = JSON_OBJECT_NULL;
+    array->json_array.numbers.ints = NULL;
+}
+
+/* Initializes an empty packed array of integers or floats with the given capacity. */
+void json_array_init_packed(json_object * array, json_object_type type, int capacity) {
+    if (capacity < 1) capacity = 1;
     JSON_DEBUG_MALLOC;
-    array->json_array.items = malloc(sizeof(json_object*)*JSON_ARRAY_CAPACITY);
+    JSON_STATS_ALLOC(array, sizeof(int)*capacity);
+    array->json_array.numbers.ints = malloc(sizeof(int)*capacity);
+    array->json_array.items = NULL;
     array->json_array.size = 0;
-    array->json_array.capacity = JSON_ARRAY_CAPACITY;
+    array->json_array.capacity = capacity;
+    array->json_array.packed = type;
+}
+
+/* Boxes a number of a packed array. */
+static json_object * json_array_box(const json_object * array, int index) {
+    if (array->json_array.packed == JSON_OBJECT_INT) return json_int(array->json_array.numbers.ints[index]);
+    else return json_float(array->json_array.numbers.floats[index]);
+}
+
+/* Converts a packed array to a regular one, the cached boxes are kept. */
+static void json_array_unpack(json_object * array) {
+    json_object ** boxes = array->json_array.items;
+    JSON_DEBUG_MALLOC;
+    JSON_STATS_ALLOC(array, sizeof(json_object*)*array->json_array.capacity);
+    array->json_array.items = malloc(sizeof(json_object*)*array->json_array.capacity);
+    for (int i = 0; i < array->json_array.size; i++) {
+        array->json_array.items[i] = (boxes && boxes[i]) ? boxes[i] : json_array_box(array, i);
+    }
+    if (boxes != NULL) {
+        free(boxes);
+        JSON_DEBUG_FREE;
+    }
+    
+    free(array->json_array.numbers.ints);
+    JSON_DEBUG_FREE;
+    array->json_array.numbers.ints = NULL;
+    array->json_array.packed = JSON_OBJECT_NULL;
+}
+
+/* Makes sure the array can hold the given number of items without reallocation. */
+void json_array_reserve(json_object * array, int capacity) {
+    if (capacity > array->json_array.capacity) {
+        if (array->json_array.packed && array->json_array.items != NULL) json_array_unpack(array); // boxed already
+        if (array->json_array.packed) {
+            JSON_STATS_ALLOC(array, sizeof(int)*capacity);
+            array->json_array.numbers.ints = realloc(array->json_array.numbers.ints, sizeof(int)*capacity);
+        }
+        else {
+            JSON_STATS_ALLOC(array, sizeof(json_object*)*capacity);
+            array->json_array.items = realloc(array->json_array.items, sizeof(json_object*)*capacity);
+        }
+        array->json_array.capacity = capacity;
+    }
 }
 
 /* Adds a new item to the array. */
 void json_array_add(json_object * array, json_object * newItem) {
+    if (array->json_array.packed) json_array_unpack(array);
     if (array->json_array.size == array->json_array.capacity) {
         array->json_array.capacity *= 2; // double the capacity
+        JSON_STATS_ALLOC(array, sizeof(json_object*)*array->json_array.capacity);
         array->json_array.items = realloc(array->json_array.items, sizeof(json_object*)*array->json_array.capacity);
     }
     array->json_array.items[array->json_array.size++] = newItem;
 }
 
+/* Prepares a packed array of the given type for a new number, returns false if it can't be packed. */
+static inline bool json_array_packedAdd(json_object * array, json_object_type type) {
+    if (array->json_array.packed != type || array->json_array.items != NULL) return false; // not packed or boxed already
+    if (array->json_array.size == array->json_array.capacity) {
+        array->json_array.capacity *= 2; // double the capacity
+        JSON_STATS_ALLOC(array, sizeof(int)*array->json_array.capacity);
+        array->json_array.numbers.ints = realloc(array->json_array.numbers.ints, sizeof(int)*array->json_array.capacity);
+    }
+    return true;
+}
+
+/* Adds an integer to the array. */
+void json_array_add_int(json_object * array, int value) {
+    if (json_array_packedAdd(array, JSON_OBJECT_INT)) {
+        array->json_array.numbers.ints[array->json_array.size++] = value;
+    }
+    else json_array_add(array, json_int(value));
+}
+
+/* Adds a float to the array. */
+void json_array_add_float(json_object * array, float value) {
+    if (json_array_packedAdd(array, JSON_OBJECT_FLOAT)) {
+        array->json_array.numbers.floats[array->json_array.size++] = value;
+    }
+    else json_array_add(array, json_float(value));
+}
+
+/* Adds the items to the array. */
+void json_array_add_n(json_object * array, json_object * const * items, int count) {
+    if (count == 0) return;
+    if (array->json_array.packed) json_array_unpack(array);
+    int size = array->json_array.size;
+    if (size + count > array->json_array.capacity) {
+        int capacity = array->json_array.capacity;
+        while (capacity < size + count) capacity *= 2;
+        json_array_reserve(array, capacity);
+    }
+    memcpy(array->json_array.items + size, items, sizeof(json_object*)*count);
+    array->json_array.size += count;
+}
+
 /* Returns the size of the array. */
 int json_array_size(const json_object * array) {
     return array->json_array.size;
@@ -117,131 +264,399 @@ int json_array_size(const json_object * array) {
 /* Returns an object from the array. */
 json_object * json_array_get(const json_object * array, int index) {
     if (index < 0 || index >= array->json_array.size) return NULL;
-    else return array->json_array.items[index];
+    if (!array->json_array.packed) return array->json_array.items[index];
+    
+    // the number is boxed on demand, the numbers stay untouched and the boxes are
+    // published atomically, so concurrent readers see the same box
+    json_object * mutableArray = (json_object*)array;
+    json_object ** boxes = JSON_ATOMIC_ACQUIRE(&mutableArray->json_array.items);
+    if (boxes == NULL) {
+        JSON_DEBUG_MALLOC;
+        JSON_STATS_ALLOC(array, sizeof(json_object*)*array->json_array.size);
+        json_object ** newBoxes = calloc(array->json_array.size, sizeof(json_object*));
+        if (JSON_ATOMIC_PUBLISH(&mutableArray->json_array.items, &boxes, newBoxes)) boxes = newBoxes;
+        else {
+            free(newBoxes); // another reader was faster
+            JSON_DEBUG_FREE;
+        }
+    }
+    json_object * box = JSON_ATOMIC_ACQUIRE(&boxes[index]);
+    if (box == NULL) {
+        json_object * newBox = json_array_box(array, index);
+        if (JSON_ATOMIC_PUBLISH(&boxes[index], &box, newBox)) box = newBox;
+        else json_object_free(newBox);
+    }
+    return box;
+}
+
+/* Returns an object from the array without boxing. */
+const json_object * json_array_peek(const json_object * array, int index, json_object * scratch) {
+    if (!array->json_array.packed || index < 0 || index >= array->json_array.size) return json_array_get(array, index);
+    scratch->_private.type = array->json_array.packed;
+    scratch->_private.refs = 1;
+    if (array->json_array.packed == JSON_OBJECT_INT) scratch->json_int.value = array->json_array.numbers.ints[index];
+    else scratch->json_float.value = array->json_array.numbers.floats[index];
+    return scratch;
+}
+
+/* Returns the numbers of a packed array. */
+json_numbers json_array_numbers(const json_object * array) {
+    json_numbers numbers;
+    numbers.type = array->json_array.packed;
+    numbers.size = array->json_array.packed ? array->json_array.size : 0;
+    numbers.data.ints = array->json_array.numbers.ints;
+    return numbers;
 }
 
 /* Deletes the array contents. */
 void json_array_free_contents(json_object * array) {
+    if (array->json_array.items == NULL) return; // packed array without boxes
     for (int i = 0; i < array->json_array.size; i++) {
-        json_object_free(array->json_array.items[i]);
+        if (array->json_array.items[i] != NULL) json_object_free(array->json_array.items[i]); // boxed lazily
     }
 }
 
 /* Deletes the array (without deleting it's contents). */
 void json_array_free(json_object * array) {
-    free(array->json_array.items);
-    JSON_DEBUG_FREE;
+    if (array->json_array.items != NULL) {
+        free(array->json_array.items);
+        JSON_DEBUG_FREE;
+    }
+    if (array->json_array.packed) {
+        free(array->json_array.numbers.ints);
+        JSON_DEBUG_FREE;
+    }
 }
 
 
 
-#define JSON_HASHTABLE_SIZE 7
+#define JSON_HASHTABLE_SIZE 8
+#define JSON_MAP_CAPACITY 4 // items of a growing map
+#define JSON_MAP_GET_BATCH 8 // keys probed together by json_map_get_many
+
+#ifdef __GNUC__
+#define JSON_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define JSON_PREFETCH(address)
+#endif
+
+
+/* 
+ * Key hashing (wyhash), processes 8 bytes at a time. Unless set explicitly, the seed
+ * is read from /dev/urandom once, by the first hashed key.
+ */
+
+static const uint64_t json_hashSecret[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+
+static uint64_t json_hashSeed = 0;
+static int json_hashSeeded = 0;
+static pthread_once_t json_hashSeedOnce = PTHREAD_ONCE_INIT;
+
+/* Seeds the hashing randomly, unless json_map_set_seed was called already. */
+static void json_hash_randomSeed(void) {
+    if (JSON_ATOMIC_ACQUIRE(&json_hashSeeded)) return;
+    
+    uint64_t seed = 0;
+    FILE * random = fopen("/dev/urandom", "rb");
+    bool ok = random != NULL && fread(&seed, sizeof(seed), 1, random) == 1;
+    if (random != NULL) fclose(random);
+    if (!ok) {
+        // weak, but differs between processes and runs
+        seed = ((uint64_t)time(NULL) << 32) ^ ((uint64_t)getpid() << 16) ^ (uint64_t)clock() ^ (uint64_t)(uintptr_t)&seed;
+    }
+    
+    JSON_ATOMIC_RELEASE(&json_hashSeed, seed);
+    JSON_ATOMIC_RELEASE(&json_hashSeeded, 1);
+}
 
+/* Returns the seed of the hashing, initializes it first if needed. */
+static inline uint64_t json_hash_seed(void) {
+    if (!JSON_ATOMIC_ACQUIRE(&json_hashSeeded)) pthread_once(&json_hashSeedOnce, json_hash_randomSeed);
+    return JSON_ATOMIC_ACQUIRE(&json_hashSeed);
+}
+
+/* 64x64 -> 128 bit multiplication, returns the halves. */
+static inline void json_hash_mum(uint64_t * a, uint64_t * b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha*hb, rm0 = ha*lb, rm1 = hb*la, rl = la*lb, t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
 
-static unsigned json_hashString(const char * string) {
-    unsigned hash = 5381;
-    int c;
-    while ((c = *string++)) hash = ((hash << 5) + hash) + c;
-    return hash;
+static inline uint64_t json_hash_mix(uint64_t a, uint64_t b) {
+    json_hash_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t json_hash_read8(const unsigned char * p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static inline uint64_t json_hash_read4(const unsigned char * p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+static unsigned json_hashBytes(const char * key, size_t length, uint64_t seed) {
+    const uint64_t * secret = json_hashSecret;
+    const unsigned char * p = (const unsigned char*)key;
+    uint64_t a, b;
+    
+    seed ^= json_hash_mix(seed ^ secret[0], secret[1]);
+    
+    if (length <= 16) {
+        if (length >= 4) {
+            a = (json_hash_read4(p) << 32) | json_hash_read4(p + ((length >> 3) << 2));
+            b = (json_hash_read4(p + length - 4) << 32) | json_hash_read4(p + length - 4 - ((length >> 3) << 2));
+        }
+        else if (length > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        }
+        else a = b = 0;
+    }
+    else {
+        size_t i = length;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = json_hash_mix(json_hash_read8(p) ^ secret[1], json_hash_read8(p + 8) ^ seed);
+                see1 = json_hash_mix(json_hash_read8(p + 16) ^ secret[2], json_hash_read8(p + 24) ^ see1);
+                see2 = json_hash_mix(json_hash_read8(p + 32) ^ secret[3], json_hash_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = json_hash_mix(json_hash_read8(p) ^ secret[1], json_hash_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = json_hash_read8(p + i - 16);
+        b = json_hash_read8(p + i - 8);
+    }
+    
+    a ^= secret[1];
+    b ^= seed;
+    json_hash_mum(&a, &b);
+    return (unsigned)json_hash_mix(a ^ secret[0] ^ length, b ^ secret[1]);
+}
+
+static inline unsigned json_hashString(const char * key, size_t length) {
+    return json_hashBytes(key, length, json_hash_seed());
+}
+
+/* Sets the seed of the key hashing. */
+void json_map_set_seed(uint64_t seed) {
+    JSON_ATOMIC_RELEASE(&json_hashSeed, seed);
+    JSON_ATOMIC_RELEASE(&json_hashSeeded, 1);
 }
 
 
 /* Initializes an empty map. */
 void json_map_init(json_object * map) {
-    map->json_map.size = 0;
-    map->json_map.hashtableSize = JSON_HASHTABLE_SIZE;
+    json_map_init_ext(map, 0);
+}
+
+/* Returns the hashtable size for the given number of items. */
+static int json_map_hashtableSizeFor(int capacity) {
+    // same sizes as the expansion would produce
+    int hashtableSize = JSON_HASHTABLE_SIZE;
+    while (hashtableSize / 2 < capacity) hashtableSize *= 2;
+    return hashtableSize;
+}
+
+/* Allocates a hashtable with all slots empty. */
+static int * json_map_newHashtable(int hashtableSize) {
     JSON_DEBUG_MALLOC;
-    map->json_map.hashtable = malloc(sizeof(struct json_map_hashtable_item*)*JSON_HASHTABLE_SIZE);
-    for (int i = 0; i < JSON_HASHTABLE_SIZE; i++) {
-        map->json_map.hashtable[i] = NULL;
+    JSON_STATS_ALLOC(bucket, sizeof(int)*hashtableSize);
+    int * hashtable = malloc(sizeof(int)*hashtableSize);
+    memset(hashtable, 0xFF, sizeof(int)*hashtableSize); // JSON_MAP_EMPTY
+    return hashtable;
+}
+
+/* Initializes an empty map with a hashtable large enough for the given number of items. */
+void json_map_init_ext(json_object * map, int capacity) {
+    if (capacity < 0) capacity = 0;
+    int hashtableSize = json_map_hashtableSizeFor(capacity);
+    
+    map->json_map.size = 0;
+    map->json_map.capacity = capacity;
+    map->json_map.items = NULL;
+    if (capacity > 0) {
+        JSON_DEBUG_MALLOC;
+        JSON_STATS_ALLOC(bucket, sizeof(struct json_map_item)*capacity);
+        map->json_map.items = malloc(sizeof(struct json_map_item)*capacity);
     }
+    map->json_map.hashtableSize = hashtableSize;
+    map->json_map.hashtable = json_map_newHashtable(hashtableSize);
 }
 
-/* Doubles the size of the hashtable. */
-static void json_map_expandHashtable(json_object * map) {
-    int oldSize = map->json_map.hashtableSize;
-    int newSize = 2*oldSize + 1;
+/* Initializes an empty map with the items and the hashtable in the arena. */
+void json_map_init_arena(json_object * map, json_arena * arena, int capacity) {
+    int hashtableSize = json_map_hashtableSizeFor(capacity);
     
-    map->json_map.hashtable = realloc(map->json_map.hashtable, sizeof(struct json_map_hashtable_item*)*newSize);
+    map->json_map.size = 0;
+    map->json_map.capacity = capacity;
+    map->json_map.items = json_arena_alloc(arena, sizeof(struct json_map_item)*capacity);
+    map->json_map.hashtableSize = hashtableSize;
+    map->json_map.hashtable = json_arena_alloc(arena, sizeof(int)*hashtableSize);
+    memset(map->json_map.hashtable, 0xFF, sizeof(int)*hashtableSize);
+}
+
+/* Enlarges the hashtable and inserts the item indices again (with the cached hashes). */
+static void json_map_resizeHashtable(json_object * map, int newSize) {
+    JSON_STATS_ADD(rehashes, 1);
+    JSON_STATS_ALLOC(bucket, sizeof(int)*newSize);
+    int * hashtable = realloc(map->json_map.hashtable, sizeof(int)*newSize);
+    memset(hashtable, 0xFF, sizeof(int)*newSize);
+    map->json_map.hashtable = hashtable;
     map->json_map.hashtableSize = newSize;
+    
+    int mask = newSize - 1;
+    for (int i = 0; i < map->json_map.size; i++) {
+        int slot = map->json_map.items[i].hash & mask;
+        while (hashtable[slot] != JSON_MAP_EMPTY) slot = (slot + 1) & mask;
+        hashtable[slot] = i;
+    }
+}
 
-    // fill the new portion of the array with zeros
-    for (int i = oldSize; i < newSize; i++) {
-        map->json_map.hashtable[i] = NULL;
+/* Enlarges the items array (up to the hashtable's capacity). */
+static void json_map_growItems(json_object * map, int capacity) {
+    if (map->json_map.items == NULL) {
+        JSON_DEBUG_MALLOC;
     }
+    JSON_STATS_ALLOC(bucket, sizeof(struct json_map_item)*capacity);
+    map->json_map.items = realloc(map->json_map.items, sizeof(struct json_map_item)*capacity);
+    map->json_map.capacity = capacity;
+}
 
-    // check the old portion of the array
-    for (int i = 0; i < oldSize; i++) {
-        struct json_map_hashtable_item * item = map->json_map.hashtable[i];
-        struct json_map_hashtable_item * prevItem = NULL;
-        
-        while (item != NULL) {
-            struct json_map_hashtable_item * nextItem = item->next;
-            
-            // should be the item at a different position?
-            int newIndex = json_hashString(item->key) % newSize;
-            if (newIndex != i) {
-                // remove from the linked list
-                if (prevItem == NULL) map->json_map.hashtable[i] = nextItem;
-                else prevItem->next = nextItem;
-                
-                // insert to the other linked list
-                item->next = map->json_map.hashtable[newIndex];
-                map->json_map.hashtable[newIndex] = item;
-            }
-            else prevItem = item;
-            
-            item = nextItem;
-        }
+/* Finds the slot of the key or the empty slot for it, counts the probed slots. */
+static inline int json_map_findSlot(const json_object * map, const char * key, size_t length, unsigned hash, int * probes) {
+    int mask = map->json_map.hashtableSize - 1;
+    int slot = hash & mask;
+    *probes = 1;
+    for (;;) {
+        int index = map->json_map.hashtable[slot];
+        if (index == JSON_MAP_EMPTY) return slot;
+        const struct json_map_item * item = &map->json_map.items[index];
+        if (item->hash == hash && item->length == length && memcmp(key, item->key, length) == 0) return slot; // duplicate key
+        slot = (slot + 1) & mask;
+        (*probes)++;
     }
 }
 
-/* Adds a value to the map. */
-json_object * json_map_put_ext(json_object * map, char * key, json_object * value, bool copyKey) {
-    if (copyKey) {
-        JSON_DEBUG_MALLOC;
-        char * newMemory = malloc(sizeof(char)*(strlen(key)+1));
-        key = strcpy(newMemory, key);
+/* Finds an empty slot for a new item without comparing any keys, counts the probed slots. */
+static inline int json_map_findEmptySlot(const json_object * map, unsigned hash, int * probes) {
+    int mask = map->json_map.hashtableSize - 1;
+    int slot = hash & mask;
+    *probes = 1;
+    while (map->json_map.hashtable[slot] != JSON_MAP_EMPTY) {
+        slot = (slot + 1) & mask;
+        (*probes)++;
     }
-    
+    return slot;
+}
+
+/* Appends a new item, its index is stored to the slot. */
+static inline void json_map_appendItem(json_object * map, int slot, char * key, size_t length, unsigned hash, json_object * value) {
+    struct json_map_item * item = &map->json_map.items[map->json_map.size];
+    item->key = key;
+    item->hash = hash;
+    item->length = (unsigned)length;
+    item->value = value;
+    map->json_map.hashtable[slot] = map->json_map.size++;
+}
+
+/* Makes room for one more item (the hashtable and the items array). */
+static inline void json_map_reserveItem(json_object * map) {
     if (map->json_map.size >= map->json_map.hashtableSize / 2) {
-        json_map_expandHashtable(map);
+        json_map_resizeHashtable(map, 2*map->json_map.hashtableSize); // double the size
     }
-    
-    int index = json_hashString(key) % map->json_map.hashtableSize;
-    struct json_map_hashtable_item * existingItem = map->json_map.hashtable[index];
-    struct json_map_hashtable_item * currentItem = existingItem;
-    
-    struct json_map_hashtable_item * collision = NULL;
-    
-    while (currentItem != NULL) {
-        if (strcmp(key, currentItem->key) == 0) { // duplicate key
-            collision = currentItem;
-            break;
-        }
-        currentItem = currentItem->next;
+    if (map->json_map.size == map->json_map.capacity) {
+        int capacity = map->json_map.capacity > 0 ? 2*map->json_map.capacity : JSON_MAP_CAPACITY;
+        if (capacity > map->json_map.hashtableSize / 2) capacity = map->json_map.hashtableSize / 2;
+        json_map_growItems(map, capacity);
     }
+}
+
+/* 
+ * Inserts an item into a map with room for it, a duplicate key is handled during
+ * the same probe. Returns false if the item was rejected as a duplicate.
+ */
+static inline bool json_map_insertItem(json_object * map, char * key, size_t length, unsigned hash, json_object * value, json_duplicate_keys duplicates, bool freeKey, json_object ** replaced) {
+    int probes;
+    int slot = duplicates == JSON_DUPLICATE_KEEP ? json_map_findEmptySlot(map, hash, &probes) : json_map_findSlot(map, key, length, hash, &probes);
+    int index = map->json_map.hashtable[slot];
+    *replaced = NULL;
     
-    if (collision == NULL) {
-        JSON_DEBUG_MALLOC;
-        struct json_map_hashtable_item * newItem = malloc(sizeof(struct json_map_hashtable_item));
-        newItem->key = key;
-        newItem->value = value;
-        newItem->next = NULL;
-        
-        newItem->next = existingItem;
-        map->json_map.hashtable[index] = newItem;
-        map->json_map.size++;
-        return NULL;
+    if (index == JSON_MAP_EMPTY) {
+        JSON_STATS_MAX(maxChainLength, probes);
+        json_map_appendItem(map, slot, key, length, hash, value);
+        return true;
     }
-    else {
-        free(collision->key);
+    if (duplicates != JSON_DUPLICATE_LAST) return false;
+    
+    // the item keeps its position
+    struct json_map_item * item = &map->json_map.items[index];
+    if (freeKey) {
+        free(item->key);
         JSON_DEBUG_FREE;
-        collision->key = key;
-        json_object * obj = collision->value;
-        collision->value = value;
-        return obj;
     }
+    item->key = key;
+    *replaced = item->value;
+    item->value = value;
+    return true;
+}
+
+/* Adds a value to the map. */
+json_object * json_map_put_ext(json_object * map, char * key, json_object * value, bool copyKey) {
+    size_t length = strlen(key);
+    return json_map_put_hashed(map, key, length, json_hashString(key, length), value, copyKey);
+}
+
+/* Adds a value to the map using the length and a precomputed hash of the key. */
+json_object * json_map_put_hashed(json_object * map, char * key, size_t length, unsigned hash, json_object * value, bool copyKey) {
+    if (copyKey) {
+        size_t keySize = length + 1;
+        JSON_DEBUG_MALLOC;
+        JSON_STATS_ALLOC(string, keySize);
+        char * newMemory = malloc(sizeof(char)*keySize);
+        key = memcpy(newMemory, key, keySize);
+    }
+    
+    json_object * replaced;
+    json_map_reserveItem(map);
+    json_map_insertItem(map, key, length, hash, value, JSON_DUPLICATE_LAST, true, &replaced);
+    return replaced;
+}
+
+/* Adds a value to the map with the given handling of a duplicate key. */
+bool json_map_insert(json_object * map, char * key, size_t length, unsigned hash, json_object * value, json_duplicate_keys duplicates, json_object ** replaced) {
+    json_map_reserveItem(map);
+    return json_map_insertItem(map, key, length, hash, value, duplicates, true, replaced);
+}
+
+/* Adds a value to a map initialized with json_map_init_arena, the key isn't copied. */
+json_object * json_map_put_arena(json_object * map, char * key, size_t length, unsigned hash, json_object * value) {
+    json_object * replaced;
+    json_map_insertItem(map, key, length, hash, value, JSON_DUPLICATE_LAST, false, &replaced);
+    return replaced;
+}
+
+/* Adds a value to a map initialized with json_map_init_arena with the given handling of a duplicate key. */
+bool json_map_insert_arena(json_object * map, char * key, size_t length, unsigned hash, json_object * value, json_duplicate_keys duplicates, json_object ** replaced) {
+    return json_map_insertItem(map, key, length, hash, value, duplicates, false, replaced);
+}
+
+/* Makes sure the map can hold the given number of items without rehashing. */
+void json_map_reserve(json_object * map, int capacity) {
+    int hashtableSize = json_map_hashtableSizeFor(capacity);
+    if (hashtableSize > map->json_map.hashtableSize) json_map_resizeHashtable(map, hashtableSize);
+    if (capacity > map->json_map.capacity) json_map_growItems(map, capacity);
 }
 
 /* Returns number of items in the map. */
@@ -251,38 +666,108 @@ extern int json_map_size(const json_object * map) {
 
 /* Finds a value in the map. */
 json_object * json_map_get(const json_object * map, const char * key) {
-    int index = json_hashString(key) % map->json_map.hashtableSize;
-    struct json_map_hashtable_item * item = map->json_map.hashtable[index];
-    while (item != NULL) {
-        if (strcmp(key, item->key) == 0) return item->value;
-        item = item->next;
+    size_t length = strlen(key);
+    int probes;
+    int index = map->json_map.hashtable[json_map_findSlot(map, key, length, json_hashString(key, length), &probes)];
+    return index != JSON_MAP_EMPTY ? map->json_map.items[index].value : NULL;
+}
+
+/* Finds a value in the map using a precomputed hash of the key. */
+json_object * json_map_get_hashed(const json_object * map, const char * key, unsigned hash) {
+    int mask = map->json_map.hashtableSize - 1;
+    for (int slot = hash & mask; map->json_map.hashtable[slot] != JSON_MAP_EMPTY; slot = (slot + 1) & mask) {
+        const struct json_map_item * item = &map->json_map.items[map->json_map.hashtable[slot]];
+        if (item->hash == hash && strcmp(key, item->key) == 0) return item->value;
     }
     return NULL;
 }
 
+/* Prepares a key for json_map_get_many. */
+json_map_key json_map_key_compile(const char * key) {
+    json_map_key compiled;
+    compiled.key = key;
+    compiled.length = strlen(key);
+    compiled.hash = json_hashString(key, compiled.length);
+    return compiled;
+}
+
+/* 
+ * Finds the values of many keys. The keys are probed in batches, every step is
+ * done for the whole batch before the next one (home slots, items, key strings),
+ * so the cache misses of the keys overlap instead of following each other.
+ */
+void json_map_get_many(const json_object * map, const json_map_key * keys, int n, json_object ** values) {
+    int mask = map->json_map.hashtableSize - 1;
+    const int * hashtable = map->json_map.hashtable;
+    const struct json_map_item * items = map->json_map.items;
+    int slots[JSON_MAP_GET_BATCH];
+    
+    for (int start = 0; start < n; start += JSON_MAP_GET_BATCH) {
+        int end = n - start < JSON_MAP_GET_BATCH ? n : start + JSON_MAP_GET_BATCH;
+        
+        for (int i = start; i < end; i++) {
+            slots[i - start] = keys[i].hash & mask;
+            JSON_PREFETCH(&hashtable[slots[i - start]]);
+        }
+        for (int i = start; i < end; i++) {
+            int index = hashtable[slots[i - start]];
+            if (index != JSON_MAP_EMPTY) JSON_PREFETCH(&items[index]);
+        }
+        for (int i = start; i < end; i++) {
+            int index = hashtable[slots[i - start]];
+            if (index != JSON_MAP_EMPTY && items[index].hash == keys[i].hash) JSON_PREFETCH(items[index].key);
+        }
+        
+        // the home slots are mostly resolved now, collisions continue one by one
+        for (int i = start; i < end; i++) {
+            values[i] = NULL;
+            for (int slot = slots[i - start]; hashtable[slot] != JSON_MAP_EMPTY; slot = (slot + 1) & mask) {
+                const struct json_map_item * item = &items[hashtable[slot]];
+                if (item->hash == keys[i].hash && item->length == keys[i].length && memcmp(keys[i].key, item->key, keys[i].length) == 0) {
+                    values[i] = item->value;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/* Computes the hash of a map key. */
+unsigned json_map_hash(const char * key) {
+    return json_hashString(key, strlen(key));
+}
+
+/* Computes the hash of a map key with a known length. */
+unsigned json_map_hash_len(const char * key, size_t length) {
+    return json_hashString(key, length);
+}
+
+/* Computes the hash of a map key with the given seed. */
+unsigned json_map_hash_seeded(const char * key, size_t length, uint64_t seed) {
+    return json_hashBytes(key, length, seed);
+}
+
+/* Checks if the keys are hashed with the given seed. */
+bool json_map_seed_equals(uint64_t seed) {
+    return json_hash_seed() == seed;
+}
+
 /* Deletes the map contents. */
 void json_map_free_contents(json_object * map) {
-    for (int i = 0; i < map->json_map.hashtableSize; i++) {
-        struct json_map_hashtable_item * item = map->json_map.hashtable[i];
-        while (item != NULL) {
-            json_object_free(item->value);
-            item = item->next;
-        }
+    for (int i = 0; i < map->json_map.size; i++) {
+        json_object_free(map->json_map.items[i].value);
     }
 }
 
 /* Deletes the map (without deleting it's contents). */
 void json_map_free(json_object * map) {
-    for (int i = 0; i < map->json_map.hashtableSize; i++) {
-        struct json_map_hashtable_item * item = map->json_map.hashtable[i];
-        while (item != NULL) {
-            free(item->key);
-            JSON_DEBUG_FREE;
-            struct json_map_hashtable_item * nextItem = item->next;
-            free(item);
-            JSON_DEBUG_FREE;
-            item = nextItem;
-        }
+    for (int i = 0; i < map->json_map.size; i++) {
+        free(map->json_map.items[i].key);
+        JSON_DEBUG_FREE;
+    }
+    if (map->json_map.items != NULL) {
+        free(map->json_map.items);
+        JSON_DEBUG_FREE;
     }
     free(map->json_map.hashtable);
     JSON_DEBUG_FREE;
@@ -292,14 +777,10 @@ void json_map_free(json_object * map) {
 /* Counts the collisions in a hashmap. */
 int json_map_hashtable_collisions(const json_object * map) {
     int collisions = 0;
+    int mask = map->json_map.hashtableSize - 1;
     for (int i = 0; i < map->json_map.hashtableSize; i++) {
-        struct json_map_hashtable_item * item = map->json_map.hashtable[i];
-        int itemsInList = 0;
-        while (item != NULL) {
-            itemsInList++;
-            item = item->next;
-        }
-        if (itemsInList > 1) collisions += itemsInList - 1;
+        int index = map->json_map.hashtable[i];
+        if (index != JSON_MAP_EMPTY && (int)(map->json_map.items[index].hash & mask) != i) collisions++;
     }
     return collisions;
 }
@@ -314,20 +795,18 @@ int json_map_hashtable_size(const json_object * map) {
 void json_map_iterator_init(json_map_iterator * iterator, const json_object * map) {
     iterator->map = map;
     iterator->key = NULL;
+    iterator->length = 0;
     iterator->value = NULL;
-    iterator->hashtablePosition = 0;
-    iterator->hashtableItem = NULL;
+    iterator->position = 0;
 }
 
 /* Returns the next (key, value) pair. */
 bool json_map_iterator_next(json_map_iterator * iterator) {
-    while (iterator->hashtableItem == NULL) {
-        if (iterator->hashtablePosition == iterator->map->json_map.hashtableSize) return false;
-        iterator->hashtableItem = iterator->map->json_map.hashtable[iterator->hashtablePosition++];
-    }
-    iterator->key = iterator->hashtableItem->key;
-    iterator->value = iterator->hashtableItem->value;
-    iterator->hashtableItem = iterator->hashtableItem->next;
+    if (iterator->position == iterator->map->json_map.size) return false;
+    const struct json_map_item * item = &iterator->map->json_map.items[iterator->position++];
+    iterator->key = item->key;
+    iterator->length = item->length;
+    iterator->value = item->value;
     return true;
 }
 
@@ -348,3 +827,144 @@ bool json_array_iterator_next(json_array_iterator * iterator) {
     else return false;
 }
 
+
+
+/* Copies the map's items and hashtable (no rehashing, the items keep their indices). */
+static void json_map_copyHashtable(json_object * copy, const json_object * map, bool deep) {
+    int size = map->json_map.size;
+    copy->json_map.size = size;
+    copy->json_map.capacity = size;
+    copy->json_map.items = NULL;
+    if (size > 0) {
+        JSON_DEBUG_MALLOC;
+        JSON_STATS_ALLOC(bucket, sizeof(struct json_map_item)*size);
+        copy->json_map.items = malloc(sizeof(struct json_map_item)*size);
+    }
+    copy->json_map.hashtableSize = map->json_map.hashtableSize;
+    JSON_DEBUG_MALLOC;
+    JSON_STATS_ALLOC(bucket, sizeof(int)*map->json_map.hashtableSize);
+    copy->json_map.hashtable = malloc(sizeof(int)*map->json_map.hashtableSize);
+    memcpy(copy->json_map.hashtable, map->json_map.hashtable, sizeof(int)*map->json_map.hashtableSize);
+    
+    for (int i = 0; i < size; i++) {
+        const struct json_map_item * item = &map->json_map.items[i];
+        struct json_map_item * newItem = &copy->json_map.items[i];
+        size_t keySize = item->length + 1;
+        JSON_DEBUG_MALLOC;
+        JSON_STATS_ALLOC(string, keySize);
+        newItem->key = malloc(sizeof(char)*keySize);
+        memcpy(newItem->key, item->key, keySize);
+        newItem->hash = item->hash;
+        newItem->length = item->length;
+        newItem->value = deep ? json_object_clone(item->value) : json_object_reference(item->value);
+    }
+}
+
+/* Copies the object, the items of containers are either cloned or referenced. */
+static json_object * json_object_copyExt(const json_object * obj, bool deep) {
+    json_object * copy = json_object_new(obj->type);
+    
+    switch (obj->type) {
+    case JSON_OBJECT_STRING:
+        json_string_init_len(copy, obj->json_string.string, obj->json_string.length, true);
+        break;
+    case JSON_OBJECT_ARRAY:
+        copy->json_array.size = obj->json_array.size;
+        copy->json_array.capacity = obj->json_array.capacity;
+        copy->json_array.packed = JSON_OBJECT_NULL;
+        copy->json_array.numbers.ints = NULL;
+        if (obj->json_array.packed) {
+            // copy the numbers only (also for shallow copies, the boxes aren't shared)
+            copy->json_array.packed = obj->json_array.packed;
+            copy->json_array.items = NULL;
+            JSON_DEBUG_MALLOC;
+            JSON_STATS_ALLOC(array, sizeof(int)*obj->json_array.capacity);
+            copy->json_array.numbers.ints = malloc(sizeof(int)*obj->json_array.capacity);
+            memcpy(copy->json_array.numbers.ints, obj->json_array.numbers.ints, sizeof(int)*obj->json_array.size);
+            break;
+        }
+        JSON_DEBUG_MALLOC;
+        JSON_STATS_ALLOC(array, sizeof(json_object*)*obj->json_array.capacity);
+        copy->json_array.items = malloc(sizeof(json_object*)*obj->json_array.capacity);
+        for (int i = 0; i < obj->json_array.size; i++) {
+            json_object * item = obj->json_array.items[i];
+            copy->json_array.items[i] = deep ? json_object_clone(item) : json_object_reference(item);
+        }
+        break;
+    case JSON_OBJECT_MAP:
+        json_map_copyHashtable(copy, obj, deep);
+        break;
+    default: // scalars
+        *copy = *obj;
+        copy->_private.refs = 1;
+        break;
+    }
+    
+    return copy;
+}
+
+/* Creates a deep copy of the object. */
+json_object * json_object_clone(const json_object * obj) {
+    return json_object_copyExt(obj, true);
+}
+
+/* Creates a shallow copy of the object (items of arrays and maps are shared by reference). */
+json_object * json_object_copy(const json_object * obj) {
+    return json_object_copyExt(obj, false);
+}
+
+/* Converts a path element to an array index, returns -1 if it's not a valid index. */
+static int json_array_pathIndex(const json_object * array, const char * element) {
+    if (strcmp(element, "-") == 0) return array->json_array.size;
+    if (element[0] == '\0' || (element[0] == '0' && element[1] != '\0')) return -1;
+    
+    int index = 0;
+    for (const char * c = element; *c; c++) {
+        if (*c < '0' || *c > '9' || index > (array->json_array.size - (*c - '0')) / 10) return -1;
+        index = index*10 + (*c - '0');
+    }
+    return index;
+}
+
+/* Copies the containers along the path and stores the value at its end. */
+static json_object * json_object_setPathRecursive(const json_object * node, const char ** path, int length, json_object * value) {
+    if (length == 0) return value;
+    
+    if (node == NULL || node->type == JSON_OBJECT_MAP) {
+        json_object * child = node ? json_map_get(node, path[0]) : NULL;
+        json_object * newChild = json_object_setPathRecursive(child, path + 1, length - 1, value);
+        if (newChild == NULL) return NULL;
+        
+        json_object * copy = node ? json_object_copy(node) : json_map();
+        json_object * oldChild = json_map_put(copy, path[0], newChild);
+        if (oldChild != NULL) json_object_free(oldChild);
+        return copy;
+    }
+    else if (node->type == JSON_OBJECT_ARRAY) {
+        int index = json_array_pathIndex(node, path[0]);
+        if (index < 0 || index > node->json_array.size) return NULL;
+        
+        json_object scratch;
+        const json_object * child = index < node->json_array.size ? json_array_peek(node, index, &scratch) : NULL;
+        json_object * newChild = json_object_setPathRecursive(child, path + 1, length - 1, value);
+        if (newChild == NULL) return NULL;
+        
+        json_object * copy = json_object_copy(node);
+        if (copy->json_array.packed) json_array_unpack(copy); // a private copy
+        if (index == copy->json_array.size) {
+            json_array_add(copy, newChild);
+        }
+        else {
+            json_object_free(copy->json_array.items[index]);
+            copy->json_array.items[index] = newChild;
+        }
+        return copy;
+    }
+    else return NULL; // can't descend into a scalar
+}
+
+/* Returns a new version of the tree with the value at the given path replaced (copy-on-write). */
+json_object * json_object_set_path(const json_object * root, const char ** path, int length, json_object * value) {
+    if (length == 0) return value;
+    return json_object_setPathRecursive(root, path, length, value);
+}
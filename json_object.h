@@ -30,6 +30,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "json_arena.h"
 
 #ifdef	__cplusplus
 extern "C" {
@@ -68,30 +71,52 @@ struct json_float {
 struct json_string {
     struct json_object_private _p;
     char * string;
+    int length;
 };
 
 struct json_array {
     struct json_object_private _p;
-    union JSON_OBJECT ** items;
+    union JSON_OBJECT ** items; // items (boxed lazily for packed arrays, NULL until needed)
     int size;
     int capacity;
+    json_object_type packed; // JSON_OBJECT_INT or JSON_OBJECT_FLOAT for packed numeric arrays
+    union {
+        int * ints;
+        float * floats;
+    } numbers;
 };
 
-struct json_map_hashtable_item;
-
+/* 
+ * The map items are stored densely in the insertion order, the hashtable holds
+ * their indices (open addressing with linear probing, at most half full).
+ */
 struct json_map {
     struct json_object_private _p;
     int size;
-    struct json_map_hashtable_item ** hashtable;
+    int capacity; // of the items array
+    struct json_map_item * items;
+    int * hashtable; // item indices, JSON_MAP_EMPTY for empty slots
     int hashtableSize;
 };
 
-struct json_map_hashtable_item {
+struct json_map_item {
     char * key;
+    unsigned hash; // cached hash of the key
+    unsigned length; // of the key, compared before the key itself
     union JSON_OBJECT * value;
-    struct json_map_hashtable_item * next;
 };
 
+#define JSON_MAP_EMPTY -1
+
+/* Handling of a duplicate key inserted into a map. */
+typedef enum JSON_DUPLICATE_KEYS {
+    JSON_DUPLICATE_LAST = 0, // the new value replaces the old one (the item keeps its position)
+    JSON_DUPLICATE_FIRST, // the old value is kept, the new one is rejected
+    JSON_DUPLICATE_ERROR, // the new value is rejected, the parsers fail with JSON_ERROR_DUPLICATE_KEY
+    JSON_DUPLICATE_KEEP, // all the items are kept (multimap), no keys are compared at all
+    JSON_DUPLICATE_TRUSTED = JSON_DUPLICATE_KEEP // the keys are known to be unique, so there is nothing to check
+} json_duplicate_keys;
+
 /* JSON object union. */
 typedef union JSON_OBJECT {
     JSON_TYPE;
@@ -106,12 +131,23 @@ typedef union JSON_OBJECT {
 
 
 
+/* Contiguous numbers of a packed array. */
+typedef struct JSON_NUMBERS {
+    json_object_type type; // JSON_OBJECT_INT or JSON_OBJECT_FLOAT, JSON_OBJECT_NULL if the array isn't packed
+    int size;
+    union {
+        const int * ints;
+        const float * floats;
+    } data;
+} json_numbers;
+
+
 typedef struct JSON_MAP_ITERATOR {
     const json_object * map;
     char * key;
+    size_t length; // of the key
     union JSON_OBJECT * value;
-    int hashtablePosition;
-    struct json_map_hashtable_item * hashtableItem;
+    int position; // index of the next item
 } json_map_iterator;
 
 
@@ -126,14 +162,43 @@ typedef struct JSON_ARRAY_ITERATOR {
 extern json_object * json_object_new(json_object_type type);
 
 
-/* Deletes the JSON object and it's contents recursively. */
+/* 
+ * Deletes the JSON object and it's contents recursively (or drops a reference).
+ * The reference counts are atomic, so versions sharing subtrees can be freed
+ * and referenced from different threads.
+ */
 extern void json_object_free(json_object * obj);
 
+/* 
+ * Creates a new JSON object in the arena. Arena objects are released with the
+ * arena: freeing and referencing them does nothing. Trees built in an arena are
+ * read-only (they can be copied or cloned though).
+ */
+extern json_object * json_object_new_arena(json_arena * arena, json_object_type type);
+
 
 /* Makes a reference to the object. */
 extern json_object * json_object_reference(json_object * obj);
 
 
+/* Creates a deep copy of the object. */
+extern json_object * json_object_clone(const json_object * obj);
+
+/* Creates a shallow copy of the object (items of arrays and maps are shared by reference). */
+extern json_object * json_object_copy(const json_object * obj);
+
+/*
+ * Returns a new version of the tree with the value at the given path replaced (copy-on-write).
+ *
+ * Only the containers along the path are copied, all other subtrees are shared
+ * with the original tree, which is left untouched. Path elements are map keys or
+ * array indices ("-" appends to the array), missing map keys are created.
+ * The value is owned by the new tree. Returns NULL (and doesn't take the value)
+ * if the path cannot be followed.
+ */
+extern json_object * json_object_set_path(const json_object * root, const char ** path, int length, json_object * value);
+
+
 
 /* Returns the integer value. */
 static inline int json_int_value(const json_object * obj) { return obj->json_int.value; }
@@ -148,14 +213,23 @@ static inline float json_float_value(const json_object * obj) { return obj->json
 /* Initializes a string. */
 extern void json_string_init_ext(json_object * string, char * str, bool copy);
 
+/* Initializes a string with a known length. */
+extern void json_string_init_len(json_object * string, char * str, int length, bool copy);
+
 /* Initializes a string. */
 static inline void json_string_init(json_object * string, char * str) {
     json_string_init_ext(string, str, true);
 }
 
+/* Initializes a string with a copy stored in the arena. */
+extern void json_string_init_arena(json_object * string, json_arena * arena, const char * str, int length);
+
 /* Returns the string value. */
 static inline char * json_string_value(const json_object * string) { return string->json_string.string; }
 
+/* Returns the length of the string. */
+static inline int json_string_length(const json_object * string) { return string->json_string.length; }
+
 /* Frees the string. */
 extern void json_string_free(json_object * string);
 
@@ -163,15 +237,59 @@ extern void json_string_free(json_object * string);
 /* Initializes an empty array object. */
 extern void json_array_init(json_object * array);
 
+/* Initializes an empty array object with the given capacity. */
+extern void json_array_init_ext(json_object * array, int capacity);
+
+/* 
+ * Initializes an empty array object with the item buffer in the arena, it can't
+ * hold more than the given number of items.
+ */
+extern void json_array_init_arena(json_object * array, json_arena * arena, int capacity);
+
+/* 
+ * Initializes an empty packed array, the integers (type JSON_OBJECT_INT) or floats
+ * (JSON_OBJECT_FLOAT) are stored in a contiguous buffer instead of being boxed. It
+ * stays packed while only numbers of the type are added with json_array_add_int or
+ * json_array_add_float before any item is boxed, other changes convert it to a
+ * regular array.
+ */
+extern void json_array_init_packed(json_object * array, json_object_type type, int capacity);
+
+/* Makes sure the array can hold the given number of items without reallocation. */
+extern void json_array_reserve(json_object * array, int capacity);
+
 /* Adds a new item to the array. */
 extern void json_array_add(json_object * array, json_object * newItem);
 
+/* Adds the items to the array (the array takes the ownership). */
+extern void json_array_add_n(json_object * array, json_object * const * items, int count);
+
+/* Adds an integer to the array (unboxed if the array is packed with integers). */
+extern void json_array_add_int(json_object * array, int value);
+
+/* Adds a float to the array (see json_array_add_int). */
+extern void json_array_add_float(json_object * array, float value);
+
 /* Returns the size of the array. */
 extern int json_array_size(const json_object * array);
 
-/* Returns an object from the array. */
+/* 
+ * Returns an object from the array. The numbers of a packed array are boxed on
+ * demand: the boxes are cached with the array (safely from several threads) and
+ * they are read-only, the packed numbers stay as they are. Use json_array_peek
+ * or json_array_numbers to read the numbers without boxing.
+ */
 extern json_object * json_array_get(const json_object * array, int index);
 
+/* 
+ * Returns an object from the array without boxing: numbers of packed arrays are
+ * written into the scratch object, which is returned instead.
+ */
+extern const json_object * json_array_peek(const json_object * array, int index, json_object * scratch);
+
+/* Returns the numbers of a packed array (the type is JSON_OBJECT_NULL for other arrays). */
+extern json_numbers json_array_numbers(const json_object * array);
+
 /* Deletes the array contents. */
 extern void json_array_free_contents(json_object * array);
 
@@ -182,9 +300,39 @@ extern void json_array_free(json_object * array);
 /* Initializes an empty map. */
 extern void json_map_init(json_object * map);
 
+/* Initializes an empty map with a hashtable large enough for the given number of items. */
+extern void json_map_init_ext(json_object * map, int capacity);
+
+/* 
+ * Initializes an empty map with the hashtable in the arena, it can't hold more
+ * than the given number of items (the items are added with json_map_put_arena).
+ */
+extern void json_map_init_arena(json_object * map, json_arena * arena, int capacity);
+
 /* Adds a value to the map. */
 extern json_object * json_map_put_ext(json_object * map, char * key, json_object * value, bool copyKey);
 
+/* Makes sure the map can hold the given number of items without rehashing. */
+extern void json_map_reserve(json_object * map, int capacity);
+
+/* Adds a value to the map using the length and a precomputed hash of the key (see json_map_hash_len). */
+extern json_object * json_map_put_hashed(json_object * map, char * key, size_t length, unsigned hash, json_object * value, bool copyKey);
+
+/* Adds a value to a map initialized with json_map_init_arena, the key isn't copied (it has to live as long as the map). */
+extern json_object * json_map_put_arena(json_object * map, char * key, size_t length, unsigned hash, json_object * value);
+
+/* 
+ * Adds a value to the map with the given handling of a duplicate key, the key isn't
+ * copied. Returns false if the value was rejected (JSON_DUPLICATE_FIRST or JSON_DUPLICATE_ERROR),
+ * the key and the value stay with the caller then. A value replaced with JSON_DUPLICATE_LAST
+ * is stored to replaced (NULL otherwise). With JSON_DUPLICATE_KEEP, json_map_get returns
+ * the first of the values and the iterator returns all of them.
+ */
+extern bool json_map_insert(json_object * map, char * key, size_t length, unsigned hash, json_object * value, json_duplicate_keys duplicates, json_object ** replaced);
+
+/* Adds a value to a map initialized with json_map_init_arena with the given handling of a duplicate key (see json_map_insert). */
+extern bool json_map_insert_arena(json_object * map, char * key, size_t length, unsigned hash, json_object * value, json_duplicate_keys duplicates, json_object ** replaced);
+
 /* Adds a value to the map. */
 static inline json_object * json_map_put(json_object * map, const char * key, json_object * value) {
     return json_map_put_ext(map, (char*)key, value, true);
@@ -196,6 +344,49 @@ extern int json_map_size(const json_object * map);
 /* Finds a value in the map. */
 extern json_object * json_map_get(const json_object * map, const char * key);
 
+/* Finds a value in the map using a precomputed hash of the key (see json_map_hash). */
+extern json_object * json_map_get_hashed(const json_object * map, const char * key, unsigned hash);
+
+/* Key prepared for repeated lookups, with its length and hash (see json_map_key_compile). */
+typedef struct JSON_MAP_KEY {
+    const char * key; // not copied, it has to live as long as the descriptor
+    size_t length;
+    unsigned hash;
+} json_map_key;
+
+/* Prepares a key for json_map_get_many (the hash depends on the seed, see json_map_set_seed). */
+extern json_map_key json_map_key_compile(const char * key);
+
+/* 
+ * Finds the values of n keys in one pass, values[i] is NULL if keys[i] isn't in the map.
+ * The probes of the keys are interleaved and prefetched, which hides the cache misses
+ * when many fields are extracted from the same map.
+ */
+extern void json_map_get_many(const json_object * map, const json_map_key * keys, int n, json_object ** values);
+
+/* Computes the hash of a map key. */
+extern unsigned json_map_hash(const char * key);
+
+/* Computes the hash of a map key with a known length. */
+extern unsigned json_map_hash_len(const char * key, size_t length);
+
+/* 
+ * Computes the hash of a map key with the given seed instead of the process's one
+ * (for hashes stored outside of the process, see json_map_seed_equals).
+ */
+extern unsigned json_map_hash_seeded(const char * key, size_t length, uint64_t seed);
+
+/* Checks if the keys are hashed with the given seed, so hashes computed with it can be used. */
+extern bool json_map_seed_equals(uint64_t seed);
+
+/* 
+ * Sets the seed of the key hashing (by default it's read from /dev/urandom once
+ * for every process). Must be called before any map is created or key hashed, and
+ * not while other threads use maps, the hashes computed with the old seed don't
+ * match the new ones.
+ */
+extern void json_map_set_seed(uint64_t seed);
+
 /* Deletes the map contents. */
 extern void json_map_free_contents(json_object * map);
 
@@ -203,7 +394,7 @@ extern void json_map_free_contents(json_object * map);
 extern void json_map_free(json_object * map);
 
 
-/* Counts the collisions in a hashmap. */
+/* Counts the collisions in a hashmap (items which are not in their home slot). */
 extern int json_map_hashtable_collisions(const json_object * map);
 
 /* Returns the capacity of the hashtable. */
@@ -213,7 +404,7 @@ extern int json_map_hashtable_size(const json_object * map);
 /* Initializes a new map iterator. */
 extern void json_map_iterator_init(json_map_iterator * iterator, const json_object * map);
 
-/* Returns the next (key, value) pair. */
+/* Returns the next (key, value) pair, in the insertion order. */
 extern bool json_map_iterator_next(json_map_iterator * iterator);
 
 
@@ -253,6 +444,12 @@ static inline json_object * json_string_ref(char * string) {
     return obj;
 }
 
+static inline json_object * json_string_ref_len(char * string, int length) {
+    json_object * obj = json_object_new(JSON_OBJECT_STRING);
+    json_string_init_len(obj, string, length, false);
+    return obj;
+}
+
 static inline json_object * json_string(const char * string) {
     json_object * obj = json_object_new(JSON_OBJECT_STRING);
     json_string_init_ext(obj, (char*)string, true);
@@ -265,12 +462,24 @@ static inline json_object * json_array() {
     return obj;
 }
 
+static inline json_object * json_array_ext(int capacity) {
+    json_object * obj = json_object_new(JSON_OBJECT_ARRAY);
+    json_array_init_ext(obj, capacity);
+    return obj;
+}
+
 static inline json_object * json_map() {
     json_object * obj = json_object_new(JSON_OBJECT_MAP);
     json_map_init(obj);
     return obj;
 }
 
+static inline json_object * json_map_ext(int capacity) {
+    json_object * obj = json_object_new(JSON_OBJECT_MAP);
+    json_map_init_ext(obj, capacity);
+    return obj;
+}
+
 #ifdef	__cplusplus
 }
 #endif
@@ -0,0 +1,872 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "json_path.h"
+#include "json.h"
+#include "json_tokenizer.h"
+#include "json_debug.h"
+#include "json_error.h"
+
+#define JSON_PATH_CAPACITY 4
+
+
+/* Creates an empty path. */
+static json_path * json_path_new(void) {
+    JSON_DEBUG_MALLOC;
+    json_path * path = malloc(sizeof(json_path));
+    path->steps = NULL;
+    path->length = 0;
+    path->capacity = 0;
+    return path;
+}
+
+/* Appends a new step to the path. */
+static json_path_step * json_path_addStep(json_path * path, json_path_step_type type) {
+    if (path->length == path->capacity) {
+        if (path->steps == NULL) {
+            JSON_DEBUG_MALLOC;
+            path->capacity = JSON_PATH_CAPACITY;
+        }
+        else path->capacity *= 2;
+        path->steps = realloc(path->steps, sizeof(json_path_step)*path->capacity);
+    }
+    json_path_step * step = &path->steps[path->length++];
+    step->type = type;
+    step->key = NULL;
+    step->hash = 0;
+    step->index = -1;
+    step->filterPath = NULL;
+    step->filterOperator = JSON_PATH_EXISTS;
+    step->filterValue = NULL;
+    return step;
+}
+
+/* Converts a key to an array index, returns -1 if the key isn't a valid index. */
+static int json_path_keyIndex(const char * key) {
+    if (key[0] == '\0' || (key[0] == '0' && key[1] != '\0')) return -1;
+    int index = 0;
+    for (int i = 0; key[i]; i++) {
+        if (key[i] < '0' || key[i] > '9' || i >= 9) return -1;
+        index = index*10 + (key[i] - '0');
+    }
+    return index;
+}
+
+/* Appends a member step, the key is owned by the path. */
+static void json_path_addMember(json_path * path, char * key) {
+    json_path_step * step = json_path_addStep(path, JSON_PATH_MEMBER);
+    step->key = key;
+    step->hash = json_map_hash(key);
+    step->index = json_path_keyIndex(key);
+}
+
+/* Frees the compiled path. */
+void json_path_free(json_path * path) {
+    for (int i = 0; i < path->length; i++) {
+        json_path_step * step = &path->steps[i];
+        if (step->key) { free(step->key); JSON_DEBUG_FREE; }
+        if (step->filterPath) json_path_free(step->filterPath);
+        if (step->filterValue) json_object_free(step->filterValue);
+    }
+    if (path->steps) { free(path->steps); JSON_DEBUG_FREE; }
+    free(path);
+    JSON_DEBUG_FREE;
+}
+
+
+#define THROW_ERROR { if (error) { error->code = JSON_ERROR_PATH_SYNTAX; error->line = 1; error->pos = (int)(*c - expression) + 1; } return false; }
+
+/* Compiles a JSON Pointer ("/a/b~1c/0"). */
+static bool json_path_compilePointer(json_path * path, const char * expression, const char ** c, json_error * error) {
+    while (**c == '/') {
+        (*c)++;
+        
+        int length = 0;
+        while ((*c)[length] != '/' && (*c)[length] != '\0') length++;
+        
+        JSON_DEBUG_MALLOC;
+        char * key = malloc(sizeof(char)*(length + 1));
+        int keyLength = 0;
+        for (int i = 0; i < length; i++) {
+            if ((*c)[i] == '~') { // escape sequence
+                i++;
+                if (i < length && (*c)[i] == '0') key[keyLength++] = '~';
+                else if (i < length && (*c)[i] == '1') key[keyLength++] = '/';
+                else {
+                    free(key); JSON_DEBUG_FREE;
+                    *c += i;
+                    THROW_ERROR;
+                }
+            }
+            else key[keyLength++] = (*c)[i];
+        }
+        key[keyLength] = '\0';
+        
+        json_path_addMember(path, key);
+        *c += length;
+    }
+    if (**c != '\0') THROW_ERROR;
+    return true;
+}
+
+static inline bool is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') 
+            || c == '_' || c == '-' || c == '$' || (unsigned char)c >= 0x80;
+}
+
+static inline void skip_spaces(const char ** c) {
+    while (**c == ' ' || **c == '\t') (*c)++;
+}
+
+/* Reads a quoted string (the current character is the quote), returns NULL on error. */
+static char * json_path_compileQuoted(const char ** c) {
+    char quote = *(*c)++;
+    const char * start = *c;
+    while (**c != quote) {
+        if (**c == '\0') return NULL;
+        if (**c == '\\' && (*c)[1] != '\0') (*c)++;
+        (*c)++;
+    }
+    
+    JSON_DEBUG_MALLOC;
+    char * string = malloc(sizeof(char)*(*c - start + 1));
+    int length = 0;
+    for (const char * s = start; s < *c; s++) {
+        if (*s == '\\') s++;
+        string[length++] = *s;
+    }
+    string[length] = '\0';
+    (*c)++; // closing quote
+    return string;
+}
+
+/* Parses a filter literal (number, string, true, false or null). */
+static json_object * json_path_compileLiteral(const char ** c) {
+    if (**c == '\'') {
+        char * string = json_path_compileQuoted(c);
+        return string ? json_string_ref(string) : NULL;
+    }
+    
+    const char * start = *c;
+    if (**c == '"') {
+        (*c)++;
+        while (**c != '"') {
+            if (**c == '\0') return NULL;
+            if (**c == '\\' && (*c)[1] != '\0') (*c)++;
+            (*c)++;
+        }
+        (*c)++;
+    }
+    else {
+        while (**c != '\0' && **c != ')' && **c != ' ' && **c != '\t') (*c)++;
+    }
+    
+    // let the parser convert the literal
+    JSON_DEBUG_MALLOC;
+    char * literal = malloc(sizeof(char)*(*c - start + 1));
+    memcpy(literal, start, *c - start);
+    literal[*c - start] = '\0';
+    json_object * value = json_parse_string(literal, NULL);
+    free(literal);
+    JSON_DEBUG_FREE;
+    
+    if (value && (value->type == JSON_OBJECT_ARRAY || value->type == JSON_OBJECT_MAP)) {
+        json_object_free(value);
+        return NULL;
+    }
+    return value;
+}
+
+static bool json_path_compileSteps(json_path * path, const char * expression, const char ** c, json_error * error);
+
+/* Compiles a filter ("?(@.key op literal)"), the current character is '?'. */
+static bool json_path_compileFilter(json_path * path, const char * expression, const char ** c, json_error * error) {
+    (*c)++;
+    if (**c != '(') THROW_ERROR;
+    (*c)++;
+    skip_spaces(c);
+    if (**c != '@') THROW_ERROR;
+    (*c)++;
+    
+    json_path_step * step = json_path_addStep(path, JSON_PATH_FILTER);
+    step->filterPath = json_path_new();
+    if (!json_path_compileSteps(step->filterPath, expression, c, error)) return false;
+    skip_spaces(c);
+    
+    json_path_operator op;
+    if (**c == ')') op = JSON_PATH_EXISTS;
+    else if ((*c)[0] == '=' && (*c)[1] == '=') op = JSON_PATH_EQ;
+    else if ((*c)[0] == '!' && (*c)[1] == '=') op = JSON_PATH_NE;
+    else if ((*c)[0] == '<' && (*c)[1] == '=') op = JSON_PATH_LE;
+    else if ((*c)[0] == '>' && (*c)[1] == '=') op = JSON_PATH_GE;
+    else if ((*c)[0] == '<') op = JSON_PATH_LT;
+    else if ((*c)[0] == '>') op = JSON_PATH_GT;
+    else THROW_ERROR;
+    step->filterOperator = op;
+    
+    if (op != JSON_PATH_EXISTS) {
+        *c += (op == JSON_PATH_LT || op == JSON_PATH_GT) ? 1 : 2;
+        skip_spaces(c);
+        step->filterValue = json_path_compileLiteral(c);
+        if (step->filterValue == NULL) THROW_ERROR;
+        skip_spaces(c);
+    }
+    
+    if (**c != ')') THROW_ERROR;
+    (*c)++;
+    return true;
+}
+
+/* Compiles a bracket step ("[0]", "['key']", "[*]", "[?(...)]"), the current character is '['. */
+static bool json_path_compileBracket(json_path * path, const char * expression, const char ** c, json_error * error) {
+    (*c)++;
+    skip_spaces(c);
+    
+    if (**c == '*') {
+        json_path_addStep(path, JSON_PATH_WILDCARD);
+        (*c)++;
+    }
+    else if (**c == '\'' || **c == '"') {
+        char * key = json_path_compileQuoted(c);
+        if (key == NULL) THROW_ERROR;
+        json_path_addMember(path, key);
+    }
+    else if (**c == '?') {
+        if (!json_path_compileFilter(path, expression, c, error)) return false;
+    }
+    else if (**c == '-' || (**c >= '0' && **c <= '9')) {
+        bool negative = **c == '-';
+        if (negative) (*c)++;
+        if (**c < '0' || **c > '9') THROW_ERROR;
+        int index = 0;
+        for (int digits = 0; **c >= '0' && **c <= '9'; digits++) {
+            if (digits == 9) THROW_ERROR;
+            index = index*10 + (*(*c)++ - '0');
+        }
+        json_path_addStep(path, JSON_PATH_INDEX)->index = negative ? -index : index;
+    }
+    else THROW_ERROR;
+    
+    skip_spaces(c);
+    if (**c != ']') THROW_ERROR;
+    (*c)++;
+    return true;
+}
+
+/* Compiles a dot step (".key", ".*"), the current character follows the dot. */
+static bool json_path_compileDot(json_path * path, const char * expression, const char ** c, json_error * error) {
+    if (**c == '*') {
+        json_path_addStep(path, JSON_PATH_WILDCARD);
+        (*c)++;
+        return true;
+    }
+    
+    const char * start = *c;
+    while (is_name_char(**c)) (*c)++;
+    if (*c == start) THROW_ERROR;
+    
+    JSON_DEBUG_MALLOC;
+    char * key = malloc(sizeof(char)*(*c - start + 1));
+    memcpy(key, start, *c - start);
+    key[*c - start] = '\0';
+    json_path_addMember(path, key);
+    return true;
+}
+
+/* Compiles JSONPath steps following the root ('$' or '@'). */
+static bool json_path_compileSteps(json_path * path, const char * expression, const char ** c, json_error * error) {
+    while (true) {
+        if ((*c)[0] == '.' && (*c)[1] == '.') {
+            json_path_addStep(path, JSON_PATH_DESCENDANT);
+            *c += 2;
+            if (**c == '[') {
+                if (!json_path_compileBracket(path, expression, c, error)) return false;
+            }
+            else if (!json_path_compileDot(path, expression, c, error)) return false;
+        }
+        else if (**c == '.') {
+            (*c)++;
+            if (!json_path_compileDot(path, expression, c, error)) return false;
+        }
+        else if (**c == '[') {
+            if (!json_path_compileBracket(path, expression, c, error)) return false;
+        }
+        else return true;
+    }
+}
+
+/* Compiles a path expression. */
+json_path * json_path_compile(const char * expression, json_error * error) {
+    json_path * path = json_path_new();
+    const char * c = expression;
+    bool ok;
+    
+    if (*c == '$') {
+        c++;
+        ok = json_path_compileSteps(path, expression, &c, error);
+        if (ok && *c != '\0') {
+            if (error) { error->code = JSON_ERROR_PATH_SYNTAX; error->line = 1; error->pos = (int)(c - expression) + 1; }
+            ok = false;
+        }
+    }
+    else ok = json_path_compilePointer(path, expression, &c, error);
+    
+    if (!ok) {
+        json_path_free(path);
+        return NULL;
+    }
+    return path;
+}
+
+#undef THROW_ERROR
+
+
+typedef bool (* json_path_callback)(const json_object * value, void * data);
+
+static bool json_path_evalRecursive(const json_path * path, int state, const json_object * node, json_path_callback callback, void * data);
+
+/* Compares two scalars, returns false if they are not comparable. */
+static bool json_path_compare(const json_object * a, const json_object * b, int * result) {
+    bool aNumeric = a->type == JSON_OBJECT_INT || a->type == JSON_OBJECT_FLOAT;
+    bool bNumeric = b->type == JSON_OBJECT_INT || b->type == JSON_OBJECT_FLOAT;
+    
+    if (aNumeric && bNumeric) {
+        double x = a->type == JSON_OBJECT_INT ? json_int_value(a) : json_float_value(a);
+        double y = b->type == JSON_OBJECT_INT ? json_int_value(b) : json_float_value(b);
+        *result = (x > y) - (x < y);
+        return true;
+    }
+    if (a->type != b->type) return false;
+    
+    switch (a->type) {
+    case JSON_OBJECT_STRING:
+        *result = strcmp(json_string_value(a), json_string_value(b));
+        return true;
+    case JSON_OBJECT_BOOL:
+        *result = (int)json_bool_value(a) - (int)json_bool_value(b);
+        return true;
+    case JSON_OBJECT_NULL:
+        *result = 0;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Checks the filter condition on a container item. */
+static bool json_path_filterMatches(const json_path_step * step, const json_object * item) {
+    const json_object * operand = json_path_get(step->filterPath, item);
+    if (operand == NULL) return false;
+    if (step->filterOperator == JSON_PATH_EXISTS) return true;
+    
+    int result;
+    if (!json_path_compare(operand, step->filterValue, &result)) return step->filterOperator == JSON_PATH_NE;
+    
+    switch (step->filterOperator) {
+    case JSON_PATH_EQ: return result == 0;
+    case JSON_PATH_NE: return result != 0;
+    case JSON_PATH_LT: return result < 0;
+    case JSON_PATH_LE: return result <= 0;
+    case JSON_PATH_GT: return result > 0;
+    case JSON_PATH_GE: return result >= 0;
+    default: return true;
+    }
+}
+
+/* Applies the step to all items of a container. */
+static bool json_path_evalItems(const json_path * path, int state, int nextState, const json_object * node, json_path_callback callback, void * data) {
+    const json_path_step * step = &path->steps[state];
+    
+    if (node->type == JSON_OBJECT_ARRAY) {
+        for (int i = 0; i < json_array_size(node); i++) {
+            json_object * item = json_array_get(node, i);
+            if (step->type == JSON_PATH_FILTER && !json_path_filterMatches(step, item)) continue;
+            if (!json_path_evalRecursive(path, nextState, item, callback, data)) return false;
+        }
+    }
+    else if (node->type == JSON_OBJECT_MAP) {
+        json_map_iterator iterator;
+        json_map_iterator_init(&iterator, node);
+        while (json_map_iterator_next(&iterator)) {
+            if (step->type == JSON_PATH_FILTER && !json_path_filterMatches(step, iterator.value)) continue;
+            if (!json_path_evalRecursive(path, nextState, iterator.value, callback, data)) return false;
+        }
+    }
+    return true;
+}
+
+/* Evaluates the rest of the path (starting with the given step) on the node. Returns false to stop. */
+static bool json_path_evalRecursive(const json_path * path, int state, const json_object * node, json_path_callback callback, void * data) {
+    if (state == path->length) return callback(node, data);
+    
+    const json_path_step * step = &path->steps[state];
+    json_object * child = NULL;
+    
+    switch (step->type) {
+    case JSON_PATH_MEMBER:
+        if (node->type == JSON_OBJECT_MAP) child = json_map_get_hashed(node, step->key, step->hash);
+        else if (node->type == JSON_OBJECT_ARRAY) child = json_array_get(node, step->index);
+        break;
+    case JSON_PATH_INDEX:
+        if (node->type == JSON_OBJECT_ARRAY) {
+            child = json_array_get(node, step->index >= 0 ? step->index : json_array_size(node) + step->index);
+        }
+        break;
+    case JSON_PATH_WILDCARD:
+    case JSON_PATH_FILTER:
+        return json_path_evalItems(path, state, state + 1, node, callback, data);
+    case JSON_PATH_DESCENDANT:
+        if (!json_path_evalRecursive(path, state + 1, node, callback, data)) return false;
+        return json_path_evalItems(path, state, state, node, callback, data);
+    }
+    
+    if (child == NULL) return true;
+    return json_path_evalRecursive(path, state + 1, child, callback, data);
+}
+
+static bool json_path_collectFirst(const json_object * value, void * data) {
+    *(const json_object **)data = value;
+    return false;
+}
+
+static bool json_path_collectAll(const json_object * value, void * data) {
+    json_array_add((json_object*)data, json_object_reference((json_object*)value));
+    return true;
+}
+
+/* Returns the first value matched by the path, or NULL. */
+json_object * json_path_get(const json_path * path, const json_object * root) {
+    const json_object * result = NULL;
+    json_path_evalRecursive(path, 0, root, json_path_collectFirst, &result);
+    return (json_object*)result;
+}
+
+/* Returns an array of references to all values matched by the path. */
+json_object * json_path_query(const json_path * path, const json_object * root) {
+    json_object * results = json_array();
+    json_path_evalRecursive(path, 0, root, json_path_collectAll, results);
+    return results;
+}
+
+
+/* Streaming evaluation state. */
+typedef struct JSON_PATH_STATE {
+    int path; // index of the path
+    int step; // next step of the path
+} json_path_state;
+
+typedef struct JSON_PATH_STREAM {
+    json_path ** paths;
+    int pathCount;
+    int maxStates; // states of a node
+    json_path_state ** levels; // states of the children of the open containers
+    int levelCount, levelCapacity;
+    int depth; // open containers
+    json_duplicate_keys duplicates; // handling of duplicate keys of the projected maps
+    json_tokenizer tokenizer;
+    json_error * error;
+    json_object * results; // matched values (query), NULL when building a projection
+    json_object * placeholder; // shared value for skipped array items (projection)
+} json_path_stream;
+
+#define THROW_ERROR(errcode) { if (error) { error->code = errcode; error->line = tokenizer->line; error->pos = tokenizer->pos; } return false; }
+
+/* Adds a state to the set, including the states reachable without consuming a node. */
+static int json_path_addState(const json_path_stream * stream, json_path_state * states, int count, int path, int step) {
+    for (int i = 0; i < count; i++) {
+        if (states[i].path == path && states[i].step == step) return count;
+    }
+    states[count].path = path;
+    states[count].step = step;
+    count++;
+    
+    const json_path * p = stream->paths[path];
+    if (step < p->length && p->steps[step].type == JSON_PATH_DESCENDANT) {
+        count = json_path_addState(stream, states, count, path, step + 1);
+    }
+    return count;
+}
+
+/* Computes the states of a child node (identified either by the key or by the index). */
+static int json_path_childStates(const json_path_stream * stream, const json_path_state * states, int count, const char * key, int index, json_path_state * childStates) {
+    int childCount = 0;
+    for (int i = 0; i < count; i++) {
+        const json_path * path = stream->paths[states[i].path];
+        if (states[i].step == path->length) continue;
+        const json_path_step * step = &path->steps[states[i].step];
+        int next = -1;
+        
+        switch (step->type) {
+        case JSON_PATH_DESCENDANT:
+            next = states[i].step;
+            break;
+        case JSON_PATH_WILDCARD:
+            next = states[i].step + 1;
+            break;
+        case JSON_PATH_MEMBER:
+            if (key ? strcmp(step->key, key) == 0 : step->index == index) next = states[i].step + 1;
+            break;
+        case JSON_PATH_INDEX:
+            if (key == NULL && step->index == index) next = states[i].step + 1;
+            break;
+        default:
+            break;
+        }
+        if (next >= 0) childCount = json_path_addState(stream, childStates, childCount, states[i].path, next);
+    }
+    return childCount;
+}
+
+/* Checks whether the value is matched or needs the whole subtree (filters, indices from the end). */
+static bool json_path_needsTree(const json_path_stream * stream, const json_path_state * states, int count) {
+    for (int i = 0; i < count; i++) {
+        const json_path * path = stream->paths[states[i].path];
+        if (states[i].step == path->length) return true;
+        
+        const json_path_step * step = &path->steps[states[i].step];
+        if (step->type == JSON_PATH_FILTER || (step->type == JSON_PATH_INDEX && step->index < 0)) return true;
+    }
+    return false;
+}
+
+/* Collects the matches inside a subtree. */
+static void json_path_collectTree(json_path_stream * stream, const json_path_state * states, int count, const json_object * tree) {
+    for (int i = 0; i < count; i++) {
+        const json_path * path = stream->paths[states[i].path];
+        
+        // states following a descendant step are evaluated by the descendant step
+        if (states[i].step > 0 && path->steps[states[i].step - 1].type == JSON_PATH_DESCENDANT) {
+            bool covered = false;
+            for (int j = 0; j < count; j++) {
+                covered |= states[j].path == states[i].path && states[j].step == states[i].step - 1;
+            }
+            if (covered) continue;
+        }
+        json_path_evalRecursive(path, states[i].step, tree, json_path_collectAll, stream->results);
+    }
+}
+
+/* Skips a value, the current token is the first token of the value. */
+static bool json_path_skipValue(json_path_stream * stream) {
+    json_tokenizer * tokenizer = &stream->tokenizer;
+    json_error * error = stream->error;
+    
+    switch (tokenizer->token.type) {
+    case JSON_TOKEN_EOF:
+        THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+    case JSON_TOKEN_NULL:
+    case JSON_TOKEN_BOOL:
+    case JSON_TOKEN_INTEGER:
+    case JSON_TOKEN_FLOAT:
+    case JSON_TOKEN_STRING:
+        json_token_free(&tokenizer->token);
+        return true;
+    default:
+        json_token_free(&tokenizer->token);
+        THROW_ERROR(JSON_ERROR_UNRESOLVED_TOKEN);
+    }
+}
+
+static bool json_path_walkValue(json_path_stream * stream, const json_path_state * states, int count, json_object ** value);
+
+/* Returns the buffer for the states of the children of the innermost open container. */
+static json_path_state * json_path_levelStates(json_path_stream * stream) {
+    int level = stream->depth - 1;
+    if (level == stream->levelCount) {
+        if (stream->levelCount == stream->levelCapacity) {
+            stream->levelCapacity = stream->levelCapacity ? 2 * stream->levelCapacity : 16;
+            if (stream->levels == NULL) {
+                JSON_DEBUG_MALLOC;
+            }
+            stream->levels = realloc(stream->levels, sizeof(json_path_state*) * stream->levelCapacity);
+        }
+        JSON_DEBUG_MALLOC;
+        stream->levels[stream->levelCount++] = malloc(sizeof(json_path_state) * stream->maxStates);
+    }
+    return stream->levels[level];
+}
+
+/* Walks through the next value of a container, skipping it when no path can match. */
+static bool json_path_walkItem(json_path_stream * stream, const json_path_state * childStates, int childCount, json_object ** value) {
+    json_tokenizer * tokenizer = &stream->tokenizer;
+    json_error * error = stream->error;
+    
+    if (childCount == 0) {
+        *value = NULL;
+        if (!json_tokenizer_skip(tokenizer)) THROW_ERROR(tokenizer->error);
+        if (tokenizer->token.type != JSON_TOKEN_UNKNOWN) THROW_ERROR(JSON_ERROR_UNRESOLVED_TOKEN);
+        return true;
+    }
+    
+    if (!json_tokenizer_next(tokenizer)) THROW_ERROR(tokenizer->error);
+    return json_path_walkValue(stream, childStates, childCount, value);
+}
+
+/* Walks through the map, the current token is "{". */
+static bool json_path_walkMap(json_path_stream * stream, const json_path_state * states, int count, json_object * map) {
+    json_tokenizer * tokenizer = &stream->tokenizer;
+    json_error * error = stream->error;
+    json_path_state * childStates = json_path_levelStates(stream);
+    
+    for (bool first = true; ; first = false) {
+        // read the key
+        if (!json_tokenizer_next(tokenizer)) THROW_ERROR(tokenizer->error);
+        if (tokenizer->token.type == JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+        if (first && tokenizer->token.type == JSON_TOKEN_BRACE_CLOSING) return true; // empty map
+        if (tokenizer->token.type != JSON_TOKEN_STRING) {
+            json_token_free(&tokenizer->token);
+            THROW_ERROR(JSON_ERROR_EXPECTED_STRING);
+        }
+        char * key = json_token_hijack(&tokenizer->token);
+        int childCount = json_path_childStates(stream, states, count, key, -1, childStates);
+        
+        // read ":"
+        if (!json_tokenizer_next(tokenizer) || tokenizer->token.type != JSON_TOKEN_COLON) {
+            int code = tokenizer->error;
+            if (tokenizer->token.type == JSON_TOKEN_EOF) code = JSON_ERROR_UNEXPECTED_EOF;
+            else if (tokenizer->token.type != JSON_TOKEN_COLON) code = JSON_ERROR_EXPECTED_COLON;
+            json_token_free(&tokenizer->token);
+            free(key);
+            JSON_DEBUG_FREE;
+            THROW_ERROR(code);
+        }
+        
+        // read the value
+        json_object * value = NULL;
+        bool ok = json_path_walkItem(stream, childStates, childCount, &value);
+        json_object * oldValue = NULL;
+        if (ok && value != NULL && json_map_insert(map, key, strlen(key), json_map_hash(key), value, stream->duplicates, &oldValue)) {
+            if (oldValue != NULL) json_object_free(oldValue);
+        }
+        else {
+            // skipped or a rejected duplicate
+            if (value != NULL) json_object_free(value);
+            free(key);
+            JSON_DEBUG_FREE;
+            if (ok && value != NULL && stream->duplicates == JSON_DUPLICATE_ERROR) THROW_ERROR(JSON_ERROR_DUPLICATE_KEY);
+        }
+        if (!ok) return false;
+        
+        // read "," or "}"
+        if (!json_tokenizer_next(tokenizer)) THROW_ERROR(tokenizer->error);
+        if (tokenizer->token.type == JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+        if (tokenizer->token.type == JSON_TOKEN_BRACE_CLOSING) return true;
+        if (tokenizer->token.type != JSON_TOKEN_COMMA) {
+            json_token_free(&tokenizer->token);
+            THROW_ERROR(JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACE);
+        }
+    }
+}
+
+/* Walks through the array, the current token is "[". */
+static bool json_path_walkArray(json_path_stream * stream, const json_path_state * states, int count, json_object * array) {
+    json_tokenizer * tokenizer = &stream->tokenizer;
+    json_error * error = stream->error;
+    json_path_state * childStates = json_path_levelStates(stream);
+    
+    for (int index = 0; ; index++) {
+        // read the item
+        int childCount = json_path_childStates(stream, states, count, NULL, index, childStates);
+        json_object * item;
+        
+        if (childCount == 0) {
+            if (!json_tokenizer_skip(tokenizer)) THROW_ERROR(tokenizer->error);
+            if (index == 0 && tokenizer->token.type == JSON_TOKEN_BRACKET_CLOSING) return true; // empty array
+            if (tokenizer->token.type != JSON_TOKEN_UNKNOWN) THROW_ERROR(JSON_ERROR_UNRESOLVED_TOKEN);
+            item = NULL;
+        }
+        else {
+            if (!json_tokenizer_next(tokenizer)) THROW_ERROR(tokenizer->error);
+            if (index == 0 && tokenizer->token.type == JSON_TOKEN_BRACKET_CLOSING) return true; // empty array
+            if (!json_path_walkValue(stream, childStates, childCount, &item)) return false;
+        }
+        
+        if (array != NULL) {
+            // skipped items are replaced by a placeholder to keep the indices
+            if (item == NULL) {
+                if (stream->placeholder == NULL) stream->placeholder = json_null();
+                item = json_object_reference(stream->placeholder);
+            }
+            json_array_add(array, item);
+        }
+        
+        // read "," or "]"
+        if (!json_tokenizer_next(tokenizer)) THROW_ERROR(tokenizer->error);
+        if (tokenizer->token.type == JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+        if (tokenizer->token.type == JSON_TOKEN_BRACKET_CLOSING) return true;
+        if (tokenizer->token.type != JSON_TOKEN_COMMA) {
+            json_token_free(&tokenizer->token);
+            THROW_ERROR(JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET);
+        }
+    }
+}
+
+/* 
+ * Walks through a value, the current token is the first token of the value. Builds 
+ * the projection of the value, or collects the matches when evaluating a query.
+ */
+static bool json_path_walkValue(json_path_stream * stream, const json_path_state * states, int count, json_object ** value) {
+    *value = NULL;
+    
+    if (json_path_needsTree(stream, states, count)) {
+        json_object * tree = json_parse_value(&stream->tokenizer, stream->error);
+        if (tree == NULL) return false;
+        
+        if (stream->results == NULL) *value = tree;
+        else {
+            json_path_collectTree(stream, states, count, tree);
+            json_object_free(tree);
+        }
+        return true;
+    }
+    
+    json_object * container = NULL;
+    bool ok;
+    json_tokenType type = stream->tokenizer.token.type;
+    if (type != JSON_TOKEN_BRACE_OPENING && type != JSON_TOKEN_BRACKET_OPENING) return json_path_skipValue(stream);
+    
+    if (stream->depth == JSON_PATH_MAX_DEPTH) {
+        json_tokenizer * tokenizer = &stream->tokenizer;
+        json_error * error = stream->error;
+        THROW_ERROR(JSON_ERROR_TOO_DEEP);
+    }
+    stream->depth++;
+    if (type == JSON_TOKEN_BRACE_OPENING) {
+        if (stream->results == NULL) container = json_map();
+        ok = json_path_walkMap(stream, states, count, container);
+    }
+    else {
+        if (stream->results == NULL) container = json_array();
+        ok = json_path_walkArray(stream, states, count, container);
+    }
+    stream->depth--;
+    
+    if (!ok) {
+        if (container) json_object_free(container);
+        return false;
+    }
+    *value = container;
+    return true;
+}
+
+#undef THROW_ERROR
+
+/* Walks through the whole input. */
+static bool json_path_walk(json_path_stream * stream, json_reader reader, json_object ** value) {
+    json_error * error = stream->error;
+    json_tokenizer * tokenizer = &stream->tokenizer;
+    json_tokenizer_init(tokenizer, reader);
+    tokenizer->duplicateKeys = stream->duplicates; // for the subtrees built by the parser
+    stream->placeholder = NULL;
+    stream->levels = NULL;
+    stream->levelCount = stream->levelCapacity = 0;
+    stream->depth = 0;
+    
+    stream->maxStates = 0;
+    for (int i = 0; i < stream->pathCount; i++) stream->maxStates += stream->paths[i]->length + 1;
+    
+    JSON_DEBUG_MALLOC;
+    json_path_state * states = malloc(sizeof(json_path_state) * stream->maxStates);
+    int count = 0;
+    for (int i = 0; i < stream->pathCount; i++) count = json_path_addState(stream, states, count, i, 0);
+    
+    bool ok = json_tokenizer_next(tokenizer);
+    if (!ok && error) error->code = tokenizer->error;
+    ok = ok && json_path_walkValue(stream, states, count, value);
+    
+    // EOF wanted
+    if (ok && (!json_tokenizer_next(tokenizer) || tokenizer->token.type != JSON_TOKEN_EOF)) {
+        json_token_free(&tokenizer->token);
+        if (error) error->code = JSON_ERROR_GARBAGE;
+        if (*value) json_object_free(*value);
+        ok = false;
+    }
+    
+    if (!ok && error) {
+        error->line = tokenizer->line;
+        error->pos = tokenizer->pos;
+    }
+    if (stream->placeholder) json_object_free(stream->placeholder);
+    json_tokenizer_free(tokenizer);
+    for (int i = 0; i < stream->levelCount; i++) {
+        free(stream->levels[i]);
+        JSON_DEBUG_FREE;
+    }
+    if (stream->levels != NULL) {
+        free(stream->levels);
+        JSON_DEBUG_FREE;
+    }
+    free(states);
+    JSON_DEBUG_FREE;
+    return ok;
+}
+
+/* Evaluates the path against raw JSON input. */
+json_object * json_path_query_reader(const json_path * path, json_reader reader, json_error * error) {
+    json_path_stream stream;
+    json_path * paths[] = { (json_path*)path };
+    stream.paths = paths;
+    stream.pathCount = 1;
+    stream.duplicates = JSON_DUPLICATE_LAST;
+    stream.error = error;
+    stream.results = json_array();
+    
+    json_object * value;
+    if (!json_path_walk(&stream, reader, &value)) {
+        json_object_free(stream.results);
+        return NULL;
+    }
+    return stream.results;
+}
+
+/* Parses JSON, building only the parts of the tree selected by the paths. */
+json_object * json_parse_projected(json_reader reader, json_path ** paths, int count, json_error * error) {
+    return json_parse_projected_ext(reader, paths, count, JSON_DUPLICATE_LAST, error);
+}
+
+/* Parses JSON, building only the parts of the tree selected by the paths, with the given handling of duplicate keys. */
+json_object * json_parse_projected_ext(json_reader reader, json_path ** paths, int count, json_duplicate_keys duplicates, json_error * error) {
+    if (count <= 0) {
+        if (error) { error->code = JSON_ERROR_PATH_SYNTAX; error->line = 0; error->pos = 0; }
+        return NULL;
+    }
+    
+    json_path_stream stream;
+    stream.paths = paths;
+    stream.pathCount = count;
+    stream.duplicates = duplicates;
+    stream.error = error;
+    stream.results = NULL;
+    
+    json_object * value;
+    if (!json_path_walk(&stream, reader, &value)) return NULL;
+    return value ? value : json_null();
+}
@@ -0,0 +1,142 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_PATH_H
+#define	JSON_PATH_H
+
+#include <stdbool.h>
+
+#include "json_reader.h"
+#include "json_object.h"
+#include "json_error.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef JSON_PATH_MAX_DEPTH
+#define JSON_PATH_MAX_DEPTH 1024 // nesting limit of the streaming evaluation (it's recursive)
+#endif
+
+/* Path step type. */
+typedef enum JSON_PATH_STEP_TYPE {
+    JSON_PATH_MEMBER,       // map key, or array index if the key is numeric (.key, ['key'], /key)
+    JSON_PATH_INDEX,        // array index, negative values count from the end ([0], [-1])
+    JSON_PATH_WILDCARD,     // all items of a container (.*, [*])
+    JSON_PATH_DESCENDANT,   // the node and all its descendants (..)
+    JSON_PATH_FILTER        // items matching a condition ([?(@.key < 10)])
+} json_path_step_type;
+
+/* Filter operator. */
+typedef enum JSON_PATH_OPERATOR {
+    JSON_PATH_EXISTS,
+    JSON_PATH_EQ, JSON_PATH_NE,
+    JSON_PATH_LT, JSON_PATH_LE,
+    JSON_PATH_GT, JSON_PATH_GE
+} json_path_operator;
+
+struct JSON_PATH;
+
+/* Compiled path step. */
+typedef struct JSON_PATH_STEP {
+    json_path_step_type type;
+    
+    char * key; // map key (member)
+    unsigned hash; // precomputed hash of the key
+    int index; // array index (member, index), -1 for members which are not indices
+    
+    struct JSON_PATH * filterPath; // relative path of the filter operand
+    json_path_operator filterOperator;
+    json_object * filterValue; // literal to compare with
+} json_path_step;
+
+/* Compiled path. */
+typedef struct JSON_PATH {
+    json_path_step * steps;
+    int length;
+    int capacity;
+} json_path;
+
+
+/* 
+ * Compiles a path expression, either a JSON Pointer (RFC 6901, "/persons/0/name")
+ * or a JSONPath ("$.persons[*].name", "$..name", "$.persons[?(@.age > 30)]").
+ * 
+ * Returns NULL if the expression is invalid.
+ */
+extern json_path * json_path_compile(const char * expression, json_error * error);
+
+/* Frees the compiled path. */
+extern void json_path_free(json_path * path);
+
+
+/* Returns the first value matched by the path, or NULL. */
+extern json_object * json_path_get(const json_path * path, const json_object * root);
+
+/* Returns an array of references to all values matched by the path. */
+extern json_object * json_path_query(const json_path * path, const json_object * root);
+
+/* 
+ * Evaluates the path against raw JSON input. Only the matched values are built,
+ * the rest of the input is skipped (skipped values are checked only for matching
+ * quotes and brackets). Returns an array of matched values or NULL if the input
+ * is invalid.
+ */
+extern json_object * json_path_query_reader(const json_path * path, json_reader reader, json_error * error);
+
+/* Evaluates the path against a JSON string. */
+static inline json_object * json_path_query_string(const json_path * path, const char * string, json_error * error) {
+    return json_path_query_reader(path, json_reader_string(string), error);
+}
+
+
+/* 
+ * Parses JSON, building only the parts of the tree selected by the paths. Values which
+ * are not selected are skipped without being tokenized: map keys are left out and array
+ * items are replaced by a shared null value, so that the indices are preserved. At least
+ * one path is needed (JSON_ERROR_PATH_SYNTAX otherwise), containers nested deeper than
+ * JSON_PATH_MAX_DEPTH are reported as JSON_ERROR_TOO_DEEP.
+ */
+extern json_object * json_parse_projected(json_reader reader, json_path ** paths, int count, json_error * error);
+
+/* 
+ * Parses JSON like json_parse_projected with the given handling of duplicate keys
+ * (see json_duplicate_keys). The keys of skipped values aren't compared.
+ */
+extern json_object * json_parse_projected_ext(json_reader reader, json_path ** paths, int count, json_duplicate_keys duplicates, json_error * error);
+
+/* Parses a JSON string, building only the parts of the tree selected by the paths. */
+static inline json_object * json_parse_string_projected(const char * string, json_path ** paths, int count, json_error * error) {
+    return json_parse_projected(json_reader_string(string), paths, count, error);
+}
+
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* JSON_PATH_H */
@@ -25,10 +25,28 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef JSON_ZLIB
+#include <zlib.h>
+#endif
 
 #include "json_reader.h"
+#include "json_debug.h"
+#include "json_trace.h"
 
 static int json_reader_string_nextChar(void ** data) {
     return *(*(char**)data)++;
@@ -39,6 +57,23 @@ json_reader json_reader_string(const char * string) {
     json_reader reader;
     reader.data = (void*)string;
     reader.nextChar = json_reader_string_nextChar;
+    reader.window = NULL;
+    return reader;
+}
+
+static int json_reader_memory_nextChar(void ** data) {
+    (void)data;
+    return EOF; // the whole input is in the window
+}
+
+/* Creates a new reader of a memory block, the window is provided by the caller. */
+json_reader json_reader_memory(json_reader_window * window, const char * buffer, size_t length) {
+    window->position = buffer;
+    window->end = buffer + length;
+    json_reader reader;
+    reader.data = NULL;
+    reader.nextChar = json_reader_memory_nextChar;
+    reader.window = window;
     return reader;
 }
 
@@ -51,5 +86,175 @@ json_reader json_reader_stream(FILE * stream) {
     json_reader reader;
     reader.data = stream;
     reader.nextChar = json_reader_stream_nextChar;
+    reader.window = NULL;
     return reader;
 }
+
+
+/* State of a buffered reader. */
+typedef struct JSON_READER_BUFFER {
+    json_reader_window window; // the first field, the reader's window points here
+    json_read_callback read;
+    void (* close)(void * data); // frees the read data (optional)
+    void * readData;
+    bool end, failed;
+    size_t blockSize;
+    char block[];
+} json_reader_buffer;
+
+/* Returns the next character of the window, refills it with the next block if needed. */
+static int json_reader_buffered_nextChar(void ** data) {
+    json_reader_buffer * buffer = *data;
+    if (buffer->window.position < buffer->window.end) return (unsigned char)*buffer->window.position++;
+    if (buffer->end) return buffer->failed ? JSON_READER_ERROR : EOF;
+    
+    long length = buffer->read(buffer->readData, buffer->block, buffer->blockSize);
+    if (length <= 0) {
+        buffer->end = true;
+        buffer->failed = length < 0;
+        return buffer->failed ? JSON_READER_ERROR : EOF;
+    }
+    JSON_TRACE_POINT(JSON_TRACE_REFILL, length);
+    buffer->window.position = buffer->block + 1;
+    buffer->window.end = buffer->block + length;
+    return (unsigned char)buffer->block[0];
+}
+
+/* Creates a buffered reader, which frees the data of the callback with the close function. */
+static json_reader json_reader_bufferedExt(json_read_callback read, void (* close)(void * data), void * data, size_t blockSize) {
+    if (blockSize < 1) blockSize = JSON_READER_BLOCK_SIZE;
+    JSON_DEBUG_MALLOC;
+    json_reader_buffer * buffer = malloc(sizeof(json_reader_buffer) + blockSize);
+    buffer->window.position = buffer->window.end = buffer->block;
+    buffer->read = read;
+    buffer->close = close;
+    buffer->readData = data;
+    buffer->end = false;
+    buffer->failed = false;
+    buffer->blockSize = blockSize;
+    
+    json_reader reader;
+    reader.data = buffer;
+    reader.nextChar = json_reader_buffered_nextChar;
+    reader.window = &buffer->window;
+    return reader;
+}
+
+/* Creates a reader reading blocks from the callback. */
+json_reader json_reader_buffered(json_read_callback read, void * data, size_t blockSize) {
+    return json_reader_bufferedExt(read, NULL, data, blockSize);
+}
+
+static long json_reader_stream_read(void * data, char * buffer, size_t size) {
+    size_t length = fread(buffer, 1, size, (FILE*)data);
+    return length > 0 ? (long)length : (ferror((FILE*)data) ? -1 : 0);
+}
+
+/* Creates a reader reading blocks from the stream. */
+json_reader json_reader_stream_buf(FILE * stream, size_t blockSize) {
+    return json_reader_buffered(json_reader_stream_read, stream, blockSize);
+}
+
+static long json_reader_fd_read(void * data, char * buffer, size_t size) {
+    int fd = (int)(intptr_t)data;
+    for (;;) {
+#ifdef _WIN32
+        long length = _read(fd, buffer, (unsigned)size);
+#else
+        long length = read(fd, buffer, size);
+#endif
+        if (length >= 0 || errno != EINTR) return length;
+    }
+}
+
+/* Creates a reader reading blocks from the file descriptor. */
+json_reader json_reader_fd(int fd, size_t blockSize) {
+    return json_reader_buffered(json_reader_fd_read, (void*)(intptr_t)fd, blockSize);
+}
+
+/* Frees the buffer of a buffered reader. */
+void json_reader_free(json_reader * reader) {
+    if (reader->nextChar != json_reader_buffered_nextChar) return; // not buffered
+    json_reader_buffer * buffer = reader->data;
+    if (buffer->close) buffer->close(buffer->readData);
+    free(buffer);
+    JSON_DEBUG_FREE;
+    reader->data = NULL;
+    reader->window = NULL;
+}
+
+
+#ifdef JSON_ZLIB
+
+/* State of a decompressing reader. */
+typedef struct JSON_READER_ZLIB {
+    z_stream stream;
+    json_read_callback read; // reads the compressed input
+    void * readData;
+    bool end, finished;
+    size_t inputSize;
+    unsigned char input[];
+} json_reader_zlib;
+
+/* Decompresses the next block, reading the compressed input as needed. */
+static long json_reader_zlib_read(void * data, char * buffer, size_t size) {
+    json_reader_zlib * zlib = data;
+    if (zlib->finished) return 0;
+    
+    zlib->stream.next_out = (Bytef*)buffer;
+    zlib->stream.avail_out = (uInt)size;
+    while (zlib->stream.avail_out == size) { // until something is decompressed
+        if (zlib->stream.avail_in == 0 && !zlib->end) {
+            long length = zlib->read(zlib->readData, (char*)zlib->input, zlib->inputSize);
+            if (length < 0) return -1;
+            if (length == 0) zlib->end = true;
+            zlib->stream.next_in = zlib->input;
+            zlib->stream.avail_in = (uInt)length;
+        }
+        
+        int status = inflate(&zlib->stream, Z_NO_FLUSH);
+        if (status == Z_STREAM_END) {
+            if (zlib->stream.avail_in == 0 && zlib->end) {
+                zlib->finished = true;
+                break;
+            }
+            inflateReset(&zlib->stream); // another member of a concatenated file may follow
+        }
+        else if (status == Z_BUF_ERROR) {
+            if (zlib->end) { // truncated input, the parser reports the unexpected end
+                zlib->finished = true;
+                break;
+            }
+        }
+        else if (status != Z_OK) return -1;
+    }
+    return size - zlib->stream.avail_out;
+}
+
+static void json_reader_zlib_close(void * data) {
+    json_reader_zlib * zlib = data;
+    inflateEnd(&zlib->stream);
+    free(zlib);
+    JSON_DEBUG_FREE;
+}
+
+/* Creates a reader decompressing gzip (or zlib) input from the callback. */
+json_reader json_reader_gzip(json_read_callback read, void * data, size_t blockSize) {
+    if (blockSize < 1) blockSize = JSON_READER_BLOCK_SIZE;
+    JSON_DEBUG_MALLOC;
+    json_reader_zlib * zlib = malloc(sizeof(json_reader_zlib) + blockSize);
+    memset(&zlib->stream, 0, sizeof(z_stream));
+    zlib->read = read;
+    zlib->readData = data;
+    zlib->end = false;
+    zlib->finished = inflateInit2(&zlib->stream, 15 + 32) != Z_OK; // detect the gzip or zlib header
+    zlib->inputSize = blockSize;
+    return json_reader_bufferedExt(json_reader_zlib_read, json_reader_zlib_close, zlib, blockSize);
+}
+
+/* Creates a reader decompressing gzip (or zlib) input from the stream. */
+json_reader json_reader_gzip_stream(FILE * stream, size_t blockSize) {
+    return json_reader_gzip(json_reader_stream_read, stream, blockSize);
+}
+
+#endif
@@ -29,23 +29,85 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define	JSON_READER_H
 
 #include <stdio.h>
+#include <stddef.h>
 
 #ifdef	__cplusplus
 extern "C" {
 #endif
 
-/* Structure for a generic character reader. */
+/* Window of buffered characters, which weren't read yet. */
+typedef struct JSON_READER_WINDOW {
+    const char * position;
+    const char * end;
+} json_reader_window;
+
+/* 
+ * Structure for a generic character reader. Custom readers are created with
+ * JSON_READER_INIT, the window must be NULL unless nextChar refills it.
+ */
 typedef struct JSON_READER {
-    int (* nextChar)(void ** data); // reads the next character
+    int (* nextChar)(void ** data); // reads the next character (refills the window of buffered readers)
     void * data; // private data
+    json_reader_window * window; // buffered characters (NULL for unbuffered readers)
 } json_reader;
 
+/* Initializer of a custom (unbuffered) reader. */
+#define JSON_READER_INIT(nextChar, data) { (nextChar), (data), NULL }
+
+/* Returned by nextChar instead of a character if the input can't be read (JSON_ERROR_IO). */
+#define JSON_READER_ERROR (-2)
+
+/* Reads a block of input, returns the number of bytes read (0 at the end, negative on error, reported as JSON_ERROR_IO). */
+typedef long (* json_read_callback)(void * data, char * buffer, size_t size);
+
+#define JSON_READER_BLOCK_SIZE 65536
+
 /* Creates a new string reader. */
 extern json_reader json_reader_string(const char * string);
 
+/* 
+ * Creates a reader of a memory block of the given length, which doesn't have to
+ * be null-terminated. The window is provided by the caller (no allocation).
+ */
+extern json_reader json_reader_memory(json_reader_window * window, const char * buffer, size_t length);
+
 /* Creates a new stream reader. */
 extern json_reader json_reader_stream(FILE * stream);
 
+/* 
+ * Creates a reader reading blocks of the given size from the callback. The reader
+ * has to be freed with json_reader_free.
+ */
+extern json_reader json_reader_buffered(json_read_callback read, void * data, size_t blockSize);
+
+/* Creates a reader reading blocks from the stream with fread (see json_reader_buffered). */
+extern json_reader json_reader_stream_buf(FILE * stream, size_t blockSize);
+
+/* Creates a reader reading blocks from the file descriptor with read (see json_reader_buffered). */
+extern json_reader json_reader_fd(int fd, size_t blockSize);
+
+#ifdef JSON_ZLIB
+/* 
+ * Creates a reader decompressing gzip (or zlib) input read in blocks from the
+ * callback (see json_reader_buffered). Concatenated gzip members are read as one
+ * input. Available if the library is compiled with JSON_ZLIB.
+ */
+extern json_reader json_reader_gzip(json_read_callback read, void * data, size_t blockSize);
+
+/* Creates a reader decompressing gzip (or zlib) input from the stream (see json_reader_gzip). */
+extern json_reader json_reader_gzip_stream(FILE * stream, size_t blockSize);
+#endif
+
+/* Frees the buffer of a buffered reader (does nothing for other readers). */
+extern void json_reader_free(json_reader * reader);
+
+/* Reads the next character, directly from the window if there is one. */
+static inline int json_reader_next(json_reader * reader) {
+    json_reader_window * window = reader->window;
+    if (window != NULL && window->position < window->end) return (unsigned char)*window->position++;
+    return reader->nextChar(&reader->data);
+}
+
 
 #ifdef	__cplusplus
 }
@@ -0,0 +1,502 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "json_snapshot.h"
+#include "json_object.h"
+#include "json_binary.h"
+#include "json_debug.h"
+#include "json_error.h"
+
+/*
+ * Image layout (all fields are 32-bit words, nodes are 4-byte aligned):
+ * 
+ *   header:  magic, version, image size, root offset
+ *   scalar:  type, value
+ *   string:  type, length, characters (NUL-terminated, padded)
+ *   array:   type, size, item offsets[size]
+ *   map:     type, size, index size, index[index size], entries[size]
+ *            (entry = key hash, key offset, value offset)
+ * 
+ * Offsets of the children are relative to the parent node, keys are string nodes.
+ * The index is an open-addressing table of entry numbers (plus one, zero is empty).
+ * The root follows the header, the children follow their parent in order (a key
+ * right before its value), so the nodes cover the whole image without any gaps.
+ */
+
+#define JSON_SNAPSHOT_MAGIC 0x504e534a // "JSNP"
+#define JSON_SNAPSHOT_VERSION 1
+
+enum {
+    JSON_SNAPSHOT_HEADER_MAGIC = 0,
+    JSON_SNAPSHOT_HEADER_VERSION,
+    JSON_SNAPSHOT_HEADER_SIZE,
+    JSON_SNAPSHOT_HEADER_ROOT,
+    JSON_SNAPSHOT_HEADER_WORDS
+};
+
+struct JSON_SNAPSHOT {
+    const uint32_t * data;
+    size_t size;
+    void * mapping; // mmap-ed image
+    void * memory; // image read into memory
+};
+
+struct JSON_SNAPSHOT_VALUE {
+    uint32_t type;
+    uint32_t words[];
+};
+
+
+/* FNV-1a hash, independent of the hashing of json_map so the images stay valid. */
+static uint32_t json_snapshot_hash(const char * key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Appends zeroed words, returns the position of the first one. */
+static size_t json_snapshot_putWords(json_buffer * buffer, size_t count) {
+    size_t position = buffer->size;
+    memset(json_buffer_grow(buffer, count*4), 0, count*4);
+    return position;
+}
+
+static inline void json_snapshot_setWord(json_buffer * buffer, size_t position, uint32_t value) {
+    memcpy(buffer->data + position, &value, 4);
+}
+
+static inline uint32_t json_snapshot_getWord(json_buffer * buffer, size_t position) {
+    uint32_t value;
+    memcpy(&value, buffer->data + position, 4);
+    return value;
+}
+
+/* Writes a string node. */
+static size_t json_snapshot_putString(json_buffer * buffer, const char * string, size_t length) {
+    size_t position = json_snapshot_putWords(buffer, 2 + (length + 4) / 4);
+    json_snapshot_setWord(buffer, position, JSON_OBJECT_STRING);
+    json_snapshot_setWord(buffer, position + 4, length);
+    memcpy(buffer->data + position + 8, string, length);
+    return position;
+}
+
+/* Writes a node, returns its position. */
+static size_t json_snapshot_putRecursive(json_buffer * buffer, const json_object * obj) {
+    size_t position;
+    
+    switch (obj->type) {
+    case JSON_OBJECT_STRING:
+        return json_snapshot_putString(buffer, json_string_value(obj), json_string_length(obj));
+    case JSON_OBJECT_ARRAY:
+    {
+        int size = json_array_size(obj);
+        position = json_snapshot_putWords(buffer, 2 + size);
+        json_snapshot_setWord(buffer, position, JSON_OBJECT_ARRAY);
+        json_snapshot_setWord(buffer, position + 4, size);
+        for (int i = 0; i < size; i++) {
+            json_object scratch;
+            size_t item = json_snapshot_putRecursive(buffer, json_array_peek(obj, i, &scratch));
+            json_snapshot_setWord(buffer, position + 8 + 4*i, item - position);
+        }
+        return position;
+    }
+    case JSON_OBJECT_MAP:
+    {
+        int size = json_map_size(obj);
+        uint32_t indexSize = 4;
+        while (indexSize < 2*(uint32_t)size) indexSize *= 2;
+        
+        position = json_snapshot_putWords(buffer, 3 + indexSize + 3*size);
+        size_t index = position + 12;
+        size_t entries = index + 4*indexSize;
+        json_snapshot_setWord(buffer, position, JSON_OBJECT_MAP);
+        json_snapshot_setWord(buffer, position + 4, size);
+        json_snapshot_setWord(buffer, position + 8, indexSize);
+        
+        json_map_iterator iterator;
+        json_map_iterator_init(&iterator, obj);
+        for (int i = 0; json_map_iterator_next(&iterator); i++) {
+            size_t length = iterator.length;
+            uint32_t hash = json_snapshot_hash(iterator.key, length);
+            
+            // linear probing
+            uint32_t slot = hash & (indexSize - 1);
+            while (json_snapshot_getWord(buffer, index + 4*slot) != 0) slot = (slot + 1) & (indexSize - 1);
+            json_snapshot_setWord(buffer, index + 4*slot, i + 1);
+            
+            size_t key = json_snapshot_putString(buffer, iterator.key, length);
+            size_t value = json_snapshot_putRecursive(buffer, iterator.value);
+            json_snapshot_setWord(buffer, entries + 12*i, hash);
+            json_snapshot_setWord(buffer, entries + 12*i + 4, key - position);
+            json_snapshot_setWord(buffer, entries + 12*i + 8, value - position);
+        }
+        return position;
+    }
+    default:
+    {
+        uint32_t value = 0;
+        if (obj->type == JSON_OBJECT_INT) value = (uint32_t)json_int_value(obj);
+        else if (obj->type == JSON_OBJECT_BOOL) value = json_bool_value(obj);
+        else if (obj->type == JSON_OBJECT_FLOAT) {
+            float floatValue = json_float_value(obj);
+            memcpy(&value, &floatValue, 4);
+        }
+        position = json_snapshot_putWords(buffer, 2);
+        json_snapshot_setWord(buffer, position, obj->type);
+        json_snapshot_setWord(buffer, position + 4, value);
+        return position;
+    }
+    }
+}
+
+/* Encodes the tree as a snapshot image. */
+bool json_snapshot_encode(json_buffer * buffer, const json_object * obj) {
+    size_t start = buffer->size;
+    json_snapshot_putWords(buffer, JSON_SNAPSHOT_HEADER_WORDS);
+    size_t root = json_snapshot_putRecursive(buffer, obj) - start;
+    size_t size = buffer->size - start;
+    if (size > UINT32_MAX) {
+        buffer->size = start;
+        return false;
+    }
+    json_snapshot_setWord(buffer, start, JSON_SNAPSHOT_MAGIC);
+    json_snapshot_setWord(buffer, start + 4, JSON_SNAPSHOT_VERSION);
+    json_snapshot_setWord(buffer, start + 8, size);
+    json_snapshot_setWord(buffer, start + 12, root);
+    return true;
+}
+
+/* Reports an error. */
+static json_snapshot * json_snapshot_fail(json_error * error, int code) {
+    if (error) {
+        error->code = code;
+        error->line = 0;
+        error->pos = 0;
+    }
+    return NULL;
+}
+
+/* Writes the tree as a snapshot image into a file. */
+bool json_snapshot_write(const json_object * obj, const char * filename, json_error * error) {
+    json_buffer buffer;
+    json_buffer_init(&buffer);
+    bool ok = json_snapshot_encode(&buffer, obj);
+    if (!ok) json_snapshot_fail(error, JSON_ERROR_BINARY_DATA);
+    
+    if (ok) {
+        FILE * file = fopen(filename, "wb");
+        ok = file != NULL && fwrite(buffer.data, 1, buffer.size, file) == buffer.size;
+        if (file != NULL && fclose(file) != 0) ok = false;
+        if (!ok) json_snapshot_fail(error, JSON_ERROR_IO);
+    }
+    
+    json_buffer_free(&buffer);
+    return ok;
+}
+
+
+/* State of the image validation. */
+typedef struct JSON_SNAPSHOT_CHECK {
+    const uint32_t * data;
+    size_t words; // size of the image in words
+    int depth;
+    int error; // JSON_ERROR_BINARY_DATA or JSON_ERROR_TOO_DEEP
+} json_snapshot_check;
+
+/* 
+ * Checks the node at the given word and its children, returns the word after the node
+ * (0 for an invalid node). Every child has to start right after the previous one, so
+ * the nodes are checked once and all the offsets stay inside of the image.
+ */
+static size_t json_snapshot_checkNode(json_snapshot_check * check, size_t node) {
+    const uint32_t * data = check->data;
+    if (node > check->words - 2) return 0; // type and the first word
+    size_t available = check->words - node - 2;
+    uint32_t size = data[node + 1];
+    
+    switch (data[node]) {
+    case JSON_OBJECT_NULL:
+    case JSON_OBJECT_INT:
+    case JSON_OBJECT_BOOL:
+    case JSON_OBJECT_FLOAT:
+        return node + 2;
+    case JSON_OBJECT_STRING:
+        // padded with at least one NUL
+        if (size / 4 + 1 > available || ((const char*)&data[node + 2])[size] != '\0') return 0;
+        return node + 2 + size / 4 + 1;
+    case JSON_OBJECT_ARRAY:
+    case JSON_OBJECT_MAP:
+        break;
+    default:
+        return 0;
+    }
+    
+    if (++check->depth > JSON_BINARY_MAX_DEPTH) {
+        check->error = JSON_ERROR_TOO_DEEP;
+        return 0;
+    }
+    size_t end;
+    if (data[node] == JSON_OBJECT_ARRAY) {
+        if (size > available) return 0;
+        end = node + 2 + size;
+        for (uint32_t i = 0; i < size; i++) {
+            if (data[node + 2 + i] != 4*(end - node) || (end = json_snapshot_checkNode(check, end)) == 0) return 0;
+        }
+    }
+    else {
+        // the index needs an empty slot, so the probing ends
+        uint32_t indexSize = available > 0 ? data[node + 2] : 0;
+        if (indexSize <= size || (indexSize & (indexSize - 1)) != 0 || indexSize > available - 1
+                || size > (available - 1 - indexSize) / 3) {
+            return 0;
+        }
+        const uint32_t * index = &data[node + 3];
+        uint32_t used = 0;
+        for (uint32_t slot = 0; slot < indexSize; slot++) {
+            if (index[slot] > size) return 0;
+            if (index[slot] != 0) used++;
+        }
+        if (used != size) return 0;
+        
+        const uint32_t * entries = index + indexSize;
+        end = node + 3 + indexSize + 3*(size_t)size;
+        for (uint32_t i = 0; i < size; i++) {
+            if (entries[3*i + 1] != 4*(end - node) || end >= check->words || data[end] != JSON_OBJECT_STRING
+                    || (end = json_snapshot_checkNode(check, end)) == 0) {
+                return 0;
+            }
+            if (entries[3*i + 2] != 4*(end - node) || (end = json_snapshot_checkNode(check, end)) == 0) return 0;
+        }
+    }
+    check->depth--;
+    return end;
+}
+
+/* Creates the snapshot after checking the whole image. */
+static json_snapshot * json_snapshot_create(const void * data, size_t size, json_error * error) {
+    const uint32_t * header = data;
+    if (((uintptr_t)data & 3) != 0 || (size & 3) != 0 || size < 4*JSON_SNAPSHOT_HEADER_WORDS
+            || header[JSON_SNAPSHOT_HEADER_MAGIC] != JSON_SNAPSHOT_MAGIC
+            || header[JSON_SNAPSHOT_HEADER_VERSION] != JSON_SNAPSHOT_VERSION
+            || header[JSON_SNAPSHOT_HEADER_SIZE] != size
+            || header[JSON_SNAPSHOT_HEADER_ROOT] != 4*JSON_SNAPSHOT_HEADER_WORDS) {
+        return json_snapshot_fail(error, JSON_ERROR_BINARY_DATA);
+    }
+    
+    json_snapshot_check check = { data, size / 4, 0, JSON_ERROR_BINARY_DATA };
+    if (json_snapshot_checkNode(&check, JSON_SNAPSHOT_HEADER_WORDS) != check.words) {
+        return json_snapshot_fail(error, check.error);
+    }
+    
+    JSON_DEBUG_MALLOC;
+    json_snapshot * snapshot = malloc(sizeof(json_snapshot));
+    snapshot->data = data;
+    snapshot->size = size;
+    snapshot->mapping = NULL;
+    snapshot->memory = NULL;
+    return snapshot;
+}
+
+/* Opens a snapshot image in memory. */
+json_snapshot * json_snapshot_open_buffer(const void * data, size_t size, json_error * error) {
+    return json_snapshot_create(data, size, error);
+}
+
+/* Opens a snapshot file. */
+json_snapshot * json_snapshot_open(const char * filename, json_error * error) {
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return json_snapshot_fail(error, JSON_ERROR_IO);
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return json_snapshot_fail(error, JSON_ERROR_IO);
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        return json_snapshot_fail(error, JSON_ERROR_BINARY_DATA);
+    }
+    
+    void * mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return json_snapshot_fail(error, JSON_ERROR_IO);
+    
+    json_snapshot * snapshot = json_snapshot_create(mapping, info.st_size, error);
+    if (snapshot == NULL) munmap(mapping, info.st_size);
+    else snapshot->mapping = mapping;
+    return snapshot;
+#else
+    // no mmap, read the whole file
+    FILE * file = fopen(filename, "rb");
+    if (file == NULL) return json_snapshot_fail(error, JSON_ERROR_IO);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    JSON_DEBUG_MALLOC;
+    void * memory = malloc(size > 0 ? size : 1);
+    bool ok = size > 0 && fread(memory, 1, size, file) == (size_t)size;
+    fclose(file);
+    
+    json_snapshot * snapshot = ok ? json_snapshot_create(memory, size, error) : json_snapshot_fail(error, JSON_ERROR_IO);
+    if (snapshot == NULL) {
+        free(memory);
+        JSON_DEBUG_FREE;
+    }
+    else snapshot->memory = memory;
+    return snapshot;
+#endif
+}
+
+/* Closes the snapshot. */
+void json_snapshot_close(json_snapshot * snapshot) {
+#ifndef _WIN32
+    if (snapshot->mapping != NULL) munmap(snapshot->mapping, snapshot->size);
+#endif
+    if (snapshot->memory != NULL) {
+        free(snapshot->memory);
+        JSON_DEBUG_FREE;
+    }
+    free(snapshot);
+    JSON_DEBUG_FREE;
+}
+
+/* Returns the root value. */
+const json_snapshot_value * json_snapshot_root(const json_snapshot * snapshot) {
+    return (const json_snapshot_value*)((const char*)snapshot->data + snapshot->data[JSON_SNAPSHOT_HEADER_ROOT]);
+}
+
+
+/* Returns the child at the relative offset. */
+static inline const json_snapshot_value * json_snapshot_child(const json_snapshot_value * parent, uint32_t offset) {
+    return (const json_snapshot_value*)((const char*)parent + offset);
+}
+
+/* Returns the type of the value. */
+json_object_type json_snapshot_type(const json_snapshot_value * value) {
+    return (json_object_type)value->type;
+}
+
+/* Returns the integer value. */
+int json_snapshot_int_value(const json_snapshot_value * value) {
+    return (int)value->words[0];
+}
+
+/* Returns the boolean value. */
+bool json_snapshot_bool_value(const json_snapshot_value * value) {
+    return value->words[0] != 0;
+}
+
+/* Returns the float value. */
+float json_snapshot_float_value(const json_snapshot_value * value) {
+    float floatValue;
+    memcpy(&floatValue, &value->words[0], 4);
+    return floatValue;
+}
+
+/* Returns the string value. */
+const char * json_snapshot_string_value(const json_snapshot_value * value) {
+    return (const char*)&value->words[1];
+}
+
+/* Returns the length of the string. */
+int json_snapshot_string_length(const json_snapshot_value * value) {
+    return value->words[0];
+}
+
+
+/* Returns the size of the array. */
+int json_snapshot_array_size(const json_snapshot_value * array) {
+    return array->words[0];
+}
+
+/* Returns an item of the array. */
+const json_snapshot_value * json_snapshot_array_get(const json_snapshot_value * array, int index) {
+    if (index < 0 || (uint32_t)index >= array->words[0]) return NULL;
+    return json_snapshot_child(array, array->words[1 + index]);
+}
+
+
+/* Returns number of items in the map. */
+int json_snapshot_map_size(const json_snapshot_value * map) {
+    return map->words[0];
+}
+
+/* Returns the entries of the map. */
+static inline const uint32_t * json_snapshot_entries(const json_snapshot_value * map) {
+    return &map->words[2 + map->words[1]];
+}
+
+/* Finds a value in the map. */
+const json_snapshot_value * json_snapshot_map_get(const json_snapshot_value * map, const char * key) {
+    size_t length = strlen(key);
+    uint32_t hash = json_snapshot_hash(key, length);
+    uint32_t indexSize = map->words[1];
+    const uint32_t * index = &map->words[2];
+    const uint32_t * entries = json_snapshot_entries(map);
+    
+    for (uint32_t slot = hash & (indexSize - 1); index[slot] != 0; slot = (slot + 1) & (indexSize - 1)) {
+        const uint32_t * entry = entries + 3*(index[slot] - 1);
+        if (entry[0] != hash) continue;
+        const json_snapshot_value * entryKey = json_snapshot_child(map, entry[1]);
+        if (entryKey->words[0] == length && memcmp(json_snapshot_string_value(entryKey), key, length) == 0) {
+            return json_snapshot_child(map, entry[2]);
+        }
+    }
+    return NULL;
+}
+
+/* Returns the key of the n-th item of the map. */
+const char * json_snapshot_map_key(const json_snapshot_value * map, int index) {
+    if (index < 0 || (uint32_t)index >= map->words[0]) return NULL;
+    return json_snapshot_string_value(json_snapshot_child(map, json_snapshot_entries(map)[3*index + 1]));
+}
+
+/* Returns the value of the n-th item of the map. */
+const json_snapshot_value * json_snapshot_map_value(const json_snapshot_value * map, int index) {
+    if (index < 0 || (uint32_t)index >= map->words[0]) return NULL;
+    return json_snapshot_child(map, json_snapshot_entries(map)[3*index + 2]);
+}
@@ -0,0 +1,129 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_SNAPSHOT_H
+#define	JSON_SNAPSHOT_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "json_object.h"
+#include "json_binary.h"
+#include "json_error.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Snapshots are position-independent images of a parsed tree. All references are
+ * relative offsets and every map carries a prebuilt hash index, so an image can be
+ * mapped into memory and queried in place, without building any objects. Images use
+ * the byte order of the machine that wrote them.
+ * 
+ * The whole image is validated when it's opened (one pass over it, all the offsets
+ * have to point inside of it), so the accessors never read outside of the image.
+ * Nesting deeper than JSON_BINARY_MAX_DEPTH is reported as JSON_ERROR_TOO_DEEP.
+ * 
+ * The values are not json_objects: a json_object holds pointers to its items and
+ * hashtable and a reference count, none of which can be stored in a read-only,
+ * position-independent image. So the values have their own accessors, named after
+ * the tree accessors, which read the image directly (json_binary_decode builds
+ * a tree instead). Like the tree accessors, they expect a value of the right type.
+ */
+
+/* Opened snapshot. */
+typedef struct JSON_SNAPSHOT json_snapshot;
+
+/* Value inside of a snapshot (points directly into the image). */
+typedef struct JSON_SNAPSHOT_VALUE json_snapshot_value;
+
+
+/* Encodes the tree as a snapshot image. Returns false if the image would exceed 4 GB. */
+extern bool json_snapshot_encode(json_buffer * buffer, const json_object * obj);
+
+/* Writes the tree as a snapshot image into a file. */
+extern bool json_snapshot_write(const json_object * obj, const char * filename, json_error * error);
+
+
+/* Opens a snapshot file (the file is memory-mapped where possible). */
+extern json_snapshot * json_snapshot_open(const char * filename, json_error * error);
+
+/* Opens a snapshot image in memory (4-byte aligned), the data is not copied. */
+extern json_snapshot * json_snapshot_open_buffer(const void * data, size_t size, json_error * error);
+
+/* Closes the snapshot, all its values become invalid. */
+extern void json_snapshot_close(json_snapshot * snapshot);
+
+/* Returns the root value. */
+extern const json_snapshot_value * json_snapshot_root(const json_snapshot * snapshot);
+
+
+/* Returns the type of the value. */
+extern json_object_type json_snapshot_type(const json_snapshot_value * value);
+
+/* Returns the integer value. */
+extern int json_snapshot_int_value(const json_snapshot_value * value);
+
+/* Returns the boolean value. */
+extern bool json_snapshot_bool_value(const json_snapshot_value * value);
+
+/* Returns the float value. */
+extern float json_snapshot_float_value(const json_snapshot_value * value);
+
+/* Returns the string value. */
+extern const char * json_snapshot_string_value(const json_snapshot_value * value);
+
+/* Returns the length of the string. */
+extern int json_snapshot_string_length(const json_snapshot_value * value);
+
+
+/* Returns the size of the array. */
+extern int json_snapshot_array_size(const json_snapshot_value * array);
+
+/* Returns an item of the array. */
+extern const json_snapshot_value * json_snapshot_array_get(const json_snapshot_value * array, int index);
+
+
+/* Returns number of items in the map. */
+extern int json_snapshot_map_size(const json_snapshot_value * map);
+
+/* Finds a value in the map. */
+extern const json_snapshot_value * json_snapshot_map_get(const json_snapshot_value * map, const char * key);
+
+/* Returns the key of the n-th item of the map (items keep the order of the source map iterator). */
+extern const char * json_snapshot_map_key(const json_snapshot_value * map, int index);
+
+/* Returns the value of the n-th item of the map. */
+extern const json_snapshot_value * json_snapshot_map_value(const json_snapshot_value * map, int index);
+
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* JSON_SNAPSHOT_H */
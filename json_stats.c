@@ -0,0 +1,103 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "json_stats.h"
+#include "json_atomic.h"
+
+#define JSON_STATS_FIELDS (sizeof(json_stats) / sizeof(unsigned long long))
+
+
+bool json_stats_enabled = false;
+JSON_THREAD_LOCAL json_stats * json_stats_current = NULL;
+
+static unsigned long long json_stats_counters[JSON_STATS_FIELDS];
+
+
+/* Enables or disables the global counters. */
+void json_stats_enable(bool enable) {
+    JSON_ATOMIC_STORE(&json_stats_enabled, enable);
+}
+
+/* Reads the global counters. */
+void json_stats_global(json_stats * stats) {
+    unsigned long long values[JSON_STATS_FIELDS];
+    for (size_t i = 0; i < JSON_STATS_FIELDS; i++) values[i] = JSON_ATOMIC_LOAD(&json_stats_counters[i]);
+    memcpy(stats, values, sizeof(json_stats));
+}
+
+/* Resets the global counters. */
+void json_stats_reset(void) {
+    for (size_t i = 0; i < JSON_STATS_FIELDS; i++) JSON_ATOMIC_STORE(&json_stats_counters[i], 0);
+}
+
+/* Starts collecting the statistics on the current thread. */
+void json_stats_begin(json_stats * stats) {
+    memset(stats, 0, sizeof(json_stats));
+    json_stats_current = stats;
+}
+
+/* Stops collecting the statistics on the current thread. */
+void json_stats_end(void) {
+    json_stats_current = NULL;
+}
+
+/* Adds to a counter (the field is an offset in json_stats). */
+void json_stats_add(size_t field, unsigned long long value) {
+    size_t index = field / sizeof(unsigned long long);
+    if (JSON_ATOMIC_LOAD(&json_stats_enabled)) JSON_ATOMIC_ADD(&json_stats_counters[index], value);
+    if (json_stats_current != NULL) ((unsigned long long*)json_stats_current)[index] += value;
+}
+
+/* Updates a maximum (the field is an offset in json_stats). */
+void json_stats_max(size_t field, unsigned long long value) {
+    size_t index = field / sizeof(unsigned long long);
+    if (JSON_ATOMIC_LOAD(&json_stats_enabled)) {
+        unsigned long long current = JSON_ATOMIC_LOAD(&json_stats_counters[index]);
+        while (value > current && !JSON_ATOMIC_CAS(&json_stats_counters[index], &current, value));
+    }
+    if (json_stats_current != NULL) {
+        unsigned long long * current = &((unsigned long long*)json_stats_current)[index];
+        if (value > *current) *current = value;
+    }
+}
+
+/* Returns a monotonic timestamp in nanoseconds. */
+unsigned long long json_stats_now(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (unsigned long long)time.tv_sec * 1000000000ull + time.tv_nsec;
+#else
+    return (unsigned long long)clock() * (1000000000ull / CLOCKS_PER_SEC);
+#endif
+}
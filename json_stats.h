@@ -0,0 +1,119 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_STATS_H
+#define	JSON_STATS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "json_trace.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* 
+ * Library statistics. Collecting is opt-in: json_stats_enable turns on the global
+ * (atomic) counters, json_stats_begin/json_stats_end collect the statistics of the
+ * calls in between on the current thread. Define JSON_NO_STATS to compile it out.
+ */
+typedef struct JSON_STATS {
+    unsigned long long parses; // parse calls
+    unsigned long long bytes; // parsed input bytes
+    unsigned long long nanoseconds; // time spent parsing
+    
+    unsigned long long nodes, nodeBytes; // json_objects
+    unsigned long long strings, stringBytes; // string values and map keys
+    unsigned long long buckets, bucketBytes; // hashtables and their items
+    unsigned long long arrays, arrayBytes; // array storage (including reallocations)
+    
+    unsigned long long rehashes; // hashtable expansions
+    unsigned long long maxChainLength; // longest hashtable chain
+    unsigned long long maxDepth; // deepest nesting of the parsed containers
+    unsigned long long maxContainerSize; // largest parsed container
+} json_stats;
+
+
+/* Enables or disables the global counters (disabled by default). */
+extern void json_stats_enable(bool enable);
+
+/* Reads the global counters. */
+extern void json_stats_global(json_stats * stats);
+
+/* Resets the global counters. */
+extern void json_stats_reset(void);
+
+/* Starts collecting the statistics of the following calls on the current thread. */
+extern void json_stats_begin(json_stats * stats);
+
+/* Stops collecting the statistics on the current thread. */
+extern void json_stats_end(void);
+
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define JSON_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define JSON_THREAD_LOCAL __declspec(thread)
+#else
+#define JSON_THREAD_LOCAL __thread
+#endif
+
+#ifndef JSON_NO_STATS
+extern bool json_stats_enabled; // toggled by other threads, read with JSON_STATS_ENABLED
+extern JSON_THREAD_LOCAL json_stats * json_stats_current;
+
+#if defined(__GNUC__)
+#define JSON_STATS_ENABLED __atomic_load_n(&json_stats_enabled, __ATOMIC_RELAXED)
+#else
+#define JSON_STATS_ENABLED json_stats_enabled
+#endif
+
+extern void json_stats_add(size_t field, unsigned long long value);
+extern void json_stats_max(size_t field, unsigned long long value);
+extern unsigned long long json_stats_now(void);
+
+#define JSON_STATS_ACTIVE (JSON_STATS_ENABLED || json_stats_current != NULL)
+#define JSON_STATS_ADD(field, value) { if (JSON_STATS_ACTIVE) json_stats_add(offsetof(json_stats, field), (value)); }
+#define JSON_STATS_MAX(field, value) { if (JSON_STATS_ACTIVE) json_stats_max(offsetof(json_stats, field), (value)); }
+// allocations are trace points as well
+#define JSON_STATS_ALLOC(category, size) { JSON_TRACE_POINT(JSON_TRACE_ALLOC, size); if (JSON_STATS_ACTIVE) { \
+    json_stats_add(offsetof(json_stats, category##s), 1); \
+    json_stats_add(offsetof(json_stats, category##Bytes), (size)); } }
+#else
+#define JSON_STATS_ACTIVE false
+#define JSON_STATS_ADD(field, value)
+#define JSON_STATS_MAX(field, value)
+#define JSON_STATS_ALLOC(category, size) JSON_TRACE_POINT(JSON_TRACE_ALLOC, size)
+#endif
+
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* JSON_STATS_H */
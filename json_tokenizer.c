@@ -33,8 +33,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "json_tokenizer.h"
 #include "json_debug.h"
 #include "json_error.h"
+#include "json_stats.h"
 
-#define JSON_STRING_CAPACITY 8
+#define JSON_SCRATCH_CAPACITY 64
 
 
 // token states
@@ -49,46 +50,85 @@ enum {
     JSON_NUMERIC_EXP = 6, JSON_NUMERIC_EXP_SIGN = 7, JSON_NUMERIC_EXP_VALUE = 8
 };
 
+/* Literals (the only valid symbols), matched in place without any allocation. */
 enum {
-    JSON_SYMBOL_FIRST_CHAR = 1, JSON_SYMBOL_NEXT_CHAR = 2
+    JSON_LITERAL_TRUE = 0, JSON_LITERAL_FALSE, JSON_LITERAL_NULL
 };
 
-/* Initializes memory for a token containing character string */
-static void json_token_string_init(json_token * token) {
-    JSON_DEBUG_MALLOC;
-    token->data.string.data = malloc(sizeof(char) * JSON_STRING_CAPACITY);
-    token->data.string.length = 0;
-    token->data.string.data[0] = '\0';
-    token->data.string.capacity = JSON_STRING_CAPACITY;
-}
+static const char * const json_literals[] = { "true", "false", "null" };
+static const int json_literalLengths[] = { 4, 5, 4 };
 
-/* Appends a character to the token's string. */
-static void json_token_string_append(json_token * token, char c) {
-    if (token->data.string.length + 1 == token->data.string.capacity) {
-        token->data.string.capacity *= 2;
-        token->data.string.data = realloc(token->data.string.data, sizeof(char) * token->data.string.capacity);
+// the status of a symbol token is the literal and the number of matched characters
+#define JSON_LITERAL_STATUS(literal, matched) ((literal) << 4 | (matched))
+#define JSON_LITERAL_MISMATCH 15 // not a literal
+#define JSON_LITERAL(status) ((status) >> 4)
+#define JSON_LITERAL_MATCHED(status) ((status) & 15)
+
+/* Enlarges the scratch buffer, which holds the text of the current token. */
+static void json_tokenizer_growScratch(json_tokenizer * tokenizer) {
+    int capacity = tokenizer->scratchCapacity ? 2 * tokenizer->scratchCapacity : JSON_SCRATCH_CAPACITY;
+    if (tokenizer->scratch == NULL) {
+        JSON_DEBUG_MALLOC;
     }
+    JSON_STATS_ALLOC(string, capacity);
+    tokenizer->scratch = realloc(tokenizer->scratch, sizeof(char) * capacity);
+    tokenizer->scratchCapacity = capacity;
+    tokenizer->_currentToken.data.string.data = tokenizer->scratch;
+    tokenizer->_currentToken.data.string.capacity = capacity;
+}
+
+/* Starts the text of the current token (string or number) in the scratch buffer. */
+static inline void json_tokenizer_startText(json_tokenizer * tokenizer) {
+    if (tokenizer->scratch == NULL) json_tokenizer_growScratch(tokenizer);
+    tokenizer->_currentToken.data.string.data = tokenizer->scratch;
+    tokenizer->_currentToken.data.string.length = 0;
+    tokenizer->_currentToken.data.string.capacity = tokenizer->scratchCapacity;
+}
+
+/* Appends a character to the text of the current token. */
+static inline void json_tokenizer_append(json_tokenizer * tokenizer, char c) {
+    json_token * token = &tokenizer->_currentToken;
+    if (token->data.string.length + 1 >= tokenizer->scratchCapacity) json_tokenizer_growScratch(tokenizer);
     token->data.string.data[token->data.string.length++] = c;
-    token->data.string.data[token->data.string.length] = '\0';
 }
 
-/* Frees the token's string. */
-static inline void json_token_string_free(json_token * token) {
-    free(token->data.string.data);
-    JSON_DEBUG_FREE;
+/* Appends the characters of a string up to a quote, backslash or control character directly from the window. */
+static inline void json_tokenizer_appendRun(json_tokenizer * tokenizer) {
+    json_reader_window * window = tokenizer->reader.window;
+    const char * p = window->position;
+    while (p < window->end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20) p++;
+    int length = (int)(p - window->position);
+    if (length == 0) return;
+    
+    json_token * token = &tokenizer->_currentToken;
+    while (token->data.string.length + length + 1 >= tokenizer->scratchCapacity) json_tokenizer_growScratch(tokenizer);
+    memcpy(token->data.string.data + token->data.string.length, window->position, length);
+    token->data.string.length += length;
+    window->position = p;
+    tokenizer->pos += length;
+    tokenizer->bytes += length;
+}
+
+/* Terminates the text of the current token (there's always room for the terminator). */
+static inline void json_tokenizer_finishText(json_tokenizer * tokenizer) {
+    tokenizer->_currentToken.data.string.data[tokenizer->_currentToken.data.string.length] = '\0';
 }
 
-/* Returns the pointer to the token's string. The memory won't be freed when json_token_free() is called. */
+/* Returns a copy of the token's string (allocated with the exact size). */
 char * json_token_hijack(json_token * token) {
-    char * ptr = token->data.string.data;
+    int length = token->data.string.length;
+    JSON_DEBUG_MALLOC;
+    JSON_STATS_ALLOC(string, length + 1);
+    char * string = malloc(sizeof(char) * (length + 1));
+    memcpy(string, token->data.string.data, length + 1);
     token->data.string.data = NULL;
-    return ptr;
+    return string;
 }
 
-/* Frees the token internal memory (string). */
+/* Releases the token's string (it's owned by the tokenizer). */
 void json_token_free(json_token * token) {
     if (token->type == JSON_TOKEN_STRING || token->type == JSON_TOKEN_SYMBOL) {
-        if (token->data.string.data != NULL) json_token_string_free(token);
+        token->data.string.data = NULL;
     }
 }
 
@@ -111,42 +151,34 @@ static bool json_tokenizer_finishNumeric(json_tokenizer * tokenizer) {
     bool validNumber = true;
     if (tokenizer->_currentTokenStatus == JSON_NUMERIC_SIGN || tokenizer->_currentTokenStatus == JSON_NUMERIC_POINT || tokenizer->_currentTokenStatus == JSON_NUMERIC_EXP || tokenizer->_currentTokenStatus == JSON_NUMERIC_EXP_SIGN) validNumber = false;
     if (validNumber) {
-        if (tokenizer->_currentTokenStatus < JSON_NUMERIC_POINT) {
+        json_tokenizer_finishText(tokenizer);
+        if (tokenizer->raw) { // the text is kept
+            tokenizer->_currentToken.type = tokenizer->_currentTokenStatus < JSON_NUMERIC_POINT ? JSON_TOKEN_INTEGER : JSON_TOKEN_FLOAT;
+        }
+        else if (tokenizer->_currentTokenStatus < JSON_NUMERIC_POINT) {
             tokenizer->_currentToken.type = JSON_TOKEN_INTEGER;
-            int value = atoi(tokenizer->_currentToken.data.string.data);
-            json_token_string_free(&tokenizer->_currentToken);
-            tokenizer->_currentToken.data.intValue = value;
+            tokenizer->_currentToken.data.intValue = atoi(tokenizer->scratch);
         }
         else {
             tokenizer->_currentToken.type = JSON_TOKEN_FLOAT;
-            float value = (float)atof(tokenizer->_currentToken.data.string.data);
-            json_token_string_free(&tokenizer->_currentToken);
-            tokenizer->_currentToken.data.floatValue = value;
+            tokenizer->_currentToken.data.floatValue = (float)atof(tokenizer->scratch);
         }
     }
-    else {
-        json_token_string_free(&tokenizer->_currentToken);
-    }
     return validNumber;
 }
 
-/* Finishes a symbol token. */
+/* Finishes a symbol token, other symbols than literals are left unresolved (without the text). */
 static bool json_tokenizer_finishSymbol(json_tokenizer * tokenizer) {
-    if (strcmp(tokenizer->_currentToken.data.string.data, "true") == 0) {
-        tokenizer->_currentToken.type = JSON_TOKEN_BOOL;
-        json_token_string_free(&tokenizer->_currentToken);
-        tokenizer->_currentToken.data.boolValue = true;
+    int literal = JSON_LITERAL(tokenizer->_currentTokenStatus);
+    if (JSON_LITERAL_MATCHED(tokenizer->_currentTokenStatus) != json_literalLengths[literal]) return true;
+    
+    if (literal == JSON_LITERAL_NULL) {
+        tokenizer->_currentToken.type = JSON_TOKEN_NULL;
     }
-    else if (strcmp(tokenizer->_currentToken.data.string.data, "false") == 0) {
+    else {
         tokenizer->_currentToken.type = JSON_TOKEN_BOOL;
-        json_token_string_free(&tokenizer->_currentToken);
-        tokenizer->_currentToken.data.boolValue = false;
-    }
-    else if (strcmp(tokenizer->_currentToken.data.string.data, "null") == 0) {
-        tokenizer->_currentToken.type = JSON_TOKEN_NULL;
-        json_token_string_free(&tokenizer->_currentToken);
+        tokenizer->_currentToken.data.boolValue = (literal == JSON_LITERAL_TRUE);
     }
-    // @todo nepovolit ostatní symboly
     return true;
 }
 
@@ -160,12 +192,41 @@ static inline void json_resetTokenizerStatus(json_tokenizer * tokenizer) {
 void json_tokenizer_init(json_tokenizer * tokenizer, json_reader reader) {
     tokenizer->line = 1;
     tokenizer->pos = 0;
+    tokenizer->bytes = 0;
     
     tokenizer->reader = reader;
     
+    tokenizer->sizeHints = NULL;
+    tokenizer->sizeHintCount = 0;
+    tokenizer->duplicateKeys = 0; // JSON_DUPLICATE_LAST
+    tokenizer->_sizeHintPosition = 0;
+    tokenizer->_depth = 0;
+    
+    tokenizer->raw = false;
+    tokenizer->scratch = NULL;
+    tokenizer->scratchCapacity = 0;
+    
     json_resetTokenizerStatus(tokenizer);
 }
 
+/* Prepares the tokenizer for another input, keeping its scratch buffer. */
+void json_tokenizer_reset(json_tokenizer * tokenizer, json_reader reader) {
+    char * scratch = tokenizer->scratch;
+    int scratchCapacity = tokenizer->scratchCapacity;
+    json_tokenizer_init(tokenizer, reader);
+    tokenizer->scratch = scratch;
+    tokenizer->scratchCapacity = scratchCapacity;
+}
+
+/* Frees the tokenizer's scratch buffer. */
+void json_tokenizer_free(json_tokenizer * tokenizer) {
+    if (tokenizer->scratch == NULL) return;
+    free(tokenizer->scratch);
+    JSON_DEBUG_FREE;
+    tokenizer->scratch = NULL;
+    tokenizer->scratchCapacity = 0;
+}
+
 
 // some helper functions
 
@@ -189,6 +250,46 @@ static inline int json_tokenizer_processString(json_tokenizer * tokenizer, int c
 
 #define THROW_ERROR(code) { tokenizer->error = code; return false; }
 
+/* Compares the rest of a just started literal directly with the reader's window. */
+static inline void json_tokenizer_matchLiteral(json_tokenizer * tokenizer) {
+    int literal = JSON_LITERAL(tokenizer->_currentTokenStatus);
+    int rest = json_literalLengths[literal] - 1;
+    json_reader_window * window = tokenizer->reader.window;
+    if (window != NULL && window->end - window->position >= rest && memcmp(window->position, json_literals[literal] + 1, rest) == 0) {
+        window->position += rest;
+        tokenizer->pos += rest;
+        tokenizer->bytes += rest;
+        tokenizer->_currentTokenStatus = JSON_LITERAL_STATUS(literal, 1 + rest);
+    }
+}
+
+/* 
+ * Starts a literal. If the previous token was just emitted, the window is compared
+ * in the next call, so that the position of the emitted token isn't moved.
+ */
+static inline void json_tokenizer_startLiteral(json_tokenizer * tokenizer, int c) {
+    int literal = JSON_LITERAL_TRUE;
+    int matched = 1;
+    if (c == 'f') literal = JSON_LITERAL_FALSE;
+    else if (c == 'n') literal = JSON_LITERAL_NULL;
+    else if (c != 't') matched = JSON_LITERAL_MISMATCH;
+    
+    tokenizer->_currentToken.type = JSON_TOKEN_SYMBOL;
+    tokenizer->_currentToken.data.string.data = NULL;
+    tokenizer->_currentTokenStatus = JSON_LITERAL_STATUS(literal, matched);
+    if (matched == 1 && tokenizer->_notEmitted) json_tokenizer_matchLiteral(tokenizer);
+}
+
+/* Matches the next character of a literal. */
+static inline void json_tokenizer_processLiteral(json_tokenizer * tokenizer, int c) {
+    int literal = JSON_LITERAL(tokenizer->_currentTokenStatus);
+    int matched = JSON_LITERAL_MATCHED(tokenizer->_currentTokenStatus);
+    if (matched == JSON_LITERAL_MISMATCH) return;
+    if (matched == json_literalLengths[literal] || json_literals[literal][matched] != c) matched = JSON_LITERAL_MISMATCH;
+    else matched++;
+    tokenizer->_currentTokenStatus = JSON_LITERAL_STATUS(literal, matched);
+}
+
 /* Emit the previous token. */
 #define EMIT_PREVIOUS_TOKEN \
 if (tokenizer->_currentToken.type != JSON_TOKEN_UNKNOWN) { \
@@ -198,243 +299,330 @@ if (tokenizer->_currentToken.type != JSON_TOKEN_UNKNOWN) { \
     tokenizer->_notEmitted = false; \
 }
 
+/* Processes a character. */
+static inline bool json_tokenizer_processChar(json_tokenizer * tokenizer, int c) {
+    if (tokenizer->_currentToken.type != JSON_TOKEN_STRING) {
+        switch (c) {
+        // EOF
+        case JSON_READER_ERROR:
+            THROW_ERROR(JSON_ERROR_IO);
+        case EOF: 
+        case '\0':
+            // end-of-file
+            EMIT_PREVIOUS_TOKEN else { // emit EOF immediately!
+                tokenizer->token.type = JSON_TOKEN_EOF;
+                tokenizer->_notEmitted = false;
+            }
+            tokenizer->_currentToken.type = JSON_TOKEN_EOF;
+            break;
+        // whitespace
+        case ' ':
+        case '\n':
+        case '\r':
+        case '\t':
+        case '\f':
+            EMIT_PREVIOUS_TOKEN;
+            tokenizer->_currentToken.type = JSON_TOKEN_UNKNOWN;
+            if (c == '\n') {
+                tokenizer->pos = 0;
+                tokenizer->line++;
+            }
+            break;
+        // braces and brackets
+        case '{':
+            EMIT_PREVIOUS_TOKEN;
+            tokenizer->_currentToken.type = JSON_TOKEN_BRACE_OPENING;
+            break;
+        case '}':
+            EMIT_PREVIOUS_TOKEN;
+            tokenizer->_currentToken.type = JSON_TOKEN_BRACE_CLOSING;
+            break;
+        case '[':
+            EMIT_PREVIOUS_TOKEN;
+            tokenizer->_currentToken.type = JSON_TOKEN_BRACKET_OPENING;
+            break;
+        case ']':
+            EMIT_PREVIOUS_TOKEN;
+            tokenizer->_currentToken.type = JSON_TOKEN_BRACKET_CLOSING;
+            break;
+
+        // separators
+        case ':':
+            EMIT_PREVIOUS_TOKEN;
+            tokenizer->_currentToken.type = JSON_TOKEN_COLON;
+            break;
+        case ',':
+            EMIT_PREVIOUS_TOKEN;
+            tokenizer->_currentToken.type = JSON_TOKEN_COMMA;
+            break;
+
+        // string beginning
+        case '"':
+            EMIT_PREVIOUS_TOKEN;
+            tokenizer->_currentToken.type = JSON_TOKEN_STRING;
+            json_tokenizer_startText(tokenizer);
+            tokenizer->_currentTokenStatus = JSON_STRING_OPEN;
+            break;
+
+        // something else with lower priority...
+        default:
+            // parse the rest of the number
+            if (tokenizer->_currentToken.type == JSON_TOKEN_NUMERIC) {
+                if (!json_tokenizer_processNumeric(tokenizer, c)) return false;
+            }
+
+            // parse the rest of the symbol
+            else if (tokenizer->_currentToken.type == JSON_TOKEN_SYMBOL) {
+                if (is_alpha_or_underscore(c) || is_numeric(c)) {
+                    json_tokenizer_processLiteral(tokenizer, c);
+                }
+                else THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
+            }
+
+            else {
+                if (c == '-') { // start a number
+                    EMIT_PREVIOUS_TOKEN;
+                    tokenizer->_currentToken.type = JSON_TOKEN_NUMERIC;
+                    json_tokenizer_startText(tokenizer);
+                    json_tokenizer_append(tokenizer, c);
+                    tokenizer->_currentTokenStatus = JSON_NUMERIC_SIGN;
+                }
+                else if (is_numeric(c)) { // start a number
+                    EMIT_PREVIOUS_TOKEN;
+                    tokenizer->_currentToken.type = JSON_TOKEN_NUMERIC;
+                    json_tokenizer_startText(tokenizer);
+                    json_tokenizer_append(tokenizer, c);
+                    if (c != '0') tokenizer->_currentTokenStatus = JSON_NUMERIC_INTEGER;
+                    else tokenizer->_currentTokenStatus = JSON_NUMERIC_ZERO;
+                }
+                else if (is_alpha_or_underscore(c)) { // start a symbol (literal)
+                    EMIT_PREVIOUS_TOKEN;
+                    json_tokenizer_startLiteral(tokenizer, c);
+                }
+                // unknown...
+                else {       
+                    EMIT_PREVIOUS_TOKEN;
+                    THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
+                }
+            }
+        }
+    }
+    else { // tokenizer->_status.stringOpened == true
+        if (!json_tokenizer_processString(tokenizer, c)) return false;
+    }
+    return true;
+}
+
 /* Finds the next token. */
 bool json_tokenizer_next(json_tokenizer * tokenizer) {    
     int c; // current character
     tokenizer->_notEmitted = true;
     
-    // if EOF was found in previous call, return it immediately
+    // if EOF was found in previous call, return it immediately (nothing is read past the end)
     if (tokenizer->_currentToken.type == JSON_TOKEN_EOF) {
-        EMIT_PREVIOUS_TOKEN;
+        tokenizer->token.type = JSON_TOKEN_EOF;
+        return true;
+    }
+    
+    // a literal started with the previous token
+    if (tokenizer->_currentToken.type == JSON_TOKEN_SYMBOL && JSON_LITERAL_MATCHED(tokenizer->_currentTokenStatus) == 1) {
+        json_tokenizer_matchLiteral(tokenizer);
     }
     
     // process characters until we find a token to return
     while(tokenizer->_notEmitted) {
-        c = tokenizer->reader.nextChar(&tokenizer->reader.data);
+        c = json_reader_next(&tokenizer->reader);
         tokenizer->ch = c;
         tokenizer->pos++;
+        tokenizer->bytes += (c != EOF && c != '\0');
         
-        if (tokenizer->_currentToken.type != JSON_TOKEN_STRING) {
-            switch (c) {
-            // EOF
-            case EOF: 
-            case '\0':
-                // end-of-file
-                EMIT_PREVIOUS_TOKEN else { // emit EOF immediately!
-                    tokenizer->token.type = JSON_TOKEN_EOF;
-                    tokenizer->_notEmitted = false;
-                }
-                tokenizer->_currentToken.type = JSON_TOKEN_EOF;
-                break;
-            // whitespace
-            case ' ':
-            case '\n':
-            case '\r':
-            case '\t':
-            case '\f':
-                EMIT_PREVIOUS_TOKEN;
-                tokenizer->_currentToken.type = JSON_TOKEN_UNKNOWN;
-                if (c == '\n') {
-                    tokenizer->pos = 0;
-                    tokenizer->line++;
-                }
-                break;
-            // braces and brackets
-            case '{':
-                EMIT_PREVIOUS_TOKEN;
-                tokenizer->_currentToken.type = JSON_TOKEN_BRACE_OPENING;
-                break;
-            case '}':
-                EMIT_PREVIOUS_TOKEN;
-                tokenizer->_currentToken.type = JSON_TOKEN_BRACE_CLOSING;
-                break;
-            case '[':
-                EMIT_PREVIOUS_TOKEN;
-                tokenizer->_currentToken.type = JSON_TOKEN_BRACKET_OPENING;
-                break;
-            case ']':
-                EMIT_PREVIOUS_TOKEN;
-                tokenizer->_currentToken.type = JSON_TOKEN_BRACKET_CLOSING;
-                break;
-
-            // separators
-            case ':':
-                EMIT_PREVIOUS_TOKEN;
-                tokenizer->_currentToken.type = JSON_TOKEN_COLON;
-                break;
-            case ',':
-                EMIT_PREVIOUS_TOKEN;
-                tokenizer->_currentToken.type = JSON_TOKEN_COMMA;
-                break;
-
-            // string beginning
-            case '"':
-                EMIT_PREVIOUS_TOKEN;
-                tokenizer->_currentToken.type = JSON_TOKEN_STRING;
-                json_token_string_init(&tokenizer->_currentToken);
-                tokenizer->_currentTokenStatus = JSON_STRING_OPEN;
-                break;
-
-            // something else with lower priority...
-            default:
-                // parse the rest of the number
-                if (tokenizer->_currentToken.type == JSON_TOKEN_NUMERIC) {
-                    if (!json_tokenizer_processNumeric(tokenizer, c)) return false;
-                }
+        if (!json_tokenizer_processChar(tokenizer, c)) return false;
+    }   
+    
+    return true;
+}
 
-                // parse the rest of the symbol
-                else if (tokenizer->_currentToken.type == JSON_TOKEN_SYMBOL) {
-                    if (is_alpha_or_underscore(c) || is_numeric(c)) {
-                        json_token_string_append(&tokenizer->_currentToken, c);
-                        tokenizer->_currentTokenStatus = JSON_SYMBOL_NEXT_CHAR;
-                    }
-                    else {
-                        json_token_string_free(&tokenizer->_currentToken);
-                        THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
-                    }
-                }
+#define NEXT_CHAR \
+    c = json_reader_next(&tokenizer->reader); \
+    tokenizer->ch = c; \
+    tokenizer->pos++; \
+    tokenizer->bytes += (c != EOF && c != '\0'); \
+    if (c == '\n') { tokenizer->pos = 0; tokenizer->line++; }
 
-                else {
-                    if (c == '-') { // start a number
-                        EMIT_PREVIOUS_TOKEN;
-                        tokenizer->_currentToken.type = JSON_TOKEN_NUMERIC;
-                        json_token_string_init(&tokenizer->_currentToken);
-                        json_token_string_append(&tokenizer->_currentToken, c);
-                        tokenizer->_currentTokenStatus = JSON_NUMERIC_SIGN;
-                    }
-                    else if (is_numeric(c)) { // start a number
-                        EMIT_PREVIOUS_TOKEN;
-                        tokenizer->_currentToken.type = JSON_TOKEN_NUMERIC;
-                        json_token_string_init(&tokenizer->_currentToken);
-                        json_token_string_append(&tokenizer->_currentToken, c);
-                        if (c != '0') tokenizer->_currentTokenStatus = JSON_NUMERIC_INTEGER;
-                        else tokenizer->_currentTokenStatus = JSON_NUMERIC_ZERO;
-                    }
-                    else if (is_alpha_or_underscore(c)) { // start a symbol (identifier)
-                        EMIT_PREVIOUS_TOKEN;
-                        tokenizer->_currentToken.type = JSON_TOKEN_SYMBOL;
-                        json_token_string_init(&tokenizer->_currentToken);
-                        json_token_string_append(&tokenizer->_currentToken, c);
-                        tokenizer->_currentTokenStatus = JSON_SYMBOL_FIRST_CHAR;
-                    }
-                    // unknown...
-                    else {       
-                        EMIT_PREVIOUS_TOKEN;
-                        THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
-                    }
-                }
-            }
+/* Skips the next value without tokenizing it. */
+bool json_tokenizer_skip(json_tokenizer * tokenizer) {
+    int c; // current character
+    int depth = 0;
+    bool inString = false;
+    json_tokenType type = tokenizer->_currentToken.type;
+    
+    // the first character of the value may have been read already
+    if (type == JSON_TOKEN_UNKNOWN) {
+        do {
+            NEXT_CHAR;
+        } while (c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f');
+        
+        if (c == '-' || is_numeric(c) || is_alpha_or_underscore(c)) type = JSON_TOKEN_NUMERIC;
+        else {
+            if (!json_tokenizer_processChar(tokenizer, c)) return false;
+            type = tokenizer->_currentToken.type;
         }
+    }
+    
+    switch (type) {
+    case JSON_TOKEN_BRACE_CLOSING:
+    case JSON_TOKEN_BRACKET_CLOSING:
+        // not a value, emit the token
+        tokenizer->token = tokenizer->_currentToken;
+        json_resetTokenizerStatus(tokenizer);
+        return true;
+    case JSON_TOKEN_EOF:
+        THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+    case JSON_TOKEN_STRING:
+        inString = true;
+        break;
+    case JSON_TOKEN_BRACE_OPENING:
+    case JSON_TOKEN_BRACKET_OPENING:
+        depth = 1;
+        break;
+    case JSON_TOKEN_NUMERIC:
+    case JSON_TOKEN_SYMBOL:
+        // skip to the first delimiter and process it regularly
+        do {
+            NEXT_CHAR;
+        } while (is_alpha_or_underscore(c) || is_numeric(c) || c == '-' || c == '+' || c == '.');
+        json_resetTokenizerStatus(tokenizer);
+        if (c == '\n') tokenizer->line--; // will be counted again
+        bool ok = json_tokenizer_processChar(tokenizer, c);
+        tokenizer->token.type = JSON_TOKEN_UNKNOWN;
+        return ok;
+    default:
+        THROW_ERROR(JSON_ERROR_UNRESOLVED_TOKEN);
+    }
+    
+    // skip the string or the container, only quotes and brackets are matched
+    json_resetTokenizerStatus(tokenizer);
+    while (true) {
+        NEXT_CHAR;
+        if (c == JSON_READER_ERROR) THROW_ERROR(JSON_ERROR_IO);
+        if (c == EOF || c == '\0') THROW_ERROR(inString ? JSON_ERROR_STR_UNEXPECTED_EOF : JSON_ERROR_UNEXPECTED_EOF);
         
-        else { // tokenizer->_status.stringOpened == true
-            if (!json_tokenizer_processString(tokenizer, c)) return false;
+        if (inString) {
+            if (c == '\\') {
+                NEXT_CHAR;
+                if (c == EOF || c == '\0' || c == JSON_READER_ERROR) THROW_ERROR(c == JSON_READER_ERROR ? JSON_ERROR_IO : JSON_ERROR_STR_UNEXPECTED_EOF);
+            }
+            else if (c == '"') {
+                inString = false;
+                if (depth == 0) break;
+            }
         }
-    }   
+        else if (c == '"') inString = true;
+        else if (c == '{' || c == '[') depth++;
+        else if (c == '}' || c == ']') {
+            if (--depth == 0) break;
+        }
+    }
     
+    tokenizer->token.type = JSON_TOKEN_UNKNOWN;
     return true;
 }
 
+#undef NEXT_CHAR
+
 /* Processing a number. */
 static inline int json_tokenizer_processNumeric(json_tokenizer * tokenizer, int c) {
     switch (tokenizer->_currentTokenStatus) {
     case JSON_NUMERIC_SIGN:
         if (c == '0') {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_ZERO;
         }
         else if (c >= '1' && c <= '9') {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_INTEGER;
         }
         else {
-            json_token_string_free(&tokenizer->_currentToken);
             THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
         }
         break;
     case JSON_NUMERIC_ZERO:
         if (c == '.') {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_POINT;
         }
         else if (c == 'e' || c == 'E') {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_EXP;
         }
         else {
-            json_token_string_free(&tokenizer->_currentToken);
             THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
         }
         break;
     case JSON_NUMERIC_INTEGER:
         if (c == '.') {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_POINT;
         }
         else if (c == 'e' || c == 'E') {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_EXP;
         }
         else if (is_numeric(c)) {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
         }
         else {
-            json_token_string_free(&tokenizer->_currentToken);
             THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
         }
         break;
     case JSON_NUMERIC_POINT:
         if (is_numeric(c)) {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_FLOAT;
         }
         else {
-            json_token_string_free(&tokenizer->_currentToken);
             THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
         }
         break;
     case JSON_NUMERIC_FLOAT:
         if (is_numeric(c)) {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
         }
         else if (c == 'e' || c == 'E') {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_EXP;
         }
         else {
-            json_token_string_free(&tokenizer->_currentToken);
             THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
         }
         break;
     case JSON_NUMERIC_EXP:
         if (c == '+' || c == '-') {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_EXP_SIGN;
         }
         else if (is_numeric(c)) {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_EXP_VALUE;
         }
         else {
-            json_token_string_free(&tokenizer->_currentToken);
             THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
         }
         break;
     case JSON_NUMERIC_EXP_SIGN:
         if (is_numeric(c)) {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
             tokenizer->_currentTokenStatus = JSON_NUMERIC_EXP_VALUE;
         }
         else {
-            json_token_string_free(&tokenizer->_currentToken);
             THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
         }
         break;
     case JSON_NUMERIC_EXP_VALUE:
         if (is_numeric(c)) {
-            json_token_string_append(&tokenizer->_currentToken, c);
+            json_tokenizer_append(tokenizer, c);
         }
         else {
-            json_token_string_free(&tokenizer->_currentToken);
             THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER);
         }
         break;
@@ -445,11 +633,12 @@ static inline int json_tokenizer_processNumeric(json_tokenizer * tokenizer, int
 /* Processing a string. */
 static inline int json_tokenizer_processString(json_tokenizer * tokenizer, int c) {
     if (c == EOF || c == '\0') {
-        json_token_string_free(&tokenizer->_currentToken);
         THROW_ERROR(JSON_ERROR_STR_UNEXPECTED_EOF);
     }
+    else if (c == JSON_READER_ERROR) {
+        THROW_ERROR(JSON_ERROR_IO);
+    }
     else if (c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\b') {
-        json_token_string_free(&tokenizer->_currentToken);
         THROW_ERROR(JSON_ERROR_STR_UNEXPECTED_CTRL);
     }
     else {
@@ -459,16 +648,26 @@ static inline int json_tokenizer_processString(json_tokenizer * tokenizer, int c
             }
             else if (c == '"') { // close the string
                 // tokenizer->_currentTokenStatus = JSON_STRING_NONE;
+                json_tokenizer_finishText(tokenizer);
                 EMIT_PREVIOUS_TOKEN;
             }
             else {
-                // add the character to the buffer
-                json_token_string_append(&tokenizer->_currentToken, c);
+                // add the character to the buffer, with the rest of the plain characters in the window
+                json_tokenizer_append(tokenizer, c);
+                if (tokenizer->reader.window != NULL) json_tokenizer_appendRun(tokenizer);
             }
         }
         else if (tokenizer->_currentTokenStatus == JSON_STRING_BACKSLASH) {
+            if (tokenizer->raw) json_tokenizer_append(tokenizer, '\\');
+            if (tokenizer->raw && c != 'u') { // the escape is kept as it is
+                if (strchr("\"\\/bfnrt", c) == NULL) THROW_ERROR(JSON_ERROR_STR_INVALID_ESCAPE);
+                json_tokenizer_append(tokenizer, c);
+                tokenizer->_currentTokenStatus = JSON_STRING_OPEN;
+                return true;
+            }
+            
             #define APPEND_CHAR(C) \
-                    json_token_string_append(&tokenizer->_currentToken, C); \
+                    json_tokenizer_append(tokenizer, C); \
                     tokenizer->_currentTokenStatus = JSON_STRING_OPEN; \
                     break;
 
@@ -482,49 +681,66 @@ static inline int json_tokenizer_processString(json_tokenizer * tokenizer, int c
             case 'r':   APPEND_CHAR('\r');
             case 't':   APPEND_CHAR('\t');
             case 'u':
+                if (tokenizer->raw) json_tokenizer_append(tokenizer, c);
                 tokenizer->_currentTokenStatus = JSON_STRING_UNI_0;
                 tokenizer->_unicodeChar = 0;
                 break;
             default:
-                json_token_string_free(&tokenizer->_currentToken);
                     THROW_ERROR(JSON_ERROR_STR_INVALID_ESCAPE);
             }
         }
         else if (tokenizer->_currentTokenStatus == JSON_STRING_UNI_0) {
             int hex = hex_to_int(c);
-            if (hex == -1) THROW_ERROR(JSON_ERROR_STR_INVALID_UNICODE);
+            if (hex == -1) {
+                THROW_ERROR(JSON_ERROR_STR_INVALID_UNICODE);
+            }
+            if (tokenizer->raw) json_tokenizer_append(tokenizer, c);
             tokenizer->_unicodeChar |= hex << 12;
             tokenizer->_currentTokenStatus = JSON_STRING_UNI_1;
         }
         else if (tokenizer->_currentTokenStatus == JSON_STRING_UNI_1) {
             int hex = hex_to_int(c);
-            if (hex == -1) THROW_ERROR(JSON_ERROR_STR_INVALID_UNICODE);
+            if (hex == -1) {
+                THROW_ERROR(JSON_ERROR_STR_INVALID_UNICODE);
+            }
+            if (tokenizer->raw) json_tokenizer_append(tokenizer, c);
             tokenizer->_unicodeChar |= hex << 8;
             tokenizer->_currentTokenStatus = JSON_STRING_UNI_2;
         }
         else if (tokenizer->_currentTokenStatus == JSON_STRING_UNI_2) {
             int hex = hex_to_int(c);
-            if (hex == -1) THROW_ERROR(JSON_ERROR_STR_INVALID_UNICODE);
+            if (hex == -1) {
+                THROW_ERROR(JSON_ERROR_STR_INVALID_UNICODE);
+            }
+            if (tokenizer->raw) json_tokenizer_append(tokenizer, c);
             tokenizer->_unicodeChar |= hex << 4;
             tokenizer->_currentTokenStatus = JSON_STRING_UNI_3;
         }
         else if (tokenizer->_currentTokenStatus == JSON_STRING_UNI_3) {
             int hex = hex_to_int(c);
-            if (hex == -1) THROW_ERROR(JSON_ERROR_STR_INVALID_UNICODE);
+            if (hex == -1) {
+                THROW_ERROR(JSON_ERROR_STR_INVALID_UNICODE);
+            }
+            if (tokenizer->raw) json_tokenizer_append(tokenizer, c);
             tokenizer->_unicodeChar |= hex;
             
+            if (tokenizer->raw) { // the sequence is kept
+                tokenizer->_currentTokenStatus = JSON_STRING_OPEN;
+                return true;
+            }
+            
             int u = tokenizer->_unicodeChar;
             if (u < 0x80) {
-                json_token_string_append(&tokenizer->_currentToken, u & 0x7F); // 0xxxxxxx
+                json_tokenizer_append(tokenizer, u & 0x7F); // 0xxxxxxx
             }
             else if (u < 0x800) {
-                json_token_string_append(&tokenizer->_currentToken, ((u >> 6)  & 0x1F) | 0xC0);    // 110xxxxx 
-                json_token_string_append(&tokenizer->_currentToken, ( u        & 0x3F) | 0x80);    // 10xxxxxx
+                json_tokenizer_append(tokenizer, ((u >> 6)  & 0x1F) | 0xC0);    // 110xxxxx 
+                json_tokenizer_append(tokenizer, ( u        & 0x3F) | 0x80);    // 10xxxxxx
             }
             else {
-                json_token_string_append(&tokenizer->_currentToken, ((u >> 12) & 0x0F) | 0xE0);    // 1110xxxx 
-                json_token_string_append(&tokenizer->_currentToken, ((u >> 6)  & 0x3F) | 0x80);    // 10xxxxxx 
-                json_token_string_append(&tokenizer->_currentToken, ( u        & 0x3F) | 0x80);    // 10xxxxxx
+                json_tokenizer_append(tokenizer, ((u >> 12) & 0x0F) | 0xE0);    // 1110xxxx 
+                json_tokenizer_append(tokenizer, ((u >> 6)  & 0x3F) | 0x80);    // 10xxxxxx 
+                json_tokenizer_append(tokenizer, ( u        & 0x3F) | 0x80);    // 10xxxxxx
             }
             
             tokenizer->_currentTokenStatus = JSON_STRING_OPEN;
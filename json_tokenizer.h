@@ -53,7 +53,7 @@ typedef enum JSON_TOKEN_TYPE {
     JSON_TOKEN_INTEGER, // integer
     JSON_TOKEN_FLOAT,   // float
     
-    JSON_TOKEN_SYMBOL,  // unresolved symbol
+    JSON_TOKEN_SYMBOL,  // unresolved symbol (not a literal, the text isn't stored)
     JSON_TOKEN_NULL,    // null value
     JSON_TOKEN_BOOL     // boolean
 } json_tokenType;
@@ -83,22 +83,49 @@ typedef struct JSON_TOKENIZER {
 
     int ch; // current character
     int line, pos; // line and position
+    long bytes; // number of characters read
     
     // function which returns next character from the input (or buffer)
     json_reader reader;
     
+    // container sizes in the order of appearance (optional, used for presizing by the parser)
+    const int * sizeHints;
+    int sizeHintCount;
+    
+    // handling of duplicate map keys by json_parse_value (json_duplicate_keys, JSON_DUPLICATE_LAST by default)
+    int duplicateKeys;
+    
+    // keep the text of strings and numbers as it is in the input (no unescaping or number conversion)
+    bool raw;
+    
+    // text of the current token (string or number), reused for all tokens
+    char * scratch;
+    int scratchCapacity;
+    
     // private fields
     bool _notEmitted;
     json_token _currentToken;
     int _currentTokenStatus;
     int _unicodeChar;
+    int _sizeHintPosition;
+    int _depth;
 } json_tokenizer;
 
 /* 
- * Initializes a new tokenizer.
+ * Initializes a new tokenizer. It has to be freed with json_tokenizer_free.
  */
 extern void json_tokenizer_init(json_tokenizer * tokenizer, json_reader reader);
 
+/* 
+ * Prepares the tokenizer for another input, the scratch buffer is kept.
+ */
+extern void json_tokenizer_reset(json_tokenizer * tokenizer, json_reader reader);
+
+/* 
+ * Frees the tokenizer's scratch buffer.
+ */
+extern void json_tokenizer_free(json_tokenizer * tokenizer);
+
 /* 
  * Finds the next token, which will be stored in tokenizer.token field.
  * 
@@ -107,13 +134,25 @@ extern void json_tokenizer_init(json_tokenizer * tokenizer, json_reader reader);
 extern bool json_tokenizer_next(json_tokenizer * tokenizer);
 
 /* 
- * Returns the pointer for the char* data of the token (types string or symbol). 
- * The caller must free the memory block manually after this function has been called. 
+ * Skips the next value without tokenizing it. Only quotes and brackets are matched,
+ * there's no unescaping, number conversion or allocation.
+ * 
+ * If the next token is a closing brace or bracket, it's emitted as a regular token
+ * instead, otherwise the type of tokenizer.token is JSON_TOKEN_UNKNOWN.
+ * 
+ * Returns false, if an error occurs.
+ */
+extern bool json_tokenizer_skip(json_tokenizer * tokenizer);
+
+/* 
+ * Returns a copy of the token's string. The string data of tokens is stored in
+ * the tokenizer's scratch buffer and is valid until the next token only.
+ * The caller must free the copy.
  */
 extern char * json_token_hijack(json_token * token);
 
 /* 
- * Frees the char* data of the token.
+ * Releases the string data of the token (it's owned by the tokenizer, nothing is freed).
  */
 extern void json_token_free(json_token * token);
 
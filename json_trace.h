@@ -0,0 +1,73 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_TRACE_H
+#define	JSON_TRACE_H
+
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Trace events (the meaning of the value is in the comments). */
+typedef enum JSON_TRACE_EVENT {
+    JSON_TRACE_PARSE_START = 0, // 0
+    JSON_TRACE_PARSE_END, // number of bytes parsed
+    JSON_TRACE_REFILL, // number of bytes read by a buffered reader
+    JSON_TRACE_CONTAINER_OPEN, // JSON_OBJECT_MAP or JSON_OBJECT_ARRAY
+    JSON_TRACE_CONTAINER_CLOSE, // number of items
+    JSON_TRACE_ALLOC // number of bytes
+} json_trace_event;
+
+/* Trace callback, the timestamp is a value of the CPU cycle counter. */
+typedef void (* json_trace_callback)(json_trace_event event, unsigned long long timestamp, size_t value, void * data);
+
+/* 
+ * Sets the trace callback for all threads (NULL disables tracing). The trace
+ * points exist only if the library is compiled with JSON_TRACE.
+ */
+extern void json_trace_set(json_trace_callback callback, void * data);
+
+/* Returns the current value of the CPU cycle counter. */
+extern unsigned long long json_trace_cycles(void);
+
+
+#ifdef JSON_TRACE
+extern json_trace_callback json_trace_function;
+extern void * json_trace_data;
+#define JSON_TRACE_POINT(event, value) { if (json_trace_function) json_trace_function(event, json_trace_cycles(), (value), json_trace_data); }
+#else
+#define JSON_TRACE_POINT(event, value)
+#endif
+
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* JSON_TRACE_H */
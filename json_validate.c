@@ -0,0 +1,365 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "json_validate.h"
+#include "json_tokenizer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_VALIDATE_SSE2
+#include <emmintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static inline int json_validate_firstBit(unsigned mask) {
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+}
+#else
+static inline int json_validate_firstBit(unsigned mask) {
+    return __builtin_ctz(mask);
+}
+#endif
+#endif
+
+/* 
+ * State of the validation. The tokens are emitted at the same characters as from
+ * the tokenizer, so the errors get the same positions.
+ */
+typedef struct JSON_VALIDATOR {
+    const unsigned char * start;
+    const unsigned char * p; // next character
+    const unsigned char * end;
+    bool eof; // '\0' or the end of the buffer was read
+    json_tokenType token;
+    size_t consumed; // characters read when the token was emitted (EOF counts too)
+    int code; // tokenizer error
+} json_validator;
+
+static inline bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f';
+}
+
+static inline bool is_digit(int c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool is_symbol(int c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || is_digit(c);
+}
+
+/* Returns true if the character ends a number or a symbol. */
+static inline bool json_validate_isDelimiter(const json_validator * v, const unsigned char * p) {
+    if (p == v->end) return true;
+    switch (*p) {
+    case '\0': case ' ': case '\n': case '\r': case '\t': case '\f':
+    case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Skips the whitespace, indentation after a new line is skipped in blocks. */
+static inline const unsigned char * json_validate_skipSpace(const unsigned char * p, const unsigned char * end) {
+    while (p < end && is_space(*p)) {
+        if (*p++ != '\n') continue;
+#ifdef JSON_VALIDATE_SSE2
+        const __m128i spaces = _mm_set1_epi8(' ');
+        while (end - p >= 16) {
+            unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), spaces));
+            if (mask != 0xFFFF) {
+                p += json_validate_firstBit(~mask);
+                break;
+            }
+            p += 16;
+        }
+#endif
+    }
+    return p;
+}
+
+/* Skips the characters of a string up to a quote, a backslash or a control character. */
+static inline const unsigned char * json_validate_skipString(const unsigned char * p, const unsigned char * end) {
+#ifdef JSON_VALIDATE_SSE2
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), control = _mm_set1_epi8(0x1F);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control)); // <= 0x1F
+        unsigned mask = _mm_movemask_epi8(special);
+        if (mask != 0) return p + json_validate_firstBit(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\' && *p >= 0x20) p++;
+    return p;
+}
+
+/* Fails with a tokenizer error at the character p. */
+#define THROW_ERROR(errcode, p) { v->code = errcode; v->consumed = (p) - v->start + 1; return false; }
+
+/* Control characters not allowed in strings. */
+static inline bool is_control(int c) {
+    return c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\b';
+}
+
+static inline bool is_hex(int c) {
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/* Checks the next character of a string (not the end of the input or a control character). */
+#define CHECK_STRING_CHAR(p) \
+    if (p == end || *p == '\0') THROW_ERROR(JSON_ERROR_STR_UNEXPECTED_EOF, p); \
+    if (is_control(*p)) THROW_ERROR(JSON_ERROR_STR_UNEXPECTED_CTRL, p);
+
+/* Checks a string starting after the opening quote, it's emitted at the closing quote. */
+static inline bool json_validate_string(json_validator * v) {
+    const unsigned char * p = v->p, * end = v->end;
+    for (;;) {
+        p = json_validate_skipString(p, end);
+        CHECK_STRING_CHAR(p);
+        if (*p == '"') break;
+        if (*p++ != '\\') continue; // other control characters are allowed
+        
+        CHECK_STRING_CHAR(p);
+        switch (*p++) {
+        case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+            break;
+        case 'u':
+            for (int i = 0; i < 4; i++, p++) {
+                CHECK_STRING_CHAR(p);
+                if (!is_hex(*p)) THROW_ERROR(JSON_ERROR_STR_INVALID_UNICODE, p);
+            }
+            break;
+        default:
+            THROW_ERROR(JSON_ERROR_STR_INVALID_ESCAPE, p - 1);
+        }
+    }
+    v->p = p + 1;
+    v->consumed = v->p - v->start;
+    v->token = JSON_TOKEN_STRING;
+    return true;
+}
+
+/* Fails at the character p, which isn't part of the number (or symbol) starting before it. */
+#define THROW_TOKEN_END(p) { \
+    if (json_validate_isDelimiter(v, p)) THROW_ERROR(JSON_ERROR_UNEXPECTED_TOKEN_END, p) \
+    else THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER, p); \
+}
+
+/* Checks a number, it's emitted at the delimiter after it. */
+static inline bool json_validate_number(json_validator * v) {
+    const unsigned char * p = v->p, * end = v->end;
+    if (*p == '-') p++;
+    if (p < end && *p == '0') p++;
+    else if (p < end && is_digit(*p)) {
+        while (++p < end && is_digit(*p));
+    }
+    else THROW_TOKEN_END(p);
+    
+    if (p < end && *p == '.') {
+        if (++p == end || !is_digit(*p)) THROW_TOKEN_END(p);
+        while (++p < end && is_digit(*p));
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        if (++p < end && (*p == '+' || *p == '-')) p++;
+        if (p == end || !is_digit(*p)) THROW_TOKEN_END(p);
+        while (++p < end && is_digit(*p));
+    }
+    if (!json_validate_isDelimiter(v, p)) THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER, p);
+    
+    v->p = p;
+    v->consumed = p - v->start + 1;
+    v->token = JSON_TOKEN_INTEGER;
+    return true;
+}
+
+/* Checks a symbol, only the literals are valid tokens. */
+static inline bool json_validate_symbol(json_validator * v) {
+    const unsigned char * start = v->p, * p = v->p, * end = v->end;
+    while (++p < end && is_symbol(*p));
+    if (!json_validate_isDelimiter(v, p)) THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER, p);
+    
+    size_t length = p - start;
+    if ((length == 4 && memcmp(start, "true", 4) == 0) || (length == 5 && memcmp(start, "false", 5) == 0)) v->token = JSON_TOKEN_BOOL;
+    else if (length == 4 && memcmp(start, "null", 4) == 0) v->token = JSON_TOKEN_NULL;
+    else v->token = JSON_TOKEN_SYMBOL; // unresolved
+    v->p = p;
+    v->consumed = p - v->start + 1;
+    return true;
+}
+
+/* Finds the next token. */
+static bool json_validate_next(json_validator * v) {
+    if (v->eof) { // nothing is read past the end
+        v->token = JSON_TOKEN_EOF;
+        return true;
+    }
+    
+    const unsigned char * p = v->p = json_validate_skipSpace(v->p, v->end);
+    if (p == v->end || *p == '\0') {
+        v->eof = true;
+        v->token = JSON_TOKEN_EOF;
+        v->consumed = p - v->start + 1;
+        return true;
+    }
+    
+    switch (*p) {
+    case '{': v->token = JSON_TOKEN_BRACE_OPENING; break;
+    case '}': v->token = JSON_TOKEN_BRACE_CLOSING; break;
+    case '[': v->token = JSON_TOKEN_BRACKET_OPENING; break;
+    case ']': v->token = JSON_TOKEN_BRACKET_CLOSING; break;
+    case ':': v->token = JSON_TOKEN_COLON; break;
+    case ',': v->token = JSON_TOKEN_COMMA; break;
+    case '"':
+        v->p++;
+        return json_validate_string(v);
+    default:
+        if (*p == '-' || is_digit(*p)) return json_validate_number(v);
+        if (is_symbol(*p)) return json_validate_symbol(v);
+        THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER, p);
+    }
+    
+    // the punctuation is emitted at the next character, which must start a token
+    v->p = ++p;
+    if (p < v->end && !json_validate_isDelimiter(v, p) && *p != '-' && !is_symbol(*p)) THROW_ERROR(JSON_ERROR_UNEXPECTED_CHARACTER, p);
+    v->consumed = p - v->start + 1;
+    return true;
+}
+
+#undef THROW_TOKEN_END
+#undef CHECK_STRING_CHAR
+#undef THROW_ERROR
+
+/* Stores the error with the tokenizer's line and position after the consumed characters. */
+static bool json_validate_error(const json_validator * v, int code, size_t consumed, bool tokenizerError, json_error * error) {
+    if (error == NULL) return false;
+    // the character of a tokenizer error isn't processed (a new line isn't counted)
+    size_t processed = tokenizerError ? consumed - 1 : consumed;
+    size_t length = v->end - v->start;
+    int line = 1;
+    size_t lineStart = 0;
+    for (size_t i = 0; i < processed && i < length; i++) {
+        if (v->start[i] == '\n') {
+            line++;
+            lineStart = i + 1;
+        }
+    }
+    error->code = code;
+    error->line = line;
+    error->pos = (int)(consumed - lineStart);
+    return false;
+}
+
+#define NEXT_TOKEN { if (!json_validate_next(&v)) return json_validate_error(&v, v.code, v.consumed, true, error); }
+#define THROW_ERROR(errcode) return json_validate_error(&v, errcode, v.consumed, false, error)
+
+/* Pushes a container to the stack. */
+#define PUSH(map) { \
+    if (depth == JSON_VALIDATE_MAX_DEPTH) THROW_ERROR(JSON_ERROR_TOO_DEEP); \
+    if (map) stack[depth / 64] |= (uint64_t)1 << (depth % 64); \
+    else stack[depth / 64] &= ~((uint64_t)1 << (depth % 64)); \
+    depth++; \
+}
+#define IS_MAP(depth) ((stack[(depth) / 64] >> ((depth) % 64)) & 1)
+
+/* Reads the key and ":" of a map item, starting with the current token. */
+#define READ_KEY { \
+    if (v.token == JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF); \
+    if (v.token != JSON_TOKEN_STRING) THROW_ERROR(JSON_ERROR_EXPECTED_STRING); \
+    NEXT_TOKEN; \
+    if (v.token == JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF); \
+    if (v.token != JSON_TOKEN_COLON) THROW_ERROR(JSON_ERROR_EXPECTED_COLON); \
+    NEXT_TOKEN; \
+}
+
+/* Validates a JSON document (the same grammar as json_parser_value, without building anything). */
+bool json_validate(const char * buffer, size_t length, json_error * error) {
+    json_validator v;
+    v.start = v.p = (const unsigned char*)buffer;
+    v.end = v.start + length;
+    v.eof = false;
+    
+    uint64_t stack[JSON_VALIDATE_MAX_DEPTH / 64 + 1]; // a bit per open container, set for maps
+    int depth = 0;
+    
+    NEXT_TOKEN;
+    for (;;) {
+        // the current token starts a value
+        bool complete = true;
+        switch (v.token) {
+        case JSON_TOKEN_NULL:
+        case JSON_TOKEN_BOOL:
+        case JSON_TOKEN_INTEGER:
+        case JSON_TOKEN_STRING:
+            break;
+        case JSON_TOKEN_BRACE_OPENING:
+            PUSH(true);
+            NEXT_TOKEN;
+            if (v.token == JSON_TOKEN_BRACE_CLOSING) depth--; // empty map
+            else {
+                READ_KEY;
+                complete = false;
+            }
+            break;
+        case JSON_TOKEN_BRACKET_OPENING:
+            PUSH(false);
+            NEXT_TOKEN;
+            if (v.token == JSON_TOKEN_BRACKET_CLOSING) depth--; // empty array
+            else complete = false;
+            break;
+        case JSON_TOKEN_EOF:
+            THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+        default:
+            THROW_ERROR(JSON_ERROR_UNRESOLVED_TOKEN);
+        }
+        
+        // close the finished containers
+        while (complete) {
+            if (depth == 0) { // EOF wanted
+                if (!json_validate_next(&v)) return json_validate_error(&v, JSON_ERROR_GARBAGE, v.consumed, true, error);
+                if (v.token != JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_GARBAGE);
+                return true;
+            }
+            
+            bool map = IS_MAP(depth - 1);
+            NEXT_TOKEN;
+            if (v.token == JSON_TOKEN_EOF) THROW_ERROR(JSON_ERROR_UNEXPECTED_EOF);
+            if (v.token == JSON_TOKEN_COMMA) {
+                NEXT_TOKEN;
+                if (map) READ_KEY;
+                complete = false;
+            }
+            else if (v.token == (map ? JSON_TOKEN_BRACE_CLOSING : JSON_TOKEN_BRACKET_CLOSING)) depth--;
+            else THROW_ERROR(map ? JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACE : JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET);
+        }
+    }
+}
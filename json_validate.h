@@ -0,0 +1,57 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_VALIDATE_H
+#define	JSON_VALIDATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "json_error.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef JSON_VALIDATE_MAX_DEPTH
+#define JSON_VALIDATE_MAX_DEPTH 65536 // nesting limit (the stack has a bit per level)
+#endif
+
+/* 
+ * Checks that the buffer holds a valid JSON document, accepting exactly what
+ * json_parser_parse accepts. Nothing is allocated, the numbers aren't converted
+ * and the strings aren't unescaped, so it's much faster than parsing. The error
+ * (may be NULL) gets the same code and position as from the parser, nesting
+ * deeper than JSON_VALIDATE_MAX_DEPTH is reported as JSON_ERROR_TOO_DEEP.
+ */
+extern bool json_validate(const char * buffer, size_t length, json_error * error);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* JSON_VALIDATE_H */
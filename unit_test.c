@@ -29,12 +29,25 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "json_tokenizer.h"
 #include "json_reader.h"
 #include "json_debug.h"
 #include "json_object.h"
 #include "json.h"
+#include "json_path.h"
+#include "json_binary.h"
+#include "json_snapshot.h"
+#include "json_stats.h"
+#include "json_trace.h"
+#include "json_async.h"
+#include "json_validate.h"
+#include "json_format.h"
+
+#ifdef JSON_ZLIB
+#include <zlib.h>
+#endif
 
 typedef bool (* json_unit_test)(void);
 
@@ -89,6 +102,152 @@ static bool test_reader_2(void) {
     JSON_TEST_DONE;
 }
 
+typedef struct TEST_SOURCE {
+    const char * string;
+    size_t maxBlock;
+} test_source;
+
+static long test_sourceRead(void * data, char * buffer, size_t size) {
+    test_source * source = data;
+    size_t length = strlen(source->string);
+    if (length > size) length = size;
+    if (length > source->maxBlock) length = source->maxBlock; // short reads like a pipe
+    memcpy(buffer, source->string, length);
+    source->string += length;
+    return length;
+}
+
+static int test_charsNextChar(void ** data) {
+    const char ** chars = (const char**)data;
+    return **chars ? *(*chars)++ : EOF;
+}
+
+/* Buffered reader test. */
+static bool test_reader_3(void) {
+    JSON_TEST_START;
+    const char * input = "{\"name\": \"caf\\u00e9 \\\" bar\", \"values\": [12345, -6.5e2, true, null], \"\\u00c1\": {}}";
+    
+    for (size_t blockSize = 1; blockSize <= 8; blockSize++) {
+        test_source source = {input, blockSize == 8 ? 3 : 100};
+        json_reader reader = json_reader_buffered(test_sourceRead, &source, blockSize);
+        json_error error = JSON_ERROR_EMPTY;
+        json_object * obj = json_parse(reader, &error);
+        json_reader_free(&reader);
+        
+        JSON_TEST_ASSERT(obj != NULL);
+        JSON_TEST_ASSERT(strcmp(json_string_value(json_map_get(obj, "name")), "caf\xc3\xa9 \" bar") == 0);
+        json_object * values = json_map_get(obj, "values");
+        JSON_TEST_ASSERT(json_array_size(values) == 4);
+        JSON_TEST_ASSERT(json_int_value(json_array_get(values, 0)) == 12345);
+        JSON_TEST_ASSERT(json_float_value(json_array_get(values, 1)) == -650.0f);
+        JSON_TEST_ASSERT(json_bool_value(json_array_get(values, 2)) == true);
+        JSON_TEST_ASSERT(json_map_get(obj, "\xc3\x81") != NULL);
+        json_object_free(obj);
+    }
+    
+    // characters, including the bytes above 127
+    test_source source = {"ab\xc3\xa9", 100};
+    json_reader reader = json_reader_buffered(test_sourceRead, &source, 3);
+    JSON_TEST_ASSERT(reader.nextChar(&reader.data) == 'a');
+    JSON_TEST_ASSERT(json_reader_next(&reader) == 'b');
+    JSON_TEST_ASSERT(json_reader_next(&reader) == 0xc3);
+    JSON_TEST_ASSERT(reader.nextChar(&reader.data) == 0xa9);
+    JSON_TEST_ASSERT(json_reader_next(&reader) == EOF);
+    JSON_TEST_ASSERT(json_reader_next(&reader) == EOF);
+    json_reader_free(&reader);
+    
+    // readers without a buffer aren't freed
+    json_reader custom = JSON_READER_INIT(test_charsNextChar, (void*)"[1]");
+    JSON_TEST_ASSERT(json_reader_next(&custom) == '[');
+    json_reader_free(&custom);
+    json_reader_window window;
+    json_reader memory = json_reader_memory(&window, "[1]", 3);
+    json_reader_free(&memory);
+    JSON_TEST_ASSERT(json_reader_next(&memory) == '[');
+    
+    // missing file
+    json_error error = JSON_ERROR_EMPTY;
+    JSON_TEST_ASSERT(json_parse_file("test_files/missing.json", &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_IO);
+    
+    // read error
+    reader = json_reader_fd(-1, 16);
+    JSON_TEST_ASSERT(json_reader_next(&reader) == JSON_READER_ERROR);
+    JSON_TEST_ASSERT(json_parse(reader, &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_IO);
+    json_reader_free(&reader);
+    
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+#ifdef JSON_ZLIB
+typedef struct TEST_BYTES {
+    const unsigned char * data;
+    size_t size;
+} test_bytes;
+
+static long test_bytesRead(void * data, char * buffer, size_t size) {
+    test_bytes * bytes = data;
+    if (size > bytes->size) size = bytes->size;
+    memcpy(buffer, bytes->data, size);
+    bytes->data += size;
+    bytes->size -= size;
+    return size;
+}
+
+/* Compresses the string as a gzip member. */
+static size_t test_gzip(const char * string, unsigned char * output, size_t size) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    stream.next_in = (Bytef*)string;
+    stream.avail_in = strlen(string);
+    stream.next_out = output;
+    stream.avail_out = size;
+    deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    return size - stream.avail_out;
+}
+
+/* Gzip reader test. */
+static bool test_reader_4(void) {
+    JSON_TEST_START;
+    unsigned char compressed[512];
+    size_t size = test_gzip("{\"numbers\": [1, 2, 3], \"text\": \"", compressed, sizeof(compressed));
+    size += test_gzip("compressed\"}", compressed + size, sizeof(compressed) - size); // concatenated members
+    
+    for (size_t blockSize = 1; blockSize <= 5; blockSize++) {
+        test_bytes bytes = {compressed, size};
+        json_reader reader = json_reader_gzip(test_bytesRead, &bytes, blockSize);
+        json_object * obj = json_parse(reader, NULL);
+        json_reader_free(&reader);
+        
+        JSON_TEST_ASSERT(obj != NULL);
+        JSON_TEST_ASSERT(json_array_size(json_map_get(obj, "numbers")) == 3);
+        JSON_TEST_ASSERT(strcmp(json_string_value(json_map_get(obj, "text")), "compressed") == 0);
+        json_object_free(obj);
+    }
+    
+    // truncated and corrupted input
+    json_error error = JSON_ERROR_EMPTY;
+    test_bytes bytes = {compressed, size - 20};
+    json_reader reader = json_reader_gzip(test_bytesRead, &bytes, 64);
+    JSON_TEST_ASSERT(json_parse(reader, &error) == NULL);
+    json_reader_free(&reader);
+    
+    compressed[15] ^= 0xff;
+    bytes.data = compressed;
+    bytes.size = size;
+    reader = json_reader_gzip(test_bytesRead, &bytes, 64);
+    JSON_TEST_ASSERT(json_parse(reader, &error) == NULL);
+    json_reader_free(&reader);
+    
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+#endif
+
 /* Tokenizer - testing empty file (string). */
 static bool test_tokenizer_1(void) {
     JSON_TEST_START;
@@ -153,11 +312,11 @@ static bool test_tokenizer_3(void) {
 /* Tokenizer - testing symbols, null and boolean values. */
 static bool test_tokenizer_4(void) {
     JSON_TEST_START;
-    char * json = "true false null _true False NULL";
+    char * json = "true false null _true False NULL nul truex null1";
     json_tokenizer t;
     json_tokenizer_init(&t, json_reader_string(json));
     
-    for (int i = 0; i < 6; i++) {
+    for (int i = 0; i < 9; i++) {
         bool ok = json_tokenizer_next(&t);
         JSON_TEST_ASSERT(ok);
         JSON_TEST_ASSERT(t.token.type != JSON_TOKEN_EOF);
@@ -173,47 +332,47 @@ static bool test_tokenizer_4(void) {
         case 2:
             JSON_TEST_ASSERT(t.token.type == JSON_TOKEN_NULL);
             break;
-        case 3:
-            JSON_TEST_ASSERT(t.token.type == JSON_TOKEN_SYMBOL);
-            JSON_TEST_ASSERT(strcmp(t.token.data.string.data, "_true") == 0);
-            json_token_free(&t.token);
-            break;
-        case 4:
-            JSON_TEST_ASSERT(t.token.type == JSON_TOKEN_SYMBOL);
-            JSON_TEST_ASSERT(strcmp(t.token.data.string.data, "False") == 0);
-            json_token_free(&t.token);
-            break;
-        case 5:
+        default: // other symbols are unresolved
             JSON_TEST_ASSERT(t.token.type == JSON_TOKEN_SYMBOL);
-            JSON_TEST_ASSERT(strcmp(t.token.data.string.data, "NULL") == 0);
             json_token_free(&t.token);
             break;
         }
     }
     
+    JSON_TEST_ASSERT(json_tokenizer_next(&t));
+    JSON_TEST_ASSERT(t.token.type == JSON_TOKEN_EOF);
+    
+    json_tokenizer_reset(&t, json_reader_string("null!"));
+    JSON_TEST_ASSERT(!json_tokenizer_next(&t));
+    JSON_TEST_ASSERT(t.error == JSON_ERROR_UNEXPECTED_CHARACTER);
+    json_tokenizer_free(&t);
+    
     JSON_MEMBLOCKS_CHECK;
     JSON_TEST_DONE;
 }
 
-/* Tokenizer - testing data hijacking and unexpected character. */
+/* Tokenizer - token hijacking test. */
 static bool test_tokenizer_5(void) {
     JSON_TEST_START;
-    char * json = "hijack me!";
+    char * json = "\"hijack\" me!"; // symbols aren't stored, so a string is hijacked
     json_tokenizer t;
     json_tokenizer_init(&t, json_reader_string(json));
     bool ok;
     
     ok = json_tokenizer_next(&t);
     JSON_TEST_ASSERT(ok);
-    JSON_TEST_ASSERT(t.token.type == JSON_TOKEN_SYMBOL);
+    JSON_TEST_ASSERT(t.token.type == JSON_TOKEN_STRING);
     JSON_TEST_ASSERT(strcmp(t.token.data.string.data, "hijack") == 0);
     char * string = json_token_hijack(&t.token);
-    JSON_TEST_ASSERT(strcmp(string, "hijack") == 0);
+    JSON_TEST_ASSERT(strcmp(string, "hijack") == 0 && t.token.data.string.length == 6);
+    JSON_TEST_ASSERT(t.token.data.string.data == NULL); // the copy is the caller's
     json_token_free(&t.token);
-    free(string); JSON_DEBUG_FREE;
     
     ok = json_tokenizer_next(&t); // should fail on !
     JSON_TEST_ASSERT(ok == false);
+    JSON_TEST_ASSERT(strcmp(string, "hijack") == 0); // the scratch buffer was reused
+    free(string); JSON_DEBUG_FREE;
+    json_tokenizer_free(&t);
     
     JSON_MEMBLOCKS_CHECK;
     JSON_TEST_DONE;
@@ -245,6 +404,7 @@ static bool test_tokenizer_6(void) {
             break;
         }
     }
+    json_tokenizer_free(&t);
     
     JSON_MEMBLOCKS_CHECK;
     JSON_TEST_DONE;
@@ -291,6 +451,7 @@ static bool test_tokenizer_7(void) {
             break;
         }
     }
+    json_tokenizer_free(&t);
     
     JSON_MEMBLOCKS_CHECK;
     JSON_TEST_DONE;
@@ -307,6 +468,7 @@ static bool test_tokenizer_8(void) {
     for (int i = 0; i < 7; i++) {
         json_tokenizer_init(&t, json_reader_string(json[i]));
         bool ok = json_tokenizer_next(&t);
+        json_tokenizer_free(&t);
         JSON_TEST_ASSERT(ok == false);
     }
     
@@ -346,6 +508,7 @@ static bool test_tokenizer_9(void) {
         
         json_token_free(&t.token);
     }
+    json_tokenizer_free(&t);
     
     JSON_MEMBLOCKS_CHECK;
     JSON_TEST_DONE;
@@ -367,6 +530,64 @@ static bool test_tokenizer_10(void) {
     JSON_TEST_ASSERT(strcmp(t.token.data.string.data, str) == 0);
     
     json_token_free(&t.token);
+    json_tokenizer_free(&t);
+    
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Tokenizer - skipping values. */
+static bool test_tokenizer_11(void) {
+    JSON_TEST_START;
+    char * json = "[ {\"blob\": [1, \"]}\\\"\", {\"x\": null}]}, \"string \\\\\", -12.5e3,true,[], 7 ]";
+    json_tokenizer t;
+    json_tokenizer_init(&t, json_reader_string(json));
+    
+    JSON_TEST_ASSERT(json_tokenizer_next(&t) && t.token.type == JSON_TOKEN_BRACKET_OPENING);
+    for (int i = 0; i < 5; i++) {
+        JSON_TEST_ASSERT(json_tokenizer_skip(&t));
+        JSON_TEST_ASSERT(t.token.type == JSON_TOKEN_UNKNOWN);
+#ifdef JSON_DEBUG
+        JSON_TEST_ASSERT(json_debug_memblocks == (t.scratch != NULL)); // only the scratch buffer
+#endif
+        JSON_TEST_ASSERT(json_tokenizer_next(&t) && t.token.type == JSON_TOKEN_COMMA);
+    }
+    JSON_TEST_ASSERT(json_tokenizer_next(&t) && t.token.type == JSON_TOKEN_INTEGER);
+    JSON_TEST_ASSERT(t.token.data.intValue == 7);
+    JSON_TEST_ASSERT(json_tokenizer_skip(&t) && t.token.type == JSON_TOKEN_BRACKET_CLOSING);
+    JSON_TEST_ASSERT(json_tokenizer_next(&t) && t.token.type == JSON_TOKEN_EOF);
+    
+    json_tokenizer_reset(&t, json_reader_string("[1, [2, 3"));
+    JSON_TEST_ASSERT(json_tokenizer_next(&t) && t.token.type == JSON_TOKEN_BRACKET_OPENING);
+    JSON_TEST_ASSERT(json_tokenizer_skip(&t));
+    JSON_TEST_ASSERT(json_tokenizer_next(&t) && t.token.type == JSON_TOKEN_COMMA);
+    JSON_TEST_ASSERT(json_tokenizer_skip(&t) == false);
+    JSON_TEST_ASSERT(t.error == JSON_ERROR_UNEXPECTED_EOF);
+    json_tokenizer_free(&t);
+    
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Tokenizer - literals read from a window. */
+static bool test_tokenizer_12(void) {
+    JSON_TEST_START;
+    test_source source = {"[true,false,null,nul", 100};
+    json_reader reader = json_reader_buffered(test_sourceRead, &source, 13); // "null" crosses the block boundary
+    json_tokenizer t;
+    json_tokenizer_init(&t, reader);
+    
+    json_tokenType expected[] = { JSON_TOKEN_BRACKET_OPENING, JSON_TOKEN_BOOL, JSON_TOKEN_COMMA, JSON_TOKEN_BOOL, JSON_TOKEN_COMMA, JSON_TOKEN_NULL, JSON_TOKEN_COMMA };
+    for (int i = 0; i < 7; i++) {
+        JSON_TEST_ASSERT(json_tokenizer_next(&t));
+        JSON_TEST_ASSERT(t.token.type == expected[i]);
+        JSON_TEST_ASSERT(i != 2 || t.pos == 7); // the literal after the comma doesn't move its position
+    }
+    JSON_TEST_ASSERT(t.bytes == 18); // including the first character of the next token
+    JSON_TEST_ASSERT(json_tokenizer_next(&t)); // incomplete literal
+    JSON_TEST_ASSERT(t.token.type == JSON_TOKEN_SYMBOL);
+    json_tokenizer_free(&t);
+    json_reader_free(&reader);
     
     JSON_MEMBLOCKS_CHECK;
     JSON_TEST_DONE;
@@ -704,6 +925,433 @@ static bool test_object_10(void) {
     JSON_TEST_DONE;
 }
 
+/* Deep copy test. */
+static bool test_object_11(void) {
+    JSON_TEST_START;
+    
+    json_object * obj = json_parse_string("{\"name\": \"Martin\", \"list\": [1, 2.5, true, null, {\"nested\": \"map\"}]}", NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    
+    json_object * clone = json_object_clone(obj);
+    JSON_TEST_ASSERT(clone != obj);
+    JSON_TEST_ASSERT(clone->type == JSON_OBJECT_MAP);
+    JSON_TEST_ASSERT(json_map_size(clone) == 2);
+    JSON_TEST_ASSERT(json_map_hashtable_size(clone) == json_map_hashtable_size(obj));
+    JSON_TEST_ASSERT(json_map_get(clone, "name") != json_map_get(obj, "name"));
+    JSON_TEST_ASSERT(strcmp(json_string_value(json_map_get(clone, "name")), "Martin") == 0);
+    
+    json_object * list = json_map_get(clone, "list");
+    JSON_TEST_ASSERT(list != json_map_get(obj, "list"));
+    JSON_TEST_ASSERT(json_array_size(list) == 5);
+    JSON_TEST_ASSERT(json_int_value(json_array_get(list, 0)) == 1);
+    JSON_TEST_ASSERT(json_float_value(json_array_get(list, 1)) == 2.5);
+    JSON_TEST_ASSERT(json_bool_value(json_array_get(list, 2)) == true);
+    JSON_TEST_ASSERT(json_array_get(list, 3)->type == JSON_OBJECT_NULL);
+    JSON_TEST_ASSERT(strcmp(json_string_value(json_map_get(json_array_get(list, 4), "nested")), "map") == 0);
+    
+    json_object_free(obj);
+    json_object_free(clone);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static void * test_referenceThread(void * arg) {
+    for (int i = 0; i < 10000; i++) {
+        json_object * reference = json_object_reference(arg);
+        json_object_free(reference);
+    }
+    return NULL;
+}
+
+/* Copy-on-write update test. */
+static bool test_object_12(void) {
+    JSON_TEST_START;
+    
+    json_object * obj = json_parse_string("{\"a\": {\"b\": [1, 2, 3], \"c\": \"untouched\"}, \"d\": [4, 5]}", NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    
+    const char * path1[] = { "a", "b", "1" };
+    json_object * v1 = json_object_set_path(obj, path1, 3, json_int(20));
+    JSON_TEST_ASSERT(v1 != NULL && v1 != obj);
+    JSON_TEST_ASSERT(json_int_value(json_array_get(json_map_get(json_map_get(obj, "a"), "b"), 1)) == 2);
+    JSON_TEST_ASSERT(json_int_value(json_array_get(json_map_get(json_map_get(v1, "a"), "b"), 1)) == 20);
+    JSON_TEST_ASSERT(json_map_get(v1, "a") != json_map_get(obj, "a"));
+    JSON_TEST_ASSERT(json_map_get(v1, "d") == json_map_get(obj, "d")); // shared subtrees
+    JSON_TEST_ASSERT(json_map_get(json_map_get(v1, "a"), "c") == json_map_get(json_map_get(obj, "a"), "c"));
+    JSON_TEST_ASSERT(json_array_get(json_map_get(json_map_get(v1, "a"), "b"), 0) == json_array_get(json_map_get(json_map_get(obj, "a"), "b"), 0));
+    
+    const char * path2[] = { "d", "-" };
+    json_object * v2 = json_object_set_path(v1, path2, 2, json_int(6));
+    JSON_TEST_ASSERT(v2 != NULL);
+    JSON_TEST_ASSERT(json_array_size(json_map_get(v1, "d")) == 2);
+    JSON_TEST_ASSERT(json_array_size(json_map_get(v2, "d")) == 3);
+    JSON_TEST_ASSERT(json_map_get(v2, "a") == json_map_get(v1, "a"));
+    
+    const char * path3[] = { "x", "y" };
+    json_object * v3 = json_object_set_path(v2, path3, 2, json_string("new"));
+    JSON_TEST_ASSERT(v3 != NULL);
+    JSON_TEST_ASSERT(strcmp(json_string_value(json_map_get(json_map_get(v3, "x"), "y")), "new") == 0);
+    JSON_TEST_ASSERT(json_map_get(v2, "x") == NULL);
+    
+    const char * invalid1[] = { "a", "c", "z" };
+    const char * invalid2[] = { "d", "01" };
+    const char * invalid3[] = { "d", "5" };
+    json_object * value = json_null();
+    JSON_TEST_ASSERT(json_object_set_path(v3, invalid1, 3, value) == NULL);
+    JSON_TEST_ASSERT(json_object_set_path(v3, invalid2, 2, value) == NULL);
+    JSON_TEST_ASSERT(json_object_set_path(v3, invalid3, 2, value) == NULL);
+    json_object_free(value);
+    
+    // the versions share the subtrees between threads
+    pthread_t threads[4];
+    json_object * shared = json_map_get(v3, "d");
+    for (int i = 0; i < 4; i++) pthread_create(&threads[i], NULL, test_referenceThread, shared);
+    for (int i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+    JSON_TEST_ASSERT(shared->_private.refs == 2); // v2 and v3
+    
+    json_object_free(obj);
+    json_object_free(v1);
+    json_object_free(v2);
+    json_object_free(v3);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* String length test. */
+static bool test_object_13(void) {
+    JSON_TEST_START;
+    
+    json_object * obj = json_parse_string("[\"\", \"abc\", \"a\\u00e1\\n\"]", NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_string_length(json_array_get(obj, 0)) == 0);
+    JSON_TEST_ASSERT(json_string_length(json_array_get(obj, 1)) == 3);
+    JSON_TEST_ASSERT(json_string_length(json_array_get(obj, 2)) == 4);
+    
+    json_object * copy = json_object_clone(obj);
+    JSON_TEST_ASSERT(json_string_length(json_array_get(copy, 2)) == 4);
+    
+    json_object * str = json_string("hello");
+    JSON_TEST_ASSERT(json_string_length(str) == 5);
+    
+    json_object_free(obj);
+    json_object_free(copy);
+    json_object_free(str);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Capacity reservation test. */
+static bool test_object_14(void) {
+    JSON_TEST_START;
+    
+    json_object * array = json_array_ext(100);
+    JSON_TEST_ASSERT(array->json_array.capacity == 100);
+    json_array_reserve(array, 50); // no shrinking
+    JSON_TEST_ASSERT(array->json_array.capacity == 100);
+    json_array_reserve(array, 200);
+    JSON_TEST_ASSERT(array->json_array.capacity == 200);
+    
+    json_object * items[300];
+    for (int i = 0; i < 300; i++) items[i] = json_int(i);
+    json_array_add(array, items[0]);
+    json_array_add_n(array, items + 1, 199);
+    JSON_TEST_ASSERT(json_array_size(array) == 200 && array->json_array.capacity == 200);
+    json_array_add_n(array, items + 200, 100);
+    JSON_TEST_ASSERT(json_array_size(array) == 300 && array->json_array.capacity == 400);
+    json_array_add_n(array, items, 0);
+    for (int i = 0; i < 300; i++) JSON_TEST_ASSERT(json_int_value(json_array_get(array, i)) == i);
+    json_object_free(array);
+    
+    json_object * map = json_map_ext(100);
+    int hashtableSize = json_map_hashtable_size(map);
+    JSON_TEST_ASSERT(hashtableSize / 2 >= 100);
+    char key[16];
+    for (int i = 0; i < 100; i++) {
+        sprintf(key, "key%d", i);
+        json_map_put(map, key, json_int(i));
+    }
+    JSON_TEST_ASSERT(json_map_hashtable_size(map) == hashtableSize); // no rehashing
+    
+    json_map_reserve(map, 1000);
+    JSON_TEST_ASSERT(json_map_hashtable_size(map) / 2 >= 1000);
+    JSON_TEST_ASSERT(json_map_size(map) == 100);
+    for (int i = 0; i < 100; i++) {
+        sprintf(key, "key%d", i);
+        JSON_TEST_ASSERT(json_int_value(json_map_get(map, key)) == i);
+    }
+    hashtableSize = json_map_hashtable_size(map);
+    json_map_reserve(map, 10);
+    JSON_TEST_ASSERT(json_map_hashtable_size(map) == hashtableSize);
+    json_object_free(map);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static void * test_boxingThread(void * arg) {
+    json_object * array = arg;
+    for (int i = json_array_size(array) - 1; i >= 0; i--) {
+        if (json_int_value(json_array_get(array, i)) != i) return arg;
+    }
+    return NULL;
+}
+
+/* Packed numeric arrays test. */
+static bool test_object_15(void) {
+    JSON_TEST_START;
+    
+    const char * input = "[[1, 2, 3], [1.5, -2.5], [1, 2.5], [1, \"a\"], []]";
+    json_object * obj = json_parse_string(input, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_array_numbers(json_array_get(obj, 0)).type == JSON_OBJECT_NULL); // not packed by default
+    json_object_free(obj);
+    
+    json_parser parser;
+    json_parser_options options = { .packNumbers = true };
+    json_parser_init_ext(&parser, &options);
+    obj = json_parser_parse(&parser, input, strlen(input), NULL);
+    json_parser_free(&parser);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_array_numbers(obj).type == JSON_OBJECT_NULL);
+    
+    json_object * ints = json_array_get(obj, 0);
+    json_numbers numbers = json_array_numbers(ints);
+    JSON_TEST_ASSERT(numbers.type == JSON_OBJECT_INT && numbers.size == 3);
+    JSON_TEST_ASSERT(numbers.data.ints[0] == 1 && numbers.data.ints[2] == 3);
+    
+    json_object scratch;
+    JSON_TEST_ASSERT(json_int_value(json_array_peek(ints, 2, &scratch)) == 3);
+    JSON_TEST_ASSERT(json_array_peek(ints, 3, &scratch) == NULL);
+    
+    numbers = json_array_numbers(json_array_get(obj, 1));
+    JSON_TEST_ASSERT(numbers.type == JSON_OBJECT_FLOAT && numbers.size == 2 && numbers.data.floats[1] == -2.5);
+    
+    json_object * mixed = json_array_get(obj, 2);
+    JSON_TEST_ASSERT(json_array_numbers(mixed).type == JSON_OBJECT_NULL);
+    JSON_TEST_ASSERT(json_array_get(mixed, 0)->type == JSON_OBJECT_INT);
+    JSON_TEST_ASSERT(json_float_value(json_array_get(mixed, 1)) == 2.5);
+    JSON_TEST_ASSERT(json_array_numbers(json_array_get(obj, 3)).type == JSON_OBJECT_NULL);
+    JSON_TEST_ASSERT(json_array_numbers(json_array_get(obj, 4)).type == JSON_OBJECT_NULL);
+    
+    // boxing on demand doesn't change the numbers
+    const int * data = json_array_numbers(ints).data.ints;
+    json_object * boxed = json_array_get(ints, 1);
+    JSON_TEST_ASSERT(json_int_value(boxed) == 2);
+    JSON_TEST_ASSERT(json_array_get(ints, 1) == boxed); // cached
+    numbers = json_array_numbers(ints);
+    JSON_TEST_ASSERT(numbers.type == JSON_OBJECT_INT && numbers.data.ints == data && numbers.data.ints[1] == 2);
+    
+    // copies have their own numbers, the source isn't boxed
+    json_object * clone = json_object_clone(ints);
+    json_object * copy = json_object_copy(json_array_get(obj, 1));
+    JSON_TEST_ASSERT(json_array_numbers(clone).type == JSON_OBJECT_INT);
+    JSON_TEST_ASSERT(json_int_value(json_array_peek(clone, 2, &scratch)) == 3);
+    JSON_TEST_ASSERT(json_array_numbers(copy).type == JSON_OBJECT_FLOAT);
+    JSON_TEST_ASSERT(json_array_numbers(copy).data.floats != json_array_numbers(json_array_get(obj, 1)).data.floats);
+    JSON_TEST_ASSERT(json_array_get(obj, 1)->json_array.items == NULL);
+    json_object_free(clone);
+    json_object_free(copy);
+    
+    // changing a version doesn't touch the packed numbers of the original
+    const char * path[] = { "0", "2" };
+    json_object * version = json_object_set_path(obj, path, 2, json_int(30));
+    JSON_TEST_ASSERT(json_int_value(json_array_get(json_array_get(version, 0), 2)) == 30);
+    JSON_TEST_ASSERT(json_array_numbers(ints).data.ints == data && data[2] == 3);
+    json_object_free(version);
+    
+    // adding to an array with boxed items unpacks it, the boxes are kept
+    json_array_add_int(ints, 4);
+    JSON_TEST_ASSERT(json_array_numbers(ints).type == JSON_OBJECT_NULL);
+    JSON_TEST_ASSERT(json_array_get(ints, 1) == boxed);
+    JSON_TEST_ASSERT(json_int_value(json_array_get(ints, 3)) == 4);
+    json_object_free(obj);
+    
+    // builder
+    json_object * array = json_object_new(JSON_OBJECT_ARRAY);
+    json_array_init_packed(array, JSON_OBJECT_FLOAT, 1);
+    for (int i = 0; i < 100; i++) json_array_add_float(array, i / 2.0);
+    numbers = json_array_numbers(array);
+    JSON_TEST_ASSERT(numbers.type == JSON_OBJECT_FLOAT && numbers.size == 100 && numbers.data.floats[99] == 49.5);
+    json_array_add(array, json_string("end"));
+    JSON_TEST_ASSERT(json_array_numbers(array).type == JSON_OBJECT_NULL);
+    JSON_TEST_ASSERT(json_array_size(array) == 101);
+    JSON_TEST_ASSERT(json_float_value(json_array_get(array, 99)) == 49.5);
+    JSON_TEST_ASSERT(strcmp(json_string_value(json_array_get(array, 100)), "end") == 0);
+    json_object_free(array);
+    
+    // boxing from several threads
+    array = json_object_new(JSON_OBJECT_ARRAY);
+    json_array_init_packed(array, JSON_OBJECT_INT, 1000);
+    for (int i = 0; i < 1000; i++) json_array_add_int(array, i);
+    pthread_t threads[4];
+    void * results[4];
+    for (int i = 0; i < 4; i++) pthread_create(&threads[i], NULL, test_boxingThread, array);
+    for (int i = 0; i < 4; i++) pthread_join(threads[i], &results[i]);
+    for (int i = 0; i < 4; i++) JSON_TEST_ASSERT(results[i] == NULL);
+    JSON_TEST_ASSERT(json_array_numbers(array).type == JSON_OBJECT_INT);
+    json_object_free(array);
+    
+    array = json_array();
+    json_array_add_int(array, 1);
+    JSON_TEST_ASSERT(json_array_numbers(array).type == JSON_OBJECT_NULL); // regular arrays stay regular
+    JSON_TEST_ASSERT(json_int_value(json_array_get(array, 0)) == 1);
+    json_object_free(array);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Key hashing test. */
+static bool test_object_16(void) {
+    JSON_TEST_START;
+    
+    JSON_TEST_ASSERT(json_map_hash("key") == json_map_hash_len("key", 3));
+    JSON_TEST_ASSERT(json_map_hash("") == json_map_hash_len("", 0));
+    
+    // keys of all lengths (short, medium and long paths of the hash)
+    json_object * map = json_map();
+    char key[128];
+    for (int i = 0; i < 100; i++) {
+        memset(key, 'a' + i % 26, i);
+        key[i] = '\0';
+        json_map_put(map, key, json_int(i));
+    }
+    JSON_TEST_ASSERT(json_map_size(map) == 100);
+    for (int i = 0; i < 100; i++) {
+        memset(key, 'a' + i % 26, i);
+        key[i] = '\0';
+        JSON_TEST_ASSERT(json_int_value(json_map_get(map, key)) == i);
+    }
+    json_object_free(map);
+    
+    // similar keys are spread evenly
+    map = json_map();
+    for (int i = 0; i < 4096; i++) {
+        sprintf(key, "item%d", i);
+        json_map_put(map, key, json_null());
+    }
+    JSON_TEST_ASSERT(json_map_hashtable_size(map) == 8192);
+    JSON_TEST_ASSERT(json_map_hashtable_collisions(map) < 4096 / 3);
+    json_object_free(map);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Map insertion order test. */
+static bool test_object_17(void) {
+    JSON_TEST_START;
+    
+    // the items are iterated in the insertion order, also after rehashing
+    json_object * map = json_map();
+    char key[16];
+    for (int i = 0; i < 1000; i++) {
+        sprintf(key, "k%d", (i * 7919) % 1000);
+        json_map_put(map, key, json_int(i));
+    }
+    json_object * oldValue = json_map_put(map, "k0", json_int(-1)); // the replaced item keeps its position
+    JSON_TEST_ASSERT(json_int_value(oldValue) == 0);
+    json_object_free(oldValue);
+    json_object * clone = json_object_clone(map);
+    
+    for (int copy = 0; copy < 2; copy++) {
+        json_map_iterator iterator;
+        json_map_iterator_init(&iterator, copy ? clone : map);
+        for (int i = 0; i < 1000; i++) {
+            JSON_TEST_ASSERT(json_map_iterator_next(&iterator));
+            sprintf(key, "k%d", (i * 7919) % 1000);
+            JSON_TEST_ASSERT(strcmp(iterator.key, key) == 0);
+            JSON_TEST_ASSERT(json_int_value(iterator.value) == (i == 0 ? -1 : i));
+        }
+        JSON_TEST_ASSERT(!json_map_iterator_next(&iterator));
+    }
+    json_object_free(map);
+    json_object_free(clone);
+    
+    // parsed maps keep the order of the source
+    const char * input = "{\"z\": 1, \"a\": 2, \"m\": 3, \"a\": 4, \"b\": 5}";
+    const char * keys[] = { "z", "a", "m", "b" };
+    json_parser_options options = { .arenaBlockSize = 1024 };
+    json_parser parser;
+    json_parser_init_ext(&parser, &options);
+    json_object * parsed[] = {
+        json_parse_string(input, NULL), json_parser_parse(&parser, input, strlen(input), NULL)
+    };
+    for (int i = 0; i < 2; i++) {
+        json_map_iterator iterator;
+        json_map_iterator_init(&iterator, parsed[i]);
+        for (int k = 0; json_map_iterator_next(&iterator); k++) JSON_TEST_ASSERT(strcmp(iterator.key, keys[k]) == 0);
+        JSON_TEST_ASSERT(json_int_value(json_map_get(parsed[i], "a")) == 4);
+        json_object_free(parsed[i]);
+    }
+    json_parser_free(&parser);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Batch map lookup test. */
+static bool test_object_18(void) {
+    JSON_TEST_START;
+    
+    // the batch lookup finds the same values as json_map_get, in small and large maps
+    const char * names[] = { "id", "name", "missing", "k7", "age", "k999", "k1000", "", "k0", "k512" };
+    json_map_key keys[10];
+    for (int i = 0; i < 10; i++) keys[i] = json_map_key_compile(names[i]);
+    JSON_TEST_ASSERT(keys[1].length == 4 && keys[1].hash == json_map_hash("name"));
+    
+    for (int items = 0; items <= 1000; items += 250) {
+        json_object * map = json_map();
+        json_map_put(map, "id", json_int(1));
+        json_map_put(map, "name", json_string("x"));
+        json_map_put(map, "age", json_int(30));
+        char key[16];
+        for (int i = 0; i < items; i++) {
+            sprintf(key, "k%d", i);
+            json_map_put(map, key, json_int(i));
+        }
+        
+        json_object * values[10];
+        for (int n = 0; n <= 10; n++) {
+            json_map_get_many(map, keys, n, values);
+            for (int i = 0; i < n; i++) JSON_TEST_ASSERT(values[i] == json_map_get(map, names[i]));
+        }
+        JSON_TEST_ASSERT(values[0] != NULL && values[2] == NULL && values[7] == NULL);
+        JSON_TEST_ASSERT((values[5] != NULL) == (items == 1000));
+        json_object_free(map);
+    }
+    
+    // the stored key lengths are compared, they survive parsing and copying
+    json_object * parsed = json_parse_string("{\"name\": 1, \"nam\": 2}", NULL);
+    json_object * copy = json_object_copy(parsed);
+    json_map_key prefix = keys[1];
+    prefix.length = 3; // the hash of "name" with the length of "nam"
+    json_object * values[2];
+    json_map_get_many(copy, &prefix, 1, values);
+    JSON_TEST_ASSERT(values[0] == NULL);
+    json_map_get_many(copy, keys, 2, values);
+    JSON_TEST_ASSERT(json_int_value(values[1]) == 1);
+    json_map_iterator iterator;
+    json_map_iterator_init(&iterator, copy);
+    while (json_map_iterator_next(&iterator)) JSON_TEST_ASSERT(iterator.length == strlen(iterator.key));
+    json_object_free(copy);
+    json_object_free(parsed);
+
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
 /* Empty JSON test. */
 static bool test_parser_1(void) {
     JSON_TEST_START;
@@ -849,63 +1497,408 @@ static bool test_parser_7(void) {
     JSON_TEST_DONE;
 }
 
-static bool test_parser_error_1(void) {
+/* Empty containers test. */
+static bool test_parser_8(void) {
     JSON_TEST_START;
     
+    json_object * obj = json_parse_string("{\"empty map\": {}, \"empty array\": [], \"nested\": [[], {}]}", NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_map_size(json_map_get(obj, "empty map")) == 0);
+    JSON_TEST_ASSERT(json_array_size(json_map_get(obj, "empty array")) == 0);
+    JSON_TEST_ASSERT(json_array_size(json_map_get(obj, "nested")) == 2);
+    json_object_free(obj);
+    
     json_error err = JSON_ERROR_EMPTY;
-    json_object * obj = json_parse_string("[1, 2, 3] some garbage!", &err);
-    JSON_TEST_ASSERT(obj == NULL);
-    JSON_TEST_ASSERT(err.code == JSON_ERROR_GARBAGE);
+    JSON_TEST_ASSERT(json_parse_string("[1, ]", &err) == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_UNRESOLVED_TOKEN);
+    JSON_TEST_ASSERT(json_parse_string("{\"key\": 1, }", &err) == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_EXPECTED_STRING);
     
     JSON_OBJECTS_CHECK;
     JSON_MEMBLOCKS_CHECK;
     JSON_TEST_DONE;
 }
 
-static bool test_parser_error_2(void) {
+/* Presized containers test. */
+static bool test_parser_9(void) {
     JSON_TEST_START;
     
-    json_error err = JSON_ERROR_EMPTY;
-    json_object * obj = json_parse_string("{ invalid_key: true }", &err);
-    JSON_TEST_ASSERT(obj == NULL);
-    JSON_TEST_ASSERT(err.code == JSON_ERROR_EXPECTED_STRING);
+    json_object * obj = json_parse_string_ext("{\"list\": [1, \"a,b]\", \"\\\"[\", [], [{}], {\"x\": [1, 2, 3]}], "
+            "\"a\": 1, \"b\": 2, \"c\": 3, \"d\": 4}", true, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_map_size(obj) == 5);
+    JSON_TEST_ASSERT(json_map_hashtable_size(obj) == 16); // no rehashing
+    
+    json_object * list = json_map_get(obj, "list");
+    JSON_TEST_ASSERT(json_array_size(list) == 6);
+    JSON_TEST_ASSERT(list->json_array.capacity == 6);
+    JSON_TEST_ASSERT(strcmp(json_string_value(json_array_get(list, 1)), "a,b]") == 0);
+    JSON_TEST_ASSERT(json_array_size(json_array_get(list, 3)) == 0);
+    JSON_TEST_ASSERT(json_array_get(list, 4)->json_array.capacity == 1);
+    JSON_TEST_ASSERT(json_map_get(json_array_get(list, 5), "x")->json_array.capacity == 3);
+    json_object_free(obj);
+    
+    // large arrays are allocated once
+    char * string = malloc(3*1000 + 3);
+    char * p = string;
+    *p++ = '[';
+    for (int i = 0; i < 1000; i++) {
+        if (i > 0) *p++ = ',';
+        *p++ = '1';
+    }
+    *p++ = ']';
+    *p = '\0';
+    obj = json_parse_string_ext(string, true, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_array_size(obj) == 1000 && obj->json_array.capacity == 1000);
+    json_object_free(obj);
+    
+    // small strings aren't pre-scanned by default
+    obj = json_parse_string(string, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_array_size(obj) == 1000 && obj->json_array.capacity == 1024);
+    json_object_free(obj);
+    free(string);
+    
+    // invalid input still fails
+    json_error error;
+    JSON_TEST_ASSERT(json_parse_string_ext("[1, [2}, 3]", true, &error) == NULL);
+    JSON_TEST_ASSERT(json_parse_string_ext("{\"a\": [1, \"unterminated", true, &error) == NULL);
+    JSON_TEST_ASSERT(json_parse_string_ext("]]", true, &error) == NULL);
     
     JSON_OBJECTS_CHECK;
     JSON_MEMBLOCKS_CHECK;
     JSON_TEST_DONE;
 }
 
-static bool test_parser_error_3(void) {
+/* Reusable parser test. */
+static bool test_parser_10(void) {
     JSON_TEST_START;
     
-    json_error err = JSON_ERROR_EMPTY;
-    json_object * obj = json_parse_string("{ \"wrong map separator\", 42 }", &err);
-    JSON_TEST_ASSERT(obj == NULL);
-    JSON_TEST_ASSERT(err.code == JSON_ERROR_EXPECTED_COLON);
+    json_parser parser;
+    json_parser_init(&parser);
+    const char * input = "{\"key\": [1.5, -20, 3e2, \"a long string value, which is longer than the initial scratch buffer\"]} trailing";
+    size_t length = strchr(input, '}') + 1 - input; // not null-terminated
+    
+    json_object * obj = json_parser_parse(&parser, input, length, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_array_size(json_map_get(obj, "key")) == 4);
+    json_object_free(obj);
+    JSON_TEST_ASSERT(parser.tokenizer.scratch != NULL);
+    
+    // the scratch buffer is reused, only the strings of the result are allocated
+    json_stats stats;
+    json_stats_begin(&stats);
+    obj = json_parser_parse(&parser, input, length, NULL);
+    json_stats_end();
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(stats.strings == 2);
+    JSON_TEST_ASSERT(strcmp(json_string_value(json_array_get(json_map_get(obj, "key"), 3)), "a long string value, which is longer than the initial scratch buffer") == 0);
+    json_object_free(obj);
+    
+    // errors don't break the parser
+    json_error error;
+    JSON_TEST_ASSERT(json_parser_parse(&parser, input, strlen(input), &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_GARBAGE);
+    JSON_TEST_ASSERT(json_parser_parse(&parser, "[\"open", 6, &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_STR_UNEXPECTED_EOF);
+    obj = json_parser_parse(&parser, "true", 4, NULL);
+    JSON_TEST_ASSERT(obj != NULL && json_bool_value(obj));
+    json_object_free(obj);
+    json_parser_free(&parser);
     
     JSON_OBJECTS_CHECK;
     JSON_MEMBLOCKS_CHECK;
     JSON_TEST_DONE;
 }
 
-static bool test_parser_error_4(void) {
+/* Reusable parser with an arena and interned keys. */
+static bool test_parser_11(void) {
     JSON_TEST_START;
     
-    json_error err = JSON_ERROR_EMPTY;
-    json_object * obj = json_parse_string("{ \"key\": \"value\"; \"unexpected\": \"semicolon\" }", &err);
-    JSON_TEST_ASSERT(obj == NULL);
-    JSON_TEST_ASSERT(err.code == JSON_ERROR_UNEXPECTED_CHARACTER);
+    json_parser_options options = { .arenaBlockSize = 1024, .internedKeys = 16 };
+    json_parser parser;
+    json_parser_init_ext(&parser, &options);
+    const char * input = "{\"id\": 7, \"tags\": [\"a\", \"b\"], \"pos\": [1.5, 2], \"id\": 8, \"nested\": {\"id\": null, \"ok\": true}}";
+    
+    json_object * obj = json_parser_parse(&parser, input, strlen(input), NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_map_size(obj) == 4);
+    JSON_TEST_ASSERT(json_int_value(json_map_get(obj, "id")) == 8); // the last duplicate wins
+    JSON_TEST_ASSERT(strcmp(json_string_value(json_array_get(json_map_get(obj, "tags"), 1)), "b") == 0);
+    JSON_TEST_ASSERT(json_float_value(json_array_get(json_map_get(obj, "pos"), 0)) == 1.5f);
+    JSON_TEST_ASSERT(json_map_get(json_map_get(obj, "nested"), "ok")->json_bool.value == true);
+    json_object * clone = json_object_clone(obj); // clones are allocated normally
+    json_object_free(obj); // does nothing
+    
+    // the next parses reuse the arena, the stacks and the interned keys
+#ifdef JSON_DEBUG
+    int memblocks = json_debug_memblocks;
+#endif
+    for (int i = 0; i < 10; i++) {
+        obj = json_parser_parse(&parser, input, strlen(input), NULL);
+        JSON_TEST_ASSERT(obj != NULL);
+#ifdef JSON_DEBUG
+        JSON_TEST_ASSERT(json_debug_memblocks == memblocks);
+#endif
+    }
+    char * id = NULL;
+    json_map_iterator iterator;
+    json_map_iterator_init(&iterator, json_map_get(obj, "nested"));
+    while (json_map_iterator_next(&iterator)) if (strcmp(iterator.key, "id") == 0) id = iterator.key;
+    JSON_TEST_ASSERT(id != NULL);
+    json_map_iterator_init(&iterator, obj);
+    while (json_map_iterator_next(&iterator)) if (strcmp(iterator.key, "id") == 0) JSON_TEST_ASSERT(iterator.key == id); // stored once
+    
+    // errors
+    json_error error;
+    JSON_TEST_ASSERT(json_parser_parse(&parser, "{\"a\": [1, 2}", 12, &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET);
+    JSON_TEST_ASSERT(json_parser_parse(&parser, "{\"a\" 1}", 7, &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_EXPECTED_COLON);
+    JSON_TEST_ASSERT(json_parser_parse(&parser, "{\"a\": 1, }", 10, &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_EXPECTED_STRING);
+    JSON_TEST_ASSERT(json_parser_parse(&parser, "[1, [", 5, &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_UNEXPECTED_EOF);
+    
+    // deep nesting doesn't use the C stack (neither does freeing the arena)
+    int depth = 100000;
+    char * deep = malloc(2 * depth);
+    memset(deep, '[', depth);
+    memset(deep + depth, ']', depth);
+    obj = json_parser_parse(&parser, deep, 2 * depth, NULL);
+    JSON_TEST_ASSERT(obj != NULL && json_array_size(obj) == 1);
+    free(deep);
+    json_parser_free(&parser);
+    
+    // without an arena, the trees are owned by the caller and the containers have their final size
+    json_parser_init(&parser);
+    obj = json_parser_parse(&parser, input, strlen(input), NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_map_size(obj) == json_map_size(clone));
+    JSON_TEST_ASSERT(json_int_value(json_map_get(obj, "id")) == json_int_value(json_map_get(clone, "id")));
+    JSON_TEST_ASSERT(json_map_get(json_map_get(clone, "nested"), "id")->type == JSON_OBJECT_NULL);
+    JSON_TEST_ASSERT(json_map_get(obj, "tags")->json_array.capacity == 2);
+    JSON_TEST_ASSERT(json_array_numbers(json_map_get(obj, "pos")).type == JSON_OBJECT_NULL); // mixed numbers
+    json_object_free(obj);
+    JSON_TEST_ASSERT(json_parser_parse(&parser, "{\"a\": [\"x\", {\"b\": 1}, ", 22, &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_UNEXPECTED_EOF);
+
+    json_parser_free(&parser);
+    json_object_free(clone);
     
     JSON_OBJECTS_CHECK;
     JSON_MEMBLOCKS_CHECK;
     JSON_TEST_DONE;
 }
 
-static bool test_parser_error_5(void) {
+static bool test_parser_12(void) {
     JSON_TEST_START;
     
-    json_error err = JSON_ERROR_EMPTY;
-    json_object * obj = json_parse_string("{ \"key\": \"value\", \"unfinished\": \"map\", ", &err);
+    const char * input = "{\"a\": 1}{\"b\": [2]}\n[3] 4 \"x\"true";
+    json_document_iterator iterator;
+    json_reader reader = json_reader_string(input);
+    json_document_iterator_init(&iterator, reader, NULL);
+    JSON_TEST_ASSERT(json_document_iterator_next(&iterator));
+    JSON_TEST_ASSERT(iterator.index == 0);
+    JSON_TEST_ASSERT(json_int_value(json_map_get(iterator.document, "a")) == 1);
+    json_object_free(iterator.document);
+    JSON_TEST_ASSERT(json_document_iterator_next(&iterator));
+    JSON_TEST_ASSERT(json_int_value(json_array_get(json_map_get(iterator.document, "b"), 0)) == 2);
+    json_object_free(iterator.document);
+    JSON_TEST_ASSERT(json_document_iterator_next(&iterator));
+    JSON_TEST_ASSERT(json_array_size(iterator.document) == 1);
+    json_object_free(iterator.document);
+    JSON_TEST_ASSERT(json_document_iterator_next(&iterator));
+    JSON_TEST_ASSERT(json_int_value(iterator.document) == 4);
+    json_object_free(iterator.document);
+    JSON_TEST_ASSERT(json_document_iterator_next(&iterator));
+    JSON_TEST_ASSERT(strcmp(json_string_value(iterator.document), "x") == 0);
+    json_object_free(iterator.document);
+    JSON_TEST_ASSERT(json_document_iterator_next(&iterator));
+    JSON_TEST_ASSERT(iterator.index == 5 && iterator.document->type == JSON_OBJECT_BOOL);
+    json_object_free(iterator.document);
+    JSON_TEST_ASSERT(!json_document_iterator_next(&iterator));
+    JSON_TEST_ASSERT(!iterator.failed && iterator.document == NULL);
+    JSON_TEST_ASSERT(!json_document_iterator_next(&iterator)); // the end is reported again
+    json_document_iterator_free(&iterator);
+    
+    // the same documents in a buffer, without the null terminator, in an arena
+    json_parser_options options = { .arenaBlockSize = 256, .internedKeys = 16 };
+    json_document_iterator_init_buffer(&iterator, input, strlen(input) - 2, &options);
+    int count = 0;
+    while (json_document_iterator_next(&iterator)) count++;
+    JSON_TEST_ASSERT(count == 5 && iterator.failed); // "tr" is an error
+    JSON_TEST_ASSERT(iterator.error.code == JSON_ERROR_UNRESOLVED_TOKEN);
+    json_document_iterator_free(&iterator);
+    
+    // the iteration stops at an invalid document
+    input = "[1] {\"a\" 2} [3]";
+    json_document_iterator_init_buffer(&iterator, input, strlen(input), NULL);
+    JSON_TEST_ASSERT(json_document_iterator_next(&iterator));
+    json_object_free(iterator.document);
+    JSON_TEST_ASSERT(!json_document_iterator_next(&iterator));
+    JSON_TEST_ASSERT(iterator.failed && iterator.error.code == JSON_ERROR_EXPECTED_COLON);
+    JSON_TEST_ASSERT(!json_document_iterator_next(&iterator));
+    json_document_iterator_free(&iterator);
+    
+    // no documents at all
+    json_document_iterator_init_buffer(&iterator, " \n ", 3, NULL);
+    JSON_TEST_ASSERT(!json_document_iterator_next(&iterator) && !iterator.failed);
+    json_document_iterator_free(&iterator);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Parses the input with the given handling of duplicate keys: recursively, with a parser, with a parser and an arena. */
+static json_object * test_parse_duplicates(const char * input, json_duplicate_keys duplicates, int mode, json_parser * parser, json_error * error) {
+    if (mode == 0) {
+        json_tokenizer tokenizer;
+        json_tokenizer_init(&tokenizer, json_reader_string(input));
+        tokenizer.duplicateKeys = duplicates;
+        json_object * obj = json_tokenizer_next(&tokenizer) ? json_parse_value(&tokenizer, error) : NULL;
+        json_tokenizer_free(&tokenizer);
+        return obj;
+    }
+    json_parser_options options = { .arenaBlockSize = mode == 2 ? 256 : 0, .internedKeys = 16, .duplicateKeys = duplicates };
+    json_parser_init_ext(parser, &options);
+    return json_parser_parse(parser, input, strlen(input), error);
+}
+
+/* Duplicate map keys test. */
+static bool test_parser_13(void) {
+    JSON_TEST_START;
+    
+    const char * input = "{\"a\": 1, \"b\": [2], \"a\": {\"x\": 3}, \"c\": \"s\", \"a\": \"last\"}";
+    const char * nested = "{\"o\": [1, {\"x\": [1, 2], \"y\": \"s\", \"x\": {}, \"z\": 4.5}, true]}";
+    for (int mode = 0; mode < 3; mode++) {
+        json_parser parser;
+        json_error error;
+        json_map_iterator iterator;
+        
+        // the last value wins, at the position of the first one
+        json_object * obj = test_parse_duplicates(input, JSON_DUPLICATE_LAST, mode, &parser, &error);
+        JSON_TEST_ASSERT(obj != NULL && json_map_size(obj) == 3);
+        JSON_TEST_ASSERT(strcmp(json_string_value(json_map_get(obj, "a")), "last") == 0);
+        json_map_iterator_init(&iterator, obj);
+        JSON_TEST_ASSERT(json_map_iterator_next(&iterator) && strcmp(iterator.key, "a") == 0);
+        json_object_free(obj);
+        if (mode > 0) json_parser_free(&parser);
+        
+        // the first value wins
+        obj = test_parse_duplicates(input, JSON_DUPLICATE_FIRST, mode, &parser, &error);
+        JSON_TEST_ASSERT(obj != NULL && json_map_size(obj) == 3);
+        JSON_TEST_ASSERT(json_int_value(json_map_get(obj, "a")) == 1);
+        json_object_free(obj);
+        if (mode > 0) json_parser_free(&parser);
+        
+        // all values are kept, the lookup finds the first one
+        obj = test_parse_duplicates(input, JSON_DUPLICATE_KEEP, mode, &parser, &error);
+        JSON_TEST_ASSERT(obj != NULL && json_map_size(obj) == 5);
+        JSON_TEST_ASSERT(json_int_value(json_map_get(obj, "a")) == 1);
+        JSON_TEST_ASSERT(strcmp(json_string_value(json_map_get(obj, "c")), "s") == 0);
+        const char * keys = "abaca";
+        json_map_iterator_init(&iterator, obj);
+        for (int i = 0; i < 5; i++) JSON_TEST_ASSERT(json_map_iterator_next(&iterator) && iterator.key[0] == keys[i]);
+        json_object_free(obj);
+        if (mode > 0) json_parser_free(&parser);
+        
+        // a duplicate is an error, also in a nested map (the rest of the tree is freed)
+        obj = test_parse_duplicates(input, JSON_DUPLICATE_ERROR, mode, &parser, &error);
+        JSON_TEST_ASSERT(obj == NULL && error.code == JSON_ERROR_DUPLICATE_KEY);
+        if (mode > 0) json_parser_free(&parser);
+        obj = test_parse_duplicates(nested, JSON_DUPLICATE_ERROR, mode, &parser, &error);
+        JSON_TEST_ASSERT(obj == NULL && error.code == JSON_ERROR_DUPLICATE_KEY);
+        JSON_TEST_ASSERT(error.pos == (mode == 0 ? 42 : 53)); // at the duplicate value or at the end of the map
+        if (mode > 0) json_parser_free(&parser);
+        
+        // unique keys pass with every policy
+        obj = test_parse_duplicates("{\"a\": 1, \"b\": {\"a\": 2}}", JSON_DUPLICATE_ERROR, mode, &parser, &error);
+        JSON_TEST_ASSERT(obj != NULL && json_map_size(obj) == 2);
+        json_object_free(obj);
+        if (mode > 0) json_parser_free(&parser);
+    }
+    
+    // trusted keys are appended without comparing them
+    json_arena arena;
+    json_arena_init(&arena, 0);
+    json_object * map = json_object_new_arena(&arena, JSON_OBJECT_MAP);
+    json_map_init_arena(map, &arena, 100);
+    const char * keys[] = { "a", "b", "c", "d" };
+    for (int i = 0; i < 100; i++) {
+        json_object * value = json_object_new_arena(&arena, JSON_OBJECT_INT);
+        value->json_int.value = i;
+        json_object * oldValue;
+        JSON_TEST_ASSERT(json_map_insert_arena(map, (char*)keys[i % 4], strlen(keys[i % 4]), json_map_hash(keys[i % 4]), value, JSON_DUPLICATE_TRUSTED, &oldValue));
+        JSON_TEST_ASSERT(oldValue == NULL);
+    }
+    JSON_TEST_ASSERT(json_map_size(map) == 100 && json_int_value(json_map_get(map, "d")) == 3);
+    json_arena_free(&arena);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static bool test_parser_error_1(void) {
+    JSON_TEST_START;
+    
+    json_error err = JSON_ERROR_EMPTY;
+    json_object * obj = json_parse_string("[1, 2, 3] some garbage!", &err);
+    JSON_TEST_ASSERT(obj == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_GARBAGE);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static bool test_parser_error_2(void) {
+    JSON_TEST_START;
+    
+    json_error err = JSON_ERROR_EMPTY;
+    json_object * obj = json_parse_string("{ invalid_key: true }", &err);
+    JSON_TEST_ASSERT(obj == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_EXPECTED_STRING);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static bool test_parser_error_3(void) {
+    JSON_TEST_START;
+    
+    json_error err = JSON_ERROR_EMPTY;
+    json_object * obj = json_parse_string("{ \"wrong map separator\", 42 }", &err);
+    JSON_TEST_ASSERT(obj == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_EXPECTED_COLON);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static bool test_parser_error_4(void) {
+    JSON_TEST_START;
+    
+    json_error err = JSON_ERROR_EMPTY;
+    json_object * obj = json_parse_string("{ \"key\": \"value\"; \"unexpected\": \"semicolon\" }", &err);
+    JSON_TEST_ASSERT(obj == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_UNEXPECTED_CHARACTER);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static bool test_parser_error_5(void) {
+    JSON_TEST_START;
+    
+    json_error err = JSON_ERROR_EMPTY;
+    json_object * obj = json_parse_string("{ \"key\": \"value\", \"unfinished\": \"map\", ", &err);
     JSON_TEST_ASSERT(obj == NULL);
     JSON_TEST_ASSERT(err.code == JSON_ERROR_UNEXPECTED_EOF);
     
@@ -1120,25 +2113,947 @@ static bool test_file_5(void) {
     JSON_TEST_DONE;
 }
 
+static const char * test_path_json = "{\"store\": {\"book\": ["
+        "{\"title\": \"Sayings\", \"price\": 8.95, \"author\": {\"name\": \"Rees\"}}, "
+        "{\"title\": \"Sword\", \"price\": 12.99, \"isbn\": \"0-553\"}, "
+        "{\"title\": \"Moby Dick\", \"price\": 8, \"isbn\": \"0-395\"}], "
+        "\"bicycle\": {\"color\": \"red\", \"price\": 19.95}, \"a/b\": 1, \"m~n\": 2}}";
+
+/* JSON Pointer test. */
+static bool test_path_1(void) {
+    JSON_TEST_START;
+    
+    json_object * obj = json_parse_string(test_path_json, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    
+    json_path * path = json_path_compile("/store/book/1/title", NULL);
+    JSON_TEST_ASSERT(path != NULL);
+    JSON_TEST_ASSERT(path->length == 4);
+    json_object * value = json_path_get(path, obj);
+    JSON_TEST_ASSERT(value != NULL && strcmp(json_string_value(value), "Sword") == 0);
+    json_path_free(path);
+    
+    path = json_path_compile("/store/a~1b", NULL);
+    JSON_TEST_ASSERT(json_int_value(json_path_get(path, obj)) == 1);
+    json_path_free(path);
+    
+    path = json_path_compile("/store/m~0n", NULL);
+    JSON_TEST_ASSERT(json_int_value(json_path_get(path, obj)) == 2);
+    json_path_free(path);
+    
+    path = json_path_compile("", NULL);
+    JSON_TEST_ASSERT(json_path_get(path, obj) == obj);
+    json_path_free(path);
+    
+    path = json_path_compile("/store/book/3", NULL);
+    JSON_TEST_ASSERT(json_path_get(path, obj) == NULL);
+    json_path_free(path);
+    
+    path = json_path_compile("/store/book/01", NULL);
+    JSON_TEST_ASSERT(json_path_get(path, obj) == NULL);
+    json_path_free(path);
+    
+    json_object_free(obj);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* JSONPath test. */
+static bool test_path_2(void) {
+    JSON_TEST_START;
+    
+    const char * expressions[] = {
+        "$.store.book[*].title", "$..price", "$.store.book[?(@.price < 10)].title", "$.store.book[-1]['title']",
+        "$..book[?(@.isbn)].isbn", "$.store.*", "$..author.name", "$.store.book[?(@.title == 'Sword')].price", NULL
+    };
+    int counts[] = { 3, 4, 2, 1, 2, 4, 1, 1 };
+    
+    json_object * obj = json_parse_string(test_path_json, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    
+    for (int i = 0; expressions[i] != NULL; i++) {
+        json_path * path = json_path_compile(expressions[i], NULL);
+        JSON_TEST_ASSERT(path != NULL);
+        json_object * results = json_path_query(path, obj);
+        JSON_TEST_ASSERT(json_array_size(results) == counts[i]);
+        json_object_free(results);
+        json_path_free(path);
+    }
+    
+    json_path * path = json_path_compile("$.store.book[?(@.price < 10)].title", NULL);
+    json_object * results = json_path_query(path, obj);
+    JSON_TEST_ASSERT(strcmp(json_string_value(json_array_get(results, 0)), "Sayings") == 0);
+    JSON_TEST_ASSERT(strcmp(json_string_value(json_array_get(results, 1)), "Moby Dick") == 0);
+    json_object_free(results);
+    json_path_free(path);
+    
+    json_object_free(obj);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Streaming JSONPath test. */
+static bool test_path_3(void) {
+    JSON_TEST_START;
+    
+    const char * expressions[] = {
+        "$.store.book[*].title", "$..price", "$.store.book[?(@.price < 10)].title", "$.store.book[-1]['title']",
+        "$..book[?(@.isbn)].isbn", "$.store.*", "$..author.name", "/store/book/0/author", "", NULL
+    };
+    
+    json_object * obj = json_parse_string(test_path_json, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    
+    for (int i = 0; expressions[i] != NULL; i++) {
+        json_path * path = json_path_compile(expressions[i], NULL);
+        JSON_TEST_ASSERT(path != NULL);
+        json_object * expected = json_path_query(path, obj);
+        json_object * results = json_path_query_string(path, test_path_json, NULL);
+        JSON_TEST_ASSERT(results != NULL);
+        JSON_TEST_ASSERT(json_array_size(results) == json_array_size(expected));
+        
+        // maps are iterated in a different order, compare only the types
+        int types[JSON_OBJECT_MAP + 1] = { 0 };
+        for (int j = 0; j < json_array_size(results); j++) {
+            types[json_array_get(results, j)->type]++;
+            types[json_array_get(expected, j)->type]--;
+        }
+        for (int j = 0; j <= JSON_OBJECT_MAP; j++) JSON_TEST_ASSERT(types[j] == 0);
+        json_object_free(expected);
+        json_object_free(results);
+        json_path_free(path);
+    }
+    
+    json_error err = JSON_ERROR_EMPTY;
+    json_path * path = json_path_compile("$.a", NULL);
+    JSON_TEST_ASSERT(json_path_query_string(path, "{\"a\": 1, \"b\": [1, 2", &err) == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_UNEXPECTED_EOF);
+    JSON_TEST_ASSERT(json_path_query_string(path, "{\"a\": 1} garbage", &err) == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_GARBAGE);
+    json_path_free(path);
+    
+    json_object_free(obj);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Invalid path expressions test. */
+static bool test_path_4(void) {
+    JSON_TEST_START;
+    
+    const char * expressions[] = {
+        "store", "/a~2", "$.", "$[", "$['key", "$[1.5]", "$[?(@.a <)]", "$[?(@.a == [1])]", "$.a b", NULL
+    };
+    
+    for (int i = 0; expressions[i] != NULL; i++) {
+        json_error err = JSON_ERROR_EMPTY;
+        JSON_TEST_ASSERT(json_path_compile(expressions[i], &err) == NULL);
+        JSON_TEST_ASSERT(err.code == JSON_ERROR_PATH_SYNTAX);
+    }
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Projection test. */
+static bool test_path_5(void) {
+    JSON_TEST_START;
+    
+    json_path * paths[] = { 
+        json_path_compile("$.store.book[*].title", NULL), 
+        json_path_compile("/store/bicycle", NULL), 
+        json_path_compile("$.store.book[?(@.isbn)].price", NULL) 
+    };
+    
+    json_object * obj = json_parse_string_projected(test_path_json, paths, 3, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(obj->type == JSON_OBJECT_MAP);
+    json_object * store = json_map_get(obj, "store");
+    JSON_TEST_ASSERT(json_map_size(store) == 2);
+    JSON_TEST_ASSERT(json_map_get(store, "a/b") == NULL);
+    JSON_TEST_ASSERT(json_map_size(json_map_get(store, "bicycle")) == 2);
+    
+    json_object * books = json_map_get(store, "book");
+    JSON_TEST_ASSERT(json_array_size(books) == 3);
+    JSON_TEST_ASSERT(json_map_get(json_array_get(books, 0), "author") != NULL); // needed by the filter
+    JSON_TEST_ASSERT(strcmp(json_string_value(json_map_get(json_array_get(books, 1), "title")), "Sword") == 0);
+    json_object_free(obj);
+    
+    // skipped array items are replaced by null
+    obj = json_parse_string_projected("[{\"a\": \"skipped\"}, [1, 2, {\"b\": 3}], \"skipped\"]", paths + 1, 1, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_array_size(obj) == 3);
+    JSON_TEST_ASSERT(json_array_get(obj, 0)->type == JSON_OBJECT_NULL);
+    json_object_free(obj);
+    
+    json_error err = JSON_ERROR_EMPTY;
+    obj = json_parse_string_projected("{\"store\": {\"skipped\": [1, 2}", paths, 1, &err);
+    JSON_TEST_ASSERT(obj == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_UNEXPECTED_EOF);
+    
+    // no paths
+    JSON_TEST_ASSERT(json_parse_string_projected("{}", paths, 0, &err) == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_PATH_SYNTAX);
+    
+    // nesting matched by a descendant step
+    json_path * descendant = json_path_compile("$..x", NULL);
+    int depth = JSON_PATH_MAX_DEPTH + 1;
+    char * deep = malloc(2 * depth + 1);
+    memset(deep, '[', depth);
+    memset(deep + depth, ']', depth);
+    deep[2 * depth] = '\0';
+    JSON_TEST_ASSERT(json_parse_string_projected(deep, &descendant, 1, &err) == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_TOO_DEEP);
+    obj = json_parse_string_projected(deep + 1, &descendant, 1, &err);
+    JSON_TEST_ASSERT(obj == NULL); // unbalanced
+    deep[2 * depth - 1] = '\0';
+    obj = json_parse_string_projected(deep + 1, &descendant, 1, &err);
+    JSON_TEST_ASSERT(obj != NULL && json_array_size(obj) == 1);
+    json_object_free(obj);
+    free(deep);
+    
+    // duplicate keys of the projected maps
+    const char * duplicates = "{\"x\": 1, \"y\": 2, \"x\": 3, \"y\": 4}";
+    obj = json_parse_projected_ext(json_reader_string(duplicates), &descendant, 1, JSON_DUPLICATE_FIRST, NULL);
+    JSON_TEST_ASSERT(obj != NULL && json_map_size(obj) == 1 && json_int_value(json_map_get(obj, "x")) == 1);
+    json_object_free(obj);
+    JSON_TEST_ASSERT(json_parse_projected_ext(json_reader_string(duplicates), &descendant, 1, JSON_DUPLICATE_ERROR, &err) == NULL);
+    JSON_TEST_ASSERT(err.code == JSON_ERROR_DUPLICATE_KEY);
+    obj = json_parse_projected_ext(json_reader_string("{\"x\": {\"a\": 1, \"a\": 2}}"), &descendant, 1, JSON_DUPLICATE_ERROR, &err);
+    JSON_TEST_ASSERT(obj == NULL && err.code == JSON_ERROR_DUPLICATE_KEY); // in a subtree built by the parser
+    json_path_free(descendant);
+    
+    for (int i = 0; i < 3; i++) json_path_free(paths[i]);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Compares two trees. */
+static bool test_objectsEqual(const json_object * a, const json_object * b) {
+    if (a->type != b->type) return false;
+    switch (a->type) {
+    case JSON_OBJECT_NULL: return true;
+    case JSON_OBJECT_INT: return json_int_value(a) == json_int_value(b);
+    case JSON_OBJECT_BOOL: return json_bool_value(a) == json_bool_value(b);
+    case JSON_OBJECT_FLOAT: return json_float_value(a) == json_float_value(b);
+    case JSON_OBJECT_STRING:
+        return json_string_length(a) == json_string_length(b)
+            && memcmp(json_string_value(a), json_string_value(b), json_string_length(a)) == 0;
+    case JSON_OBJECT_ARRAY:
+        if (json_array_size(a) != json_array_size(b)) return false;
+        for (int i = 0; i < json_array_size(a); i++) {
+            if (!test_objectsEqual(json_array_get(a, i), json_array_get(b, i))) return false;
+        }
+        return true;
+    case JSON_OBJECT_MAP:
+    {
+        if (json_map_size(a) != json_map_size(b)) return false;
+        json_map_iterator iterator;
+        json_map_iterator_init(&iterator, a);
+        while (json_map_iterator_next(&iterator)) {
+            json_object * other = json_map_get(b, iterator.key);
+            if (other == NULL || !test_objectsEqual(iterator.value, other)) return false;
+        }
+        return true;
+    }
+    }
+    return false;
+}
+
+/* Native binary format round trip test. */
+static bool test_binary_1(void) {
+    JSON_TEST_START;
+    
+    const char * files[] = { "test_files/test_ok_1.json", "test_files/test_ok_4.json", "test_files/test_ok_5.json" };
+    for (int i = 0; i < 3; i++) {
+        json_object * obj = json_parse_file(files[i], NULL);
+        JSON_TEST_ASSERT(obj != NULL);
+        
+        json_buffer buffer;
+        json_buffer_init(&buffer);
+        json_binary_encode(&buffer, obj);
+        json_object * decoded = json_binary_decode(buffer.data, buffer.size, NULL);
+        JSON_TEST_ASSERT(decoded != NULL);
+        JSON_TEST_ASSERT(test_objectsEqual(obj, decoded));
+        
+        json_buffer_free(&buffer);
+        json_object_free(obj);
+        json_object_free(decoded);
+    }
+    
+    // containers are presized
+    json_object * obj = json_parse_string("{\"a\": 1, \"b\": 2, \"c\": 3, \"d\": 4, \"e\": [1, 2, 3]}", NULL);
+    json_buffer buffer;
+    json_buffer_init(&buffer);
+    json_binary_encode(&buffer, obj);
+    json_object * decoded = json_binary_decode(buffer.data, buffer.size, NULL);
+    JSON_TEST_ASSERT(json_map_hashtable_size(decoded) == 16);
+    JSON_TEST_ASSERT(json_map_get(decoded, "e")->json_array.capacity == 3);
+    json_buffer_free(&buffer);
+    json_object_free(obj);
+    json_object_free(decoded);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* CBOR test. */
+static bool test_binary_2(void) {
+    JSON_TEST_START;
+    
+    json_object * obj = json_parse_string("{\"list\": [0, 23, 24, 1000, -1, -100, -2147483648, 2.5, \"\", \"text\"], "
+            "\"map\": {\"t\": true, \"f\": false, \"n\": null}}", NULL);
+    json_buffer buffer;
+    json_buffer_init(&buffer);
+    json_cbor_encode(&buffer, obj);
+    json_object * decoded = json_cbor_decode(buffer.data, buffer.size, NULL);
+    JSON_TEST_ASSERT(decoded != NULL);
+    JSON_TEST_ASSERT(test_objectsEqual(obj, decoded));
+    json_object_free(obj);
+    json_object_free(decoded);
+    
+    // encoding of integers
+    buffer.size = 0;
+    obj = json_int(1000);
+    json_cbor_encode(&buffer, obj);
+    JSON_TEST_ASSERT(buffer.size == 3 && memcmp(buffer.data, "\x19\x03\xe8", 3) == 0);
+    json_object_free(obj);
+    json_buffer_free(&buffer);
+    
+    // examples from RFC 7049
+    obj = json_cbor_decode("\x38\x63", 2, NULL);
+    JSON_TEST_ASSERT(obj != NULL && json_int_value(obj) == -100);
+    json_object_free(obj);
+    
+    obj = json_cbor_decode("\xf9\x3e\x00", 3, NULL);
+    JSON_TEST_ASSERT(obj != NULL && json_float_value(obj) == 1.5);
+    json_object_free(obj);
+    
+    obj = json_cbor_decode("\xfb\x3f\xf1\x99\x99\x99\x99\x99\x9a", 9, NULL);
+    JSON_TEST_ASSERT(obj != NULL && json_float_value(obj) == 1.1f);
+    json_object_free(obj);
+    
+    obj = json_cbor_decode("\x9f\x01\x82\x02\x03\x9f\x04\x05\xff\xff", 10, NULL);
+    JSON_TEST_ASSERT(obj != NULL && json_array_size(obj) == 3);
+    JSON_TEST_ASSERT(json_array_size(json_array_get(obj, 2)) == 2);
+    json_object_free(obj);
+    
+    obj = json_cbor_decode("\x7f\x65strea\x64ming\xff", 13, NULL);
+    JSON_TEST_ASSERT(obj != NULL && strcmp(json_string_value(obj), "streaming") == 0);
+    JSON_TEST_ASSERT(json_string_length(obj) == 9);
+    json_object_free(obj);
+    
+    obj = json_cbor_decode("\xbf\x61\x61\x01\x61\x62\x9f\x02\x03\xff\xff", 11, NULL);
+    JSON_TEST_ASSERT(obj != NULL && json_map_size(obj) == 2);
+    JSON_TEST_ASSERT(json_int_value(json_map_get(obj, "a")) == 1);
+    json_object_free(obj);
+    
+    obj = json_cbor_decode("\xc1\x1a\x51\x4b\x67\xb0", 6, NULL); // tagged epoch time
+    JSON_TEST_ASSERT(obj != NULL && json_int_value(obj) == 1363896240);
+    json_object_free(obj);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Invalid binary data test. */
+static bool test_binary_3(void) {
+    JSON_TEST_START;
+    
+    json_error error = JSON_ERROR_EMPTY;
+    json_object * obj = json_parse_string("{\"key\": [1, \"two\", 3.5]}", NULL);
+    json_buffer buffer;
+    json_buffer_init(&buffer);
+    json_binary_encode(&buffer, obj);
+    
+    // every truncation fails
+    for (size_t size = 0; size < buffer.size; size++) {
+        error = JSON_ERROR_EMPTY;
+        JSON_TEST_ASSERT(json_binary_decode(buffer.data, size, &error) == NULL);
+        JSON_TEST_ASSERT(error.code == JSON_ERROR_BINARY_DATA);
+    }
+    JSON_TEST_ASSERT(json_binary_decode("JSD\x01\x00\x00\x00\x00\x00", 9, &error) == NULL); // old version
+    
+    // header and a null, followed by invalid values
+    buffer.size = 0;
+    json_object * null = json_null();
+    json_binary_encode(&buffer, null);
+    json_object_free(null);
+    JSON_TEST_ASSERT(buffer.size == 9);
+    unsigned char data[32];
+    memcpy(data, buffer.data, 9);
+    JSON_TEST_ASSERT(json_binary_decode(data, 10, &error) == NULL); // trailing data
+    memcpy(data + 8, "\x06\xff\xff\xff\xff", 5);
+    JSON_TEST_ASSERT(json_binary_decode(data, 13, &error) == NULL); // huge array
+    data[8] = 9;
+    JSON_TEST_ASSERT(json_binary_decode(data, 9, &error) == NULL); // unknown tag
+    
+    // the stored hashes don't depend on the process's seed, with another one they're recomputed
+    buffer.size = 0;
+    json_binary_encode(&buffer, obj);
+    uint32_t storedHash = buffer.data[13] | buffer.data[14] << 8 | buffer.data[15] << 16 | (uint32_t)buffer.data[16] << 24;
+    JSON_TEST_ASSERT(storedHash == json_map_hash_seeded("key", 3, JSON_BINARY_HASH_SEED));
+    JSON_TEST_ASSERT(!json_map_seed_equals(JSON_BINARY_HASH_SEED));
+    buffer.data[13] ^= 1; // stored hash of the key
+    json_object * decoded = json_binary_decode(buffer.data, buffer.size, NULL);
+    JSON_TEST_ASSERT(decoded != NULL && json_map_get(decoded, "key") != NULL);
+    json_object_free(decoded);
+    buffer.data[4] ^= 1; // fingerprint of an older image
+    decoded = json_binary_decode(buffer.data, buffer.size, NULL);
+    JSON_TEST_ASSERT(decoded != NULL && json_map_get(decoded, "key") != NULL);
+    json_object_free(decoded);
+    
+    buffer.size = 0;
+    json_cbor_encode(&buffer, obj);
+    for (size_t size = 0; size < buffer.size; size++) {
+        JSON_TEST_ASSERT(json_cbor_decode(buffer.data, size, NULL) == NULL);
+    }
+    JSON_TEST_ASSERT(json_cbor_decode("\x41\x00", 2, &error) == NULL); // byte string
+    JSON_TEST_ASSERT(json_cbor_decode("\x1a\xff\xff\xff\xff", 5, &error) == NULL); // out of range
+    JSON_TEST_ASSERT(json_cbor_decode("\xa1\x01\x02", 3, &error) == NULL); // integer key
+    JSON_TEST_ASSERT(json_cbor_decode("\x9f\x01", 2, &error) == NULL); // missing break
+    JSON_TEST_ASSERT(json_cbor_decode("\x7f\x01\xff", 3, &error) == NULL); // invalid chunk
+    JSON_TEST_ASSERT(json_cbor_decode("\x9b\xff\xff\xff\xff\xff\xff\xff\xff", 9, &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_BINARY_DATA);
+    JSON_TEST_ASSERT(json_cbor_decode("\xa1\x62\x61\x00\x01", 5, &error) == NULL); // NUL inside a key
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_BINARY_DATA);
+    memcpy(data + 8, "\x07\x01\x00\x00\x00\x00\x00\x00\x00\x02\x00\x00\x00\x61\x00\x00", 16);
+    JSON_TEST_ASSERT(json_binary_decode(data, 24, &error) == NULL && error.code == JSON_ERROR_BINARY_DATA);
+    
+    // deep nesting fails instead of overflowing the stack, in both formats and with tags
+    size_t depth = 100000;
+    unsigned char * nested = malloc(depth + 1);
+    for (int format = 0; format < 3; format++) {
+        memset(nested, format == 0 ? 0x81 : format == 1 ? 0xc0 : 0x9f, depth); // [[[..., tag(0), [_ ...
+        nested[depth] = 0x00;
+        error = JSON_ERROR_EMPTY;
+        JSON_TEST_ASSERT(json_cbor_decode(nested, depth + 1, &error) == NULL && error.code == JSON_ERROR_TOO_DEEP);
+    }
+    memcpy(nested, data, 8);
+    for (size_t i = 8; i + 5 <= depth; i += 5) memcpy(nested + i, "\x06\x01\x00\x00\x00", 5);
+    JSON_TEST_ASSERT(json_binary_decode(nested, depth, &error) == NULL && error.code == JSON_ERROR_TOO_DEEP);
+    free(nested);
+    
+    // the limit itself is fine
+    buffer.size = 0;
+    for (int i = 0; i < JSON_BINARY_MAX_DEPTH; i++) *json_buffer_grow(&buffer, 1) = 0x81;
+    *json_buffer_grow(&buffer, 1) = 0x00;
+    decoded = json_cbor_decode(buffer.data, buffer.size, &error);
+    JSON_TEST_ASSERT(decoded != NULL);
+    json_object_free(decoded);
+    
+    json_buffer_free(&buffer);
+    json_object_free(obj);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Compares a snapshot with the original tree. */
+static bool test_snapshotEqual(const json_snapshot_value * value, const json_object * obj) {
+    if (json_snapshot_type(value) != obj->type) return false;
+    switch (obj->type) {
+    case JSON_OBJECT_NULL: return true;
+    case JSON_OBJECT_INT: return json_snapshot_int_value(value) == json_int_value(obj);
+    case JSON_OBJECT_BOOL: return json_snapshot_bool_value(value) == json_bool_value(obj);
+    case JSON_OBJECT_FLOAT: return json_snapshot_float_value(value) == json_float_value(obj);
+    case JSON_OBJECT_STRING:
+        return json_snapshot_string_length(value) == json_string_length(obj)
+            && strcmp(json_snapshot_string_value(value), json_string_value(obj)) == 0;
+    case JSON_OBJECT_ARRAY:
+        if (json_snapshot_array_size(value) != json_array_size(obj)) return false;
+        for (int i = 0; i < json_array_size(obj); i++) {
+            if (!test_snapshotEqual(json_snapshot_array_get(value, i), json_array_get(obj, i))) return false;
+        }
+        return true;
+    case JSON_OBJECT_MAP:
+    {
+        if (json_snapshot_map_size(value) != json_map_size(obj)) return false;
+        json_map_iterator iterator;
+        json_map_iterator_init(&iterator, obj);
+        for (int i = 0; json_map_iterator_next(&iterator); i++) {
+            const json_snapshot_value * item = json_snapshot_map_get(value, iterator.key);
+            if (item == NULL || !test_snapshotEqual(item, iterator.value)) return false;
+            if (strcmp(json_snapshot_map_key(value, i), iterator.key) != 0) return false;
+            if (json_snapshot_map_value(value, i) != item) return false;
+        }
+        return true;
+    }
+    }
+    return false;
+}
+
+/* Snapshot in memory test. */
+static bool test_snapshot_1(void) {
+    JSON_TEST_START;
+    
+    const char * files[] = { "test_files/test_ok_1.json", "test_files/test_ok_4.json", "test_files/test_ok_5.json" };
+    for (int i = 0; i < 3; i++) {
+        json_object * obj = json_parse_file(files[i], NULL);
+        JSON_TEST_ASSERT(obj != NULL);
+        
+        json_buffer buffer;
+        json_buffer_init(&buffer);
+        JSON_TEST_ASSERT(json_snapshot_encode(&buffer, obj));
+        json_snapshot * snapshot = json_snapshot_open_buffer(buffer.data, buffer.size, NULL);
+        JSON_TEST_ASSERT(snapshot != NULL);
+        JSON_TEST_ASSERT(test_snapshotEqual(json_snapshot_root(snapshot), obj));
+        
+        json_snapshot_close(snapshot);
+        json_buffer_free(&buffer);
+        json_object_free(obj);
+    }
+    
+    json_object * obj = json_parse_string("{\"a\": [1, 2], \"b\": {}, \"c\": \"\"}", NULL);
+    json_buffer buffer;
+    json_buffer_init(&buffer);
+    JSON_TEST_ASSERT(json_snapshot_encode(&buffer, obj));
+    json_snapshot * snapshot = json_snapshot_open_buffer(buffer.data, buffer.size, NULL);
+    const json_snapshot_value * root = json_snapshot_root(snapshot);
+    JSON_TEST_ASSERT(json_snapshot_map_get(root, "d") == NULL);
+    JSON_TEST_ASSERT(json_snapshot_map_get(json_snapshot_map_get(root, "b"), "a") == NULL);
+    JSON_TEST_ASSERT(json_snapshot_array_get(json_snapshot_map_get(root, "a"), 2) == NULL);
+    JSON_TEST_ASSERT(json_snapshot_array_get(json_snapshot_map_get(root, "a"), -1) == NULL);
+    JSON_TEST_ASSERT(json_snapshot_map_key(root, 3) == NULL);
+    json_snapshot_close(snapshot);
+    
+    // invalid images
+    json_error error = JSON_ERROR_EMPTY;
+    JSON_TEST_ASSERT(json_snapshot_open_buffer(buffer.data, buffer.size - 4, &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_BINARY_DATA);
+    
+    // any corrupted word is either rejected or leaves the image readable (within its bounds)
+    for (size_t position = 16; position < buffer.size; position += 4) {
+        uint32_t word;
+        memcpy(&word, buffer.data + position, 4);
+        uint32_t corrupted[] = { word + 4, word - 4, 0x7FFFFFF0, 0xFFFFFFFF };
+        for (int i = 0; i < 4; i++) {
+            memcpy(buffer.data + position, &corrupted[i], 4);
+            snapshot = json_snapshot_open_buffer(buffer.data, buffer.size, NULL);
+            if (snapshot != NULL) {
+                test_snapshotEqual(json_snapshot_root(snapshot), obj);
+                json_snapshot_close(snapshot);
+            }
+        }
+        memcpy(buffer.data + position, &word, 4);
+    }
+    uint32_t indexSize, offset;
+    memcpy(&indexSize, buffer.data + 16 + 8, 4);
+    size_t entry = 16 + 12 + 4*indexSize; // of "a" in the root map
+    memcpy(&offset, buffer.data + entry + 8, 4);
+    offset += 4; // the value points inside of the array
+    memcpy(buffer.data + entry + 8, &offset, 4);
+    JSON_TEST_ASSERT(json_snapshot_open_buffer(buffer.data, buffer.size, NULL) == NULL);
+    buffer.data[0] = 'X';
+    JSON_TEST_ASSERT(json_snapshot_open_buffer(buffer.data, buffer.size, NULL) == NULL);
+    json_buffer_free(&buffer);
+    json_object_free(obj);
+    
+    // nesting over the limit
+    char deep[2*JSON_BINARY_MAX_DEPTH + 5];
+    memset(deep, '[', JSON_BINARY_MAX_DEPTH + 1);
+    memset(deep + JSON_BINARY_MAX_DEPTH + 1, ']', JSON_BINARY_MAX_DEPTH + 1);
+    deep[2*JSON_BINARY_MAX_DEPTH + 2] = '\0';
+    obj = json_parse_string(deep, NULL);
+    json_buffer_init(&buffer);
+    JSON_TEST_ASSERT(obj != NULL && json_snapshot_encode(&buffer, obj));
+    JSON_TEST_ASSERT(json_snapshot_open_buffer(buffer.data, buffer.size, &error) == NULL && error.code == JSON_ERROR_TOO_DEEP);
+    json_buffer_free(&buffer);
+    json_object_free(obj);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+/* Snapshot file test. */
+static bool test_snapshot_2(void) {
+    JSON_TEST_START;
+    
+    const char * filename = "test_files/snapshot.tmp";
+    json_object * obj = json_parse_file("test_files/test_ok_4.json", NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    JSON_TEST_ASSERT(json_snapshot_write(obj, filename, NULL));
+    
+    json_snapshot * snapshot = json_snapshot_open(filename, NULL);
+    JSON_TEST_ASSERT(snapshot != NULL);
+    JSON_TEST_ASSERT(test_snapshotEqual(json_snapshot_root(snapshot), obj));
+    json_snapshot_close(snapshot);
+    remove(filename);
+    
+    json_error error = JSON_ERROR_EMPTY;
+    JSON_TEST_ASSERT(json_snapshot_open(filename, &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_IO);
+    JSON_TEST_ASSERT(json_snapshot_open("test_files/test_ok_1.json", &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_BINARY_DATA);
+    
+    json_object_free(obj);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static bool test_stats_1(void) {
+    JSON_TEST_START;
+    
+    const char * input = "{\"a\": [1, 2, [3]], \"b\": {\"c\": \"text\"}, \"d\": [true, false, null, 4]}";
+    json_stats stats;
+    json_stats_begin(&stats);
+    json_object * obj = json_parse_string(input, NULL);
+    json_stats_end();
+    JSON_TEST_ASSERT(obj != NULL);
+    
+    JSON_TEST_ASSERT(stats.parses == 1);
+    JSON_TEST_ASSERT(stats.bytes == strlen(input));
+    JSON_TEST_ASSERT(stats.nodes == 13); // 2 maps, 3 arrays, a string, 3 literals and 4 numbers
+    JSON_TEST_ASSERT(stats.nodeBytes == 13*sizeof(json_object));
+    JSON_TEST_ASSERT(stats.strings >= 5); // 4 keys and a string value at least
+    JSON_TEST_ASSERT(stats.buckets == 2 + 2); // 2 hashtables and their item arrays
+    JSON_TEST_ASSERT(stats.arrays == 3);
+    JSON_TEST_ASSERT(stats.rehashes == 0);
+    JSON_TEST_ASSERT(stats.maxChainLength >= 1);
+    JSON_TEST_ASSERT(stats.maxDepth == 3);
+    JSON_TEST_ASSERT(stats.maxContainerSize == 4);
+    
+    // the collecting stopped
+    json_object_free(obj);
+    obj = json_parse_string(input, NULL);
+    JSON_TEST_ASSERT(stats.parses == 1);
+    json_object_free(obj);
+    
+    // global counters
+    json_stats global;
+    json_stats_reset();
+    json_stats_enable(true);
+    obj = json_parse_string(input, NULL);
+    json_object_free(obj);
+    obj = json_parse_string(input, NULL);
+    json_stats_enable(false);
+    json_stats_global(&global);
+    JSON_TEST_ASSERT(global.parses == 2);
+    JSON_TEST_ASSERT(global.bytes == 2*strlen(input));
+    JSON_TEST_ASSERT(global.nodes == 2*stats.nodes);
+    JSON_TEST_ASSERT(global.maxDepth == 3);
+    
+    // rehashing
+    json_stats_begin(&stats);
+    for (int i = 0; i < 100; i++) {
+        char key[16];
+        sprintf(key, "key%d", i);
+        json_map_put(obj, key, json_null());
+    }
+    json_stats_end();
+    JSON_TEST_ASSERT(stats.rehashes == 5); // 8 -> 256
+    JSON_TEST_ASSERT(stats.nodes == 100);
+    json_object_free(obj);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+#ifdef JSON_TRACE
+typedef struct TEST_TRACE {
+    int events[64];
+    size_t values[64];
+    int count;
+} test_trace;
+
+static void test_traceCallback(json_trace_event event, unsigned long long timestamp, size_t value, void * data) {
+    test_trace * trace = data;
+    if (event == JSON_TRACE_ALLOC || trace->count == 64) return;
+    trace->events[trace->count] = event;
+    trace->values[trace->count++] = value;
+}
+
+static void test_traceAllocCallback(json_trace_event event, unsigned long long timestamp, size_t value, void * data) {
+    if (event == JSON_TRACE_ALLOC) *(size_t*)data += value;
+}
+
+static bool test_trace_1(void) {
+    JSON_TEST_START;
+    
+    const char * input = "{\"a\": [1, 2], \"b\": {}}";
+    test_trace trace;
+    trace.count = 0;
+    json_trace_set(test_traceCallback, &trace);
+    json_object * obj = json_parse_string(input, NULL);
+    json_trace_set(NULL, NULL);
+    JSON_TEST_ASSERT(obj != NULL);
+    json_object_free(obj);
+    
+    int expected[] = {
+        JSON_TRACE_PARSE_START, JSON_TRACE_CONTAINER_OPEN, JSON_TRACE_CONTAINER_OPEN, JSON_TRACE_CONTAINER_CLOSE,
+        JSON_TRACE_CONTAINER_OPEN, JSON_TRACE_CONTAINER_CLOSE, JSON_TRACE_CONTAINER_CLOSE, JSON_TRACE_PARSE_END
+    };
+    JSON_TEST_ASSERT(trace.count == 8);
+    for (int i = 0; i < 8; i++) JSON_TEST_ASSERT(trace.events[i] == expected[i]);
+    JSON_TEST_ASSERT(trace.values[1] == JSON_OBJECT_MAP);
+    JSON_TEST_ASSERT(trace.values[2] == JSON_OBJECT_ARRAY);
+    JSON_TEST_ASSERT(trace.values[3] == 2);
+    JSON_TEST_ASSERT(trace.values[5] == 0);
+    JSON_TEST_ASSERT(trace.values[6] == 2);
+    JSON_TEST_ASSERT(trace.values[7] == strlen(input));
+    
+    // allocations
+    size_t allocated = 0;
+    json_trace_set(test_traceAllocCallback, &allocated);
+    obj = json_parse_string(input, NULL);
+    json_trace_set(NULL, NULL);
+    JSON_TEST_ASSERT(allocated >= 3*sizeof(json_object));
+    json_object_free(obj);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+#endif
+
+static bool test_async_1(void) {
+    JSON_TEST_START;
+    
+    const char * filenames[] = {
+        "test_files/test_ok_1.json", "test_files/test_ok_2.json", "test_files/missing.json",
+        "test_files/test_ok_3.json", "test_files/test_ok_4.json", "test_files/test_reader_2.txt",
+        "test_files/test_ok_5.json", "test_files/test_ok_1.json"
+    };
+    json_object * results[8];
+    json_error errors[8];
+    json_async_options options = { .threads = 2, .reads = 3 };
+    JSON_TEST_ASSERT(!json_parse_files_async(filenames, 8, results, errors, &options));
+    
+    for (int i = 0; i < 8; i++) {
+        if (i == 2) {
+            JSON_TEST_ASSERT(results[i] == NULL);
+            JSON_TEST_ASSERT(errors[i].code == JSON_ERROR_IO);
+        }
+        else if (i == 5) {
+            JSON_TEST_ASSERT(results[i] == NULL);
+            JSON_TEST_ASSERT(errors[i].code != JSON_ERROR_IO);
+        }
+        else {
+            json_object * expected = json_parse_file(filenames[i], NULL);
+            JSON_TEST_ASSERT(results[i] != NULL);
+            JSON_TEST_ASSERT(test_objectsEqual(results[i], expected));
+            json_object_free(expected);
+            json_object_free(results[i]);
+        }
+    }
+    
+    JSON_TEST_ASSERT(json_parse_files_async(filenames, 2, results, NULL, NULL));
+    json_object_free(results[0]);
+    json_object_free(results[1]);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static bool test_async_2(void) {
+    JSON_TEST_START;
+    
+    // many small documents, split between the threads in batches
+    int n = 1000;
+    char * input = malloc(n * 32);
+    char * p = input;
+    for (int i = 0; i < n; i++) {
+        if (i % 4 == 0) p += sprintf(p, "{\"id\": %i, \"s\": \"}]\\\"\"}", i);
+        else if (i % 4 == 1) p += sprintf(p, "[%i, [true]]\n", i);
+        else if (i % 4 == 2) p += sprintf(p, "%i ", i);
+        else p += sprintf(p, "\"%i\"", i);
+    }
+    
+    int count;
+    json_async_options options = { .threads = 3 };
+    json_object ** documents = json_parse_documents_async(input, p - input, &count, NULL, &options);
+    JSON_TEST_ASSERT(documents != NULL && count == n);
+    
+    json_document_iterator iterator;
+    json_document_iterator_init_buffer(&iterator, input, p - input, NULL);
+    for (int i = 0; i < n; i++) {
+        JSON_TEST_ASSERT(json_document_iterator_next(&iterator));
+        JSON_TEST_ASSERT(test_objectsEqual(documents[i], iterator.document));
+        json_object_free(iterator.document);
+        json_object_free(documents[i]);
+    }
+    json_document_iterator_free(&iterator);
+    free(documents);
+    JSON_DEBUG_FREE;
+    
+    // the first invalid document is reported, at its position in the buffer
+    strcpy(input, "[1]\n[2] [3 4] [5 6]");
+    json_error error;
+    JSON_TEST_ASSERT(json_parse_documents_async(input, strlen(input), &count, &error, NULL) == NULL);
+    JSON_TEST_ASSERT(count == 4);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET);
+    JSON_TEST_ASSERT(error.line == 2 && error.pos == 9); // as if the whole buffer was parsed
+    
+    documents = json_parse_documents_async("", 0, &count, NULL, NULL);
+    JSON_TEST_ASSERT(documents != NULL && count == 0);
+    free(documents);
+    JSON_DEBUG_FREE;
+    free(input);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static bool test_validate_1(void) {
+    JSON_TEST_START;
+    
+    const char * valid[] = {
+        "{\"a\": [1, -2.5e+3, true, false, null, \"x\\\"\\u00e9\\n\"], \"b\": {}}", "[]", " 0 ", "\"\"",
+        "{\n    \"indented\": [\n        \"a string longer than sixteen characters\"\n    ]\n}", "[1]\0garbage"
+    };
+    const char * invalid[] = {
+        "", "[1, 2", "{\"a\" 1}", "{\"a\": 1,}", "[1 2]", "[01]", "[1.]", "[-]", "[1e]", "[tru]", "[true1]", "[1,,null]",
+        "{\"a\":\n  \"b\nc\"}", "\"\\x\"", "\"\\u12g4\"", "[1]]", "{1: 2}", "[1,\n2.\n]", "[1]@", "[@]", "\"abc", "nul"
+    };
+    
+    for (int i = 0; i < (int)(sizeof(valid) / sizeof(*valid)); i++) {
+        size_t length = strlen(valid[i]) + (i == 5 ? 8 : 0); // \0 ends the input
+        json_error error = JSON_ERROR_EMPTY;
+        JSON_TEST_ASSERT(json_validate(valid[i], length, &error));
+    }
+    
+    // the same errors as from the parser
+    json_parser parser;
+    json_parser_init(&parser);
+    for (int i = 0; i < (int)(sizeof(invalid) / sizeof(*invalid)); i++) {
+        json_error expected, error;
+        JSON_TEST_ASSERT(json_parser_parse(&parser, invalid[i], strlen(invalid[i]), &expected) == NULL);
+        JSON_TEST_ASSERT(!json_validate(invalid[i], strlen(invalid[i]), &error));
+        JSON_TEST_ASSERT(error.code == expected.code && error.line == expected.line && error.pos == expected.pos);
+    }
+    json_parser_free(&parser);
+    
+    // the literal after a token doesn't move its position
+    json_error error;
+    JSON_TEST_ASSERT(json_parse_string("[1,,null]", &error) == NULL);
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_UNRESOLVED_TOKEN && error.pos == 5);
+    
+    // nothing is allocated, only the nesting depth is limited
+#ifdef JSON_DEBUG
+    int memblocks = json_debug_memblocks;
+#endif
+    int depth = JSON_VALIDATE_MAX_DEPTH + 1;
+    char * deep = malloc(2 * depth);
+    memset(deep, '[', depth);
+    memset(deep + depth, ']', depth);
+    JSON_TEST_ASSERT(json_validate(deep + 1, 2 * depth - 2, NULL));
+    JSON_TEST_ASSERT(!json_validate(deep, 2 * depth, &error));
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_TOO_DEEP);
+    free(deep);
+#ifdef JSON_DEBUG
+    JSON_TEST_ASSERT(json_debug_memblocks == memblocks);
+#endif
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
+static bool test_format_write(void * data, const char * buffer, size_t size) {
+    memcpy(json_buffer_grow(data, size), buffer, size);
+    return true;
+}
+
+static bool test_format_1(void) {
+    JSON_TEST_START;
+    
+    const char * input = " {\"a\" : [1, -2.50e+3,\ttrue, false, null, \"x\\\"\\u00e9\\n\"],\n \"b\": {},\"c\":[ ],\"d\":{\"e\":[{}]}} ";
+    const char * minified = "{\"a\":[1,-2.50e+3,true,false,null,\"x\\\"\\u00e9\\n\"],\"b\":{},\"c\":[],\"d\":{\"e\":[{}]}}";
+    const char * indented = "{\n  \"a\": [\n    1,\n    -2.50e+3,\n    true,\n    false,\n    null,\n    \"x\\\"\\u00e9\\n\"\n  ],\n"
+                            "  \"b\": {},\n  \"c\": [],\n  \"d\": {\n    \"e\": [\n      {}\n    ]\n  }\n}";
+    json_buffer output;
+    json_buffer_init(&output);
+    JSON_TEST_ASSERT(json_minify(&output, input, strlen(input), NULL));
+    JSON_TEST_ASSERT(output.size == strlen(minified) && memcmp(output.data, minified, output.size) == 0);
+    output.size = 0;
+    JSON_TEST_ASSERT(json_prettify(&output, minified, strlen(minified), 2, NULL));
+    JSON_TEST_ASSERT(output.size == strlen(indented) && memcmp(output.data, indented, output.size) == 0);
+    output.size = 0;
+    JSON_TEST_ASSERT(json_minify(&output, "\"plain\"", 7, NULL));
+    JSON_TEST_ASSERT(output.size == 7 && memcmp(output.data, "\"plain\"", 7) == 0);
+    
+    // streaming from a reader to the callback
+    output.size = 0;
+    json_reader reader = json_reader_string(indented);
+    JSON_TEST_ASSERT(json_format_stream(reader, test_format_write, &output, 0, NULL));
+    JSON_TEST_ASSERT(output.size == strlen(minified) && memcmp(output.data, minified, output.size) == 0);
+    
+    // the same errors as from the parser
+    json_error error;
+    output.size = 0;
+    JSON_TEST_ASSERT(!json_minify(&output, "{\"a\":\n [1 2]}", 13, &error));
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_EXPECTED_COMMA_OR_CLOSING_BRACKET && error.line == 2 && error.pos == 6);
+    JSON_TEST_ASSERT(!json_prettify(&output, "[\"\\q\"]", 6, 4, &error));
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_STR_INVALID_ESCAPE);
+    JSON_TEST_ASSERT(!json_minify(&output, "[1] 2", 5, &error));
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_GARBAGE);
+    json_buffer_free(&output);
+    
+    JSON_OBJECTS_CHECK;
+    JSON_MEMBLOCKS_CHECK;
+    JSON_TEST_DONE;
+}
+
 static json_unit_test tests[] = {
-    test_reader_1, test_reader_2, // reader tests
+    test_reader_1, test_reader_2, test_reader_3, // reader tests
+#ifdef JSON_ZLIB
+    test_reader_4,
+#endif
     test_tokenizer_1, test_tokenizer_2, test_tokenizer_3, // basic tokens
     test_tokenizer_4, test_tokenizer_5, // symbol tokens
     test_tokenizer_6, test_tokenizer_7, test_tokenizer_8, // number tokens
     test_tokenizer_9, 
     test_tokenizer_10, // string tokens
+    test_tokenizer_11, // skipping
+    test_tokenizer_12, // literals
     test_object_1, test_object_2, // basic datatypes
     test_object_3, test_object_4, test_object_5, // arrays
     test_object_6, test_object_7, test_object_8, // hashmaps
     test_object_9, // references
     test_object_10,
+    test_object_11, test_object_12, // copies
+    test_object_13, test_object_14, test_object_15, test_object_16,
+    test_object_17, // insertion order
+    test_object_18, // batch lookups
     test_parser_1, test_parser_2, test_parser_3, // simple parser tests
     test_parser_4, test_parser_5, test_parser_6, test_parser_7, // complex types
+    test_parser_8, test_parser_9, test_parser_10, test_parser_11,
+    test_parser_12, // concatenated documents
+    test_parser_13, // duplicate keys
     test_parser_error_1,
     test_parser_error_2, test_parser_error_3, test_parser_error_4, test_parser_error_5, test_parser_error_6,
     test_parser_error_7, test_parser_error_8, test_parser_error_9, test_parser_error_10,
     test_parser_error_11,
     test_file_1, test_file_2, test_file_3, test_file_4, test_file_5,
+    test_path_1, test_path_2, test_path_3, test_path_4, // paths
+    test_path_5, // projections
+    test_binary_1, test_binary_2, test_binary_3, // binary formats
+    test_snapshot_1, test_snapshot_2, // snapshots
+    test_stats_1, // statistics
+#ifdef JSON_TRACE
+    test_trace_1, // tracing
+#endif
+    test_async_1, test_async_2, // parallel parsing
+    test_validate_1, // validation
+    test_format_1, // formatting
     NULL
 };
 
@@ -0,0 +1,226 @@
+/* 
+Copyright (c) 2013, Martin Majer
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_cpp_schema.hpp"
+#include "json_cpp17.hpp"
+
+typedef bool (* json_unit_test)(void);
+
+#define JSON_TEST_START printf("%s... ", __FUNCTION__)
+#define JSON_TEST_DONE { printf("OK\n"); return true; }
+#define JSON_TEST_FAILED { printf("Failed (%s:%i)\n", __FILE__, __LINE__); return false; }
+
+#define JSON_TEST_ASSERT(condition) if (!(condition)) JSON_TEST_FAILED
+
+static int json_unit_tests_passed = 0;
+static int json_unit_tests_failed = 0;
+
+struct test_address { std::string city; int zip; };
+JSON_SCHEMA(test_address, JSON_FIELD(city), JSON_FIELD(zip))
+
+struct test_person {
+    std::string name;
+    int age;
+    bool married;
+    float height;
+    std::vector<int> scores;
+    std::optional<std::string> nickname;
+    std::vector<test_address> addresses;
+};
+JSON_SCHEMA(test_person, JSON_FIELD(name), JSON_FIELD(age), JSON_FIELD(married), JSON_FIELD(height),
+    JSON_FIELD_KEY(scores, "results"), JSON_FIELD(nickname), JSON_FIELD(addresses))
+
+struct test_ranges {
+    int8_t small;
+    uint16_t port;
+    unsigned count;
+    int64_t big;
+    uint64_t huge;
+};
+JSON_SCHEMA(test_ranges, JSON_FIELD(small), JSON_FIELD(port), JSON_FIELD(count), JSON_FIELD(big), JSON_FIELD(huge))
+
+/* Schema decoding test. */
+static bool test_schema_1(void) {
+    JSON_TEST_START;
+    
+    const char * input = "{\"name\": \"Martin\", \"unknown\": {\"a\": [1, {\"b\": null}]}, \"age\": 23, \"married\": false, "
+        "\"height\": 1.5, \"results\": [1, 2, 3], \"nickname\": null, \"addresses\": [{\"zip\": 11000, \"city\": \"Prague\"}]}";
+    test_person p;
+    json_error error;
+    JSON_TEST_ASSERT(json_decode_string(input, p, &error));
+    JSON_TEST_ASSERT(p.name == "Martin" && p.age == 23 && !p.married && p.height == 1.5f);
+    JSON_TEST_ASSERT(p.scores.size() == 3 && p.scores[2] == 3);
+    JSON_TEST_ASSERT(!p.nickname.has_value());
+    JSON_TEST_ASSERT(p.addresses.size() == 1 && p.addresses[0].city == "Prague" && p.addresses[0].zip == 11000);
+    
+    JSON_TEST_ASSERT(json_decode_string("{\"nickname\": \"M\"}", p, &error));
+    JSON_TEST_ASSERT(p.nickname.has_value() && *p.nickname == "M");
+    
+    // a value of another type, a syntax error
+    JSON_TEST_ASSERT(!json_decode_string("{\"age\": \"23\"}", p, &error));
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_SCHEMA_MISMATCH);
+    JSON_TEST_ASSERT(!json_decode_string("{\"age\": 23,}", p, &error));
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_EXPECTED_STRING);
+    JSON_TEST_ASSERT(!json_decode_string("{\"age\": 23} 1", p, &error));
+    JSON_TEST_ASSERT(error.code == JSON_ERROR_GARBAGE);
+    
+    // plain values decode too
+    std::vector<int> numbers;
+    JSON_TEST_ASSERT(json_decode_string("[4, 5]", numbers) && numbers.size() == 2 && numbers[1] == 5);
+    
+    JSON_TEST_DONE;
+}
+
+/* Schema integer ranges test. */
+static bool test_schema_2(void) {
+    JSON_TEST_START;
+    
+    test_ranges r;
+    json_error error;
+    JSON_TEST_ASSERT(json_decode_string("{\"small\": -128, \"port\": 65535, \"count\": 4294967295, "
+        "\"big\": -9223372036854775808, \"huge\": 18446744073709551615}", r, &error));
+    JSON_TEST_ASSERT(r.small == -128 && r.port == 65535 && r.count == 4294967295u);
+    JSON_TEST_ASSERT(r.big == INT64_MIN && r.huge == UINT64_MAX);
+    
+    // integral floats in range
+    JSON_TEST_ASSERT(json_decode_string("{\"big\": 1e15, \"port\": 80.0, \"small\": -0.0}", r, &error));
+    JSON_TEST_ASSERT(r.big == 1000000000000000ll && r.port == 80 && r.small == 0);
+    
+    // values out of the member's range don't wrap
+    const char * invalid[] = { "{\"small\": 128}", "{\"small\": -129}", "{\"port\": 65536}", "{\"port\": -1}",
+        "{\"count\": 4294967296}", "{\"count\": -1}", "{\"big\": 9223372036854775808}", "{\"huge\": 18446744073709551616}",
+        "{\"huge\": -1}", "{\"port\": 1.5}", "{\"big\": 1e19}", "{\"small\": 200.0}" };
+    for (const char * input : invalid) {
+        JSON_TEST_ASSERT(!json_decode_string(input, r, &error) && error.code == JSON_ERROR_SCHEMA_MISMATCH);
+    }
+    
+    JSON_TEST_DONE;
+}
+
+/* C++17 interface test. */
+static bool test_cpp17_1(void) {
+    JSON_TEST_START;
+    
+    json::document doc = json::document::parse("{\"persons\": [{\"name\": \"Martin\", \"age\": 23, \"height\": 1.5}, {\"name\": \"John\", \"age\": 32}], \"empty\": null}");
+    JSON_TEST_ASSERT(doc);
+    json::value first = doc["persons"][0];
+    JSON_TEST_ASSERT(first.is_map() && first.size() == 3);
+    JSON_TEST_ASSERT(first["name"].as_string().value_or("") == "Martin");
+    JSON_TEST_ASSERT(first["age"].as_int() == 23 && first["age"].as_float() == 23.0f);
+    JSON_TEST_ASSERT(first["height"].as_float() == 1.5f && !first["height"].as_int());
+    JSON_TEST_ASSERT(doc["empty"].has_value() && doc["empty"].is_null());
+    
+    // missing values are empty views, not errors
+    JSON_TEST_ASSERT(!doc["missing"]["deeper"][3] && !doc["persons"][5] && !doc["persons"]["name"]);
+    JSON_TEST_ASSERT(!doc["missing"].as_int() && doc["missing"].size() == 0);
+    
+    // iteration in the source order
+    const char * keys[] = { "name", "age", "height" };
+    int count = 0;
+    for (auto [key, value] : first.items()) {
+        JSON_TEST_ASSERT(key == keys[count++] && value.has_value());
+    }
+    JSON_TEST_ASSERT(count == 3);
+    int ages = 0;
+    for (json::value person : doc["persons"].elements()) ages += person["age"].as_int().value_or(0);
+    JSON_TEST_ASSERT(ages == 55);
+    for (json::value item : doc["empty"].elements()) JSON_TEST_ASSERT(!item);
+    
+    // the ownership moves with the document
+    json::document moved = std::move(doc);
+    JSON_TEST_ASSERT(!doc && moved["persons"].size() == 2);
+    json_object * released = moved.release();
+    JSON_TEST_ASSERT(!moved && released != NULL);
+    json_object_free(released);
+    
+    json_error error;
+    JSON_TEST_ASSERT(!json::document::parse("[1,", &error) && error.code == JSON_ERROR_UNEXPECTED_EOF);
+    
+    JSON_TEST_DONE;
+}
+
+/* C++17 document owning a parser test. */
+static bool test_cpp17_2(void) {
+    JSON_TEST_START;
+    
+    // the tree is built in the arena of the document's parser
+    const char input[] = "{\"a\": [1, 2], \"b\\u0000c\": true}";
+    json_parser_options options = json_parser_options();
+    options.arenaBlockSize = 1024;
+    json::document doc = json::document::parse(input, sizeof(input) - 1, options);
+    JSON_TEST_ASSERT(doc && doc["a"][1].as_int() == 2);
+    
+    // the keys come with their stored lengths (even with a NUL inside)
+    int count = 0;
+    for (auto [key, value] : doc.root().items()) {
+        JSON_TEST_ASSERT(count++ == 0 ? key == "a" : key == std::string_view("b\0c", 3) && value.as_bool() == true);
+    }
+    JSON_TEST_ASSERT(count == 2);
+    
+    // the parser moves with the tree, a released tree is cloned out of the arena
+    json::document moved = std::move(doc);
+    JSON_TEST_ASSERT(!doc && moved["a"].size() == 2);
+    json_object * released = moved.release();
+    JSON_TEST_ASSERT(!moved && json_array_size(json_map_get(released, "a")) == 2);
+    json_object_free(released);
+    
+    json_error error;
+    JSON_TEST_ASSERT(!json::document::parse("[1,", 3, options, &error) && error.code == JSON_ERROR_UNEXPECTED_EOF);
+    
+    // without an arena the tree is allocated with malloc and freed by the document
+    json::document malloced = json::document::parse("[1, 2, 3]", 9, json_parser_options());
+    JSON_TEST_ASSERT(malloced.root().size() == 3);
+    
+    JSON_TEST_DONE;
+}
+
+static json_unit_test tests[] = {
+    test_schema_1, // schema decoding
+    test_schema_2, // schema integer ranges
+    test_cpp17_1, // C++17 interface
+    test_cpp17_2, // C++17 document owning a parser
+    NULL
+};
+
+/*
+ * Main function, for testing purposes.
+ */
+int main(int argc, char** argv) {
+    json_unit_test * currentTest = tests;
+    while (*currentTest != NULL) {
+        bool result = (*currentTest)();
+        if (result) json_unit_tests_passed++;
+        else json_unit_tests_failed++;
+        currentTest++;
+    }
+    printf("%i tests finished, %i failed.\n", json_unit_tests_passed + json_unit_tests_failed, json_unit_tests_failed);
+    return json_unit_tests_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}